@@ -0,0 +1,85 @@
+import csv
+import re
+import statistics
+import subprocess
+import time
+
+# Fixed pipeline windows (RING_SIZE / 4 requests in flight per connection)
+# against ADAPTIVE_PIPELINE, which aims at throughput or at a p90 latency SLO.
+# For the adaptive runs RING_SIZE only caps the depth. Also reports the depth
+# each client thread settled on and how long it took to get there.
+fixed_ring_sizes = [8, 32, 128, 512]
+adaptive_ring_size = 512
+latency_slos_us = [0, 50, 200]
+client_threads = 4
+page_size = 1024
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "simple_iou_server", "simple_iou_client"],
+                 cwd=build_dir)
+
+
+def run(build_dir="build"):
+  server_process = subprocess.Popen(["./simple_iou_server"], cwd=build_dir,
+                                    stdout=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./simple_iou_client"], cwd=build_dir,
+                                   stdout=subprocess.PIPE, text=True,
+                                   timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate = re.search(r'Average rate: (\d+\.\d+) it/s', output)
+  latency = re.search(r'Latency p50: ([\d.]+) us, p99: ([\d.]+) us, '
+                      r'p99\.9: ([\d.]+) us', output)
+  pipelines = re.findall(r'Pipeline depth (\d+) after \d+ rounds, settled '
+                         r'after ([\d.]+) ms', output)
+  if pipelines:
+    depth = statistics.mean(int(depth) for depth, _ in pipelines)
+    settled = max(float(ms) for _, ms in pipelines)
+  else:
+    depth, settled = "N/A", "N/A"
+  return ([rate.group(1) if rate else "N/A"] +
+          (list(latency.groups()) if latency else ["N/A"] * 3) +
+          [depth, settled])
+
+
+with open('adaptive_pipeline_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['MODE', 'RING_SIZE', 'LATENCY_SLO_US',
+                   'Average Rate (it/s)', 'p50 (us)', 'p99 (us)',
+                   'p99.9 (us)', 'Mean depth', 'Settled after (ms)'])
+  port = initial_port
+  base = {'PAGE_SIZE': page_size, 'NUM_REQUESTS': num_requests,
+          'CLIENT_THREADS': client_threads}
+  for ring_size in fixed_ring_sizes:
+    print(f" ### Running fixed RING_SIZE={ring_size}")
+    build({**base, 'RING_SIZE': ring_size, 'ADAPTIVE_PIPELINE': 0,
+           'PORT': port})
+    port += 1
+    rate, p50, p99, p999, _, _ = parse_output(run())
+    writer.writerow(['fixed', ring_size, '', rate, p50, p99, p999,
+                     ring_size // 4, ''])
+  for slo in latency_slos_us:
+    print(f" ### Running adaptive LATENCY_SLO_US={slo}")
+    build({**base, 'RING_SIZE': adaptive_ring_size, 'ADAPTIVE_PIPELINE': 1,
+           'LATENCY_SLO_US': slo, 'PORT': port})
+    port += 1
+    writer.writerow(['adaptive', adaptive_ring_size, slo,
+                     *parse_output(run())])
+
+with open('adaptive_pipeline_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
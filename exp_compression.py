@@ -0,0 +1,71 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Runs server_iou/client_iou with and without per-page compression and
+# records effective payload Gbps next to the Gbps actually put on the wire.
+page_sizes = [512, 4096, 16384]
+client_threads = [8, 32]
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=120)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  payload_match = re.search(r'Payload throughput: (\d+\.\d+) Gb/s', output)
+  wire_match = re.search(r'Wire throughput: (\d+\.\d+) Gb/s', output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          payload_match.group(1) if payload_match else "N/A",
+          wire_match.group(1) if wire_match else "N/A")
+
+
+with open('compression_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'CLIENT_THREADS', 'COMPRESSION',
+                   'Average Rate (req/s)', 'Payload Gbps', 'Wire Gbps'])
+  port = initial_port
+  for page_size in page_sizes:
+    build({'PAGE_SIZE': page_size})
+    for client_thread in client_threads:
+      for compression in [0, 1]:
+        print(
+            f" ### Running PAGE_SIZE={page_size}, CLIENT_THREADS={client_thread}, COMPRESSION={compression}")
+        env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+               'CLIENT_THREADS': str(client_thread),
+               'REACTOR_THREADS': str(reactor_threads),
+               'COMPRESSION': str(compression)}
+        port += 1
+        rate, payload, wire = parse_output(run(env))
+        writer.writerow(
+            [page_size, client_thread, compression, rate, payload, wire])
+
+with open('compression_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
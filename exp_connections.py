@@ -0,0 +1,80 @@
+import csv
+import re
+import subprocess
+import time
+
+# Connection scaling: CLIENT_THREADS active connections next to a growing
+# number of idle ones, served by a thread per connection or by EVENT_LOOPS
+# shared event loops. Reports the server's memory per connection at the peak
+# and the latency of the active connections. A thread per connection is only
+# tried up to thread_mode_limit connections.
+idle_connections = [0, 1000, 10000, 100000]
+modes = {'thread-per-connection': 0, 'event-loops': 4}
+thread_mode_limit = 10000
+source_addresses = 4
+client_threads = 8
+page_size = 1024
+ring_size = 64
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "simple_iou_server", "simple_iou_client"],
+                 cwd=build_dir)
+
+
+def run(build_dir="build"):
+  server_process = subprocess.Popen(["./simple_iou_server"], cwd=build_dir,
+                                    stdout=subprocess.PIPE, text=True)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./simple_iou_client"], cwd=build_dir,
+                                   stdout=subprocess.PIPE, text=True,
+                                   timeout=600)
+    server_output, _ = server_process.communicate(timeout=60)
+  finally:
+    if server_process.poll() is None:
+      server_process.terminate()
+      server_process.communicate()
+  return client_output.stdout, server_output
+
+
+def parse_output(client_output, server_output):
+  rate = re.search(r'Average rate: (\d+\.\d+) it/s', client_output)
+  latency = re.search(r'Latency p50: ([\d.]+) us, p99: ([\d.]+) us, '
+                      r'p99\.9: ([\d.]+) us', client_output)
+  peak = re.search(r'Peak connections: (\d+), RSS per connection: (\d+) '
+                   r'bytes, TCP buffers per connection: (\d+) bytes',
+                   server_output)
+  return ([rate.group(1) if rate else "N/A"] +
+          (list(latency.groups()) if latency else ["N/A"] * 3) +
+          (list(peak.groups()) if peak else ["N/A"] * 3))
+
+
+with open('connections_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['IDLE_CONNECTIONS', 'MODE', 'Average Rate (it/s)',
+                   'p50 (us)', 'p99 (us)', 'p99.9 (us)', 'Peak connections',
+                   'RSS per connection (bytes)',
+                   'TCP buffers per connection (bytes)'])
+  port = initial_port
+  for idle in idle_connections:
+    for mode, event_loops in modes.items():
+      if event_loops == 0 and idle > thread_mode_limit:
+        continue
+      print(f" ### Running IDLE_CONNECTIONS={idle}, MODE={mode}")
+      build({'PAGE_SIZE': page_size, 'RING_SIZE': ring_size,
+             'NUM_REQUESTS': num_requests, 'CLIENT_THREADS': client_threads,
+             'IDLE_CONNECTIONS': idle, 'SOURCE_ADDRESSES': source_addresses,
+             'EVENT_LOOPS': event_loops, 'PORT': port})
+      port += 1
+      writer.writerow([idle, mode, *parse_output(*run())])
+
+with open('connections_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,106 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Tail latency against several server_iou processes when one of them stalls:
+# the slow one stops serving for PAUSE_MS every PAUSE_EVERY_MS, like a
+# process in a GC pause. Requests go round robin over all endpoints, without
+# hedging or hedged after a percentile of recent latencies, with and without
+# a deadline the servers enforce.
+page_size = 4096
+page_count = 64 * 1024
+endpoint_count = 3
+pause_every_ms = 200
+pause_ms = 20
+hedge_percentiles = [0, 95, 99]
+deadlines_us = [0, 10000]
+client_threads = 4
+pipeline_depth = 16
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def start_server(env, build_dir):
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir, env=env,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  for line in server_process.stdout:
+    if "Server started" in line:
+      break
+  return server_process
+
+
+def run(slow, env, port, build_dir="build"):
+  base_env = dict(os.environ, LOGGING_LEVEL="INFO", PAGE_COUNT=str(page_count),
+                  REACTOR_THREADS="1")
+  servers = []
+  try:
+    for i in range(endpoint_count):
+      server_env = dict(base_env, PORT=str(port + i))
+      if slow and i == 0:
+        server_env.update(PAUSE_EVERY_MS=str(pause_every_ms),
+                          PAUSE_MS=str(pause_ms))
+      servers.append(start_server(server_env, build_dir))
+    time.sleep(1)
+    endpoints = ",".join(f"127.0.0.1:{port + i}"
+                         for i in range(endpoint_count))
+    client_env = dict(base_env, ENDPOINTS=endpoints,
+                      CLIENT_THREADS=str(client_threads),
+                      PIPELINE_DEPTH=str(pipeline_depth),
+                      NUM_REQUESTS=str(num_requests), **env)
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=client_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    for server in servers:
+      server.terminate()
+      server.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  latency = re.search(r'Latency p50: ([\d.]+) us, p99: ([\d.]+) us, '
+                      r'p99\.9: ([\d.]+) us', output)
+  hedges = re.search(r'Hedges: (\d+) sent, (\d+) won', output)
+  expired = re.search(r'Expired: (\d+)', output)
+  incorrect = re.search(r'Incorrect responses: (\d+)', output)
+  return ([rate.group(1) if rate else "N/A"] +
+          (list(latency.groups()) if latency else ["N/A"] * 3) +
+          (list(hedges.groups()) if hedges else ["N/A"] * 2) +
+          [expired.group(1) if expired else "0",
+           incorrect.group(1) if incorrect else "N/A"])
+
+
+with open('hedging_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['SLOW_ENDPOINT', 'HEDGE_PERCENTILE', 'DEADLINE_US',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'p99.9 (us)', 'Hedges', 'Hedges won', 'Expired',
+                   'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for slow in [False, True]:
+    for percentile in hedge_percentiles:
+      for deadline in deadlines_us:
+        print(f" ### Running SLOW_ENDPOINT={slow}, "
+              f"HEDGE_PERCENTILE={percentile}, DEADLINE_US={deadline}")
+        env = {'HEDGE_PERCENTILE': str(percentile),
+               'DEADLINE_US': str(deadline)}
+        writer.writerow([slow, percentile, deadline,
+                         *parse_output(run(slow, env, port))])
+        port += endpoint_count
+
+with open('hedging_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
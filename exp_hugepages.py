@@ -0,0 +1,83 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Random page numbers over a page store far larger than the TLB reach, with
+# the page memory on huge pages (HUGE_PAGES=1) or on 4 KiB pages. For the
+# explicit hugetlb modes reserve pages first, e.g.
+#   echo 1024 | sudo tee /proc/sys/vm/nr_hugepages
+# otherwise the server falls back to transparent huge pages.
+page_sizes = [16, 64, 256, 1024, 4096]
+memory_bytes = 1024 * 1024 * 1024
+max_page_count = 16 * 1024 * 1024
+client_threads = 8
+reactor_threads = 4
+num_requests = 4 * 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  # The page memory is filled before the server listens.
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Server started" in line:
+      break
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(server_output, client_output):
+  mode_match = re.search(r'Page memory: .* bytes on (.+)', server_output)
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  latency_match = re.search(r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us',
+                            client_output)
+  return (mode_match.group(1).strip() if mode_match else "N/A",
+          rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A")
+
+
+with open('hugepages_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'PAGE_COUNT', 'HUGE_PAGES', 'Mode',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)'])
+  port = initial_port
+  for page_size in page_sizes:
+    build({'PAGE_SIZE': page_size})
+    page_count = min(memory_bytes // page_size, max_page_count)
+    for huge_pages in ['0', '1']:
+      print(f" ### Running PAGE_SIZE={page_size}, HUGE_PAGES={huge_pages}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'PAGE_COUNT': str(page_count), 'KEY_DISTRIBUTION': 'uniform',
+             'HUGE_PAGES': huge_pages,
+             'CLIENT_THREADS': str(client_threads),
+             'REACTOR_THREADS': str(reactor_threads)}
+      port += 1
+      writer.writerow([page_size, page_count, huge_pages,
+                       *parse_output(*run(env))])
+
+with open('hugepages_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
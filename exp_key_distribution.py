@@ -0,0 +1,90 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Throughput and latency under different access patterns, for a store that
+# fits in the last-level cache and one that does not. Sequential walks
+# flatter the caches; uniform is the worst case; zipf and hotspot sit in
+# between depending on how much of the hot set stays resident.
+page_size = 1024
+page_counts = [16 * 1024, 4 * 1024 * 1024]
+distributions = [('sequential', {}), ('uniform', {}),
+                 ('zipf', {'ZIPF_THETA': '0.99'}),
+                 ('zipf', {'ZIPF_THETA': '0.5'}),
+                 ('hotspot', {'HOTSPOT_FRACTION': '0.01',
+                              'HOTSPOT_PROBABILITY': '0.9'}),
+                 ('scan', {'SCAN_LENGTH': '64'})]
+client_threads = 8
+reactor_threads = 4
+num_requests = 4 * 1024 * 1024
+write_percent = 0
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Server started" in line:
+      break
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(client_output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  latency_match = re.search(r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us',
+                            client_output)
+  incorrect_match = re.search(r'Incorrect responses: (\d+)', client_output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          incorrect_match.group(1) if incorrect_match else "N/A")
+
+
+with open('key_distribution_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_COUNT', 'KEY_DISTRIBUTION', 'Parameters',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for page_count in page_counts:
+    for distribution, parameters in distributions:
+      print(f" ### Running PAGE_COUNT={page_count}, "
+            f"KEY_DISTRIBUTION={distribution} {parameters}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'PAGE_COUNT': str(page_count), 'KEY_DISTRIBUTION': distribution,
+             'WRITE_PERCENT': str(write_percent),
+             'CLIENT_THREADS': str(client_threads),
+             'REACTOR_THREADS': str(reactor_threads), **parameters}
+      port += 1
+      _, client_output = run(env)
+      writer.writerow([page_count, distribution,
+                       ' '.join(f'{k}={v}' for k, v in parameters.items()),
+                       *parse_output(client_output)])
+
+with open('key_distribution_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
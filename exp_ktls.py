@@ -0,0 +1,69 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Measures what kernel TLS costs compared to plaintext over loopback: the same
+# server_iou/client_iou run with TLS=0 and TLS=1 at every page size. Needs the
+# tls kernel module (modprobe tls).
+page_sizes = [16, 128, 512, 1024, 4096, 16384]
+client_threads = 8
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+modes = {'plaintext': '0', 'ktls': '1'}
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release", "-DKTLS=ON"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=300)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  gbps_match = re.search(r'Average throughput: (\d+\.\d+) Gb/s', output)
+  incorrect_match = re.search(r'Incorrect responses: (\d+)', output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          gbps_match.group(1) if gbps_match else "N/A",
+          incorrect_match.group(1) if incorrect_match else "N/A")
+
+
+subprocess.run(["./gen_test_ca.sh", "build/certs"])
+with open('ktls_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'MODE', 'Average Rate (req/s)',
+                   'Average Throughput (Gb/s)', 'Incorrect Responses'])
+  port = initial_port
+  for page_size in page_sizes:
+    build({'PAGE_SIZE': page_size})
+    for mode, tls in modes.items():
+      print(f" ### Running PAGE_SIZE={page_size}, MODE={mode}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'CLIENT_THREADS': str(client_threads),
+             'REACTOR_THREADS': str(reactor_threads), 'TLS': tls}
+      port += 1
+      writer.writerow([page_size, mode, *parse_output(run(env))])
+
+with open('ktls_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
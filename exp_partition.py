@@ -0,0 +1,85 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Shared-everything reactors versus reactors that own a slice of the pages
+# and forward requests for the rest over IORING_OP_MSG_RING. Both modes pin
+# reactors to cores. Requests are uniform, so with R reactors (R-1)/R of them
+# are forwarded; the gain has to come from each slice staying in one core's
+# caches, which needs a store larger than one core's cache but a slice
+# small enough to stay in it.
+page_size = 4096
+page_counts = [4 * 1024, 64 * 1024, 1024 * 1024]
+reactor_threads = [2, 4, 8]
+client_threads = 16
+num_requests = 4 * 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Server started" in line:
+      break
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(client_output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  latency_match = re.search(r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us',
+                            client_output)
+  incorrect_match = re.search(r'Incorrect responses: (\d+)', client_output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          incorrect_match.group(1) if incorrect_match else "N/A")
+
+
+with open('partition_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_COUNT', 'REACTOR_THREADS', 'PARTITION_PAGES',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for page_count in page_counts:
+    for reactors in reactor_threads:
+      for partition in ['0', '1']:
+        print(f" ### Running PAGE_COUNT={page_count}, "
+              f"REACTOR_THREADS={reactors}, PARTITION_PAGES={partition}")
+        env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+               'PAGE_COUNT': str(page_count), 'KEY_DISTRIBUTION': 'uniform',
+               'PARTITION_PAGES': partition, 'PIN_REACTORS': '1',
+               'CLIENT_THREADS': str(client_threads),
+               'REACTOR_THREADS': str(reactors)}
+        port += 1
+        _, client_output = run(env)
+        writer.writerow([page_count, reactors, partition,
+                         *parse_output(client_output)])
+
+with open('partition_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
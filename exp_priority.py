@@ -0,0 +1,84 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Runs one latency-sensitive client (one request in flight) next to heavily
+# pipelining ones on a single reactor, with and without the DRR scheduler, and
+# records the light client's tail latency.
+page_size = 4096
+heavy_clients = [1, 4]
+heavy_threads = 4
+heavy_depth = 1024
+light_requests = 20000
+schedulers = {'fifo': {'DRR_QUANTUM_BYTES': 0, 'LIGHT_PRIORITY': 0},
+              'drr': {'DRR_QUANTUM_BYTES': 16384, 'LIGHT_PRIORITY': 0},
+              'drr+priority': {'DRR_QUANTUM_BYTES': 16384, 'LIGHT_PRIORITY': 7}}
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(heavy_count, scheduler, port, build_dir="build"):
+  base_env = dict(os.environ, LOGGING_LEVEL="INFO", PORT=str(port),
+                  REACTOR_THREADS="1",
+                  DRR_QUANTUM_BYTES=str(scheduler['DRR_QUANTUM_BYTES']))
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=base_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  heavy_env = dict(base_env, CLIENT_THREADS=str(heavy_threads),
+                   PIPELINE_DEPTH=str(heavy_depth),
+                   NUM_REQUESTS=str(16 * 1024 * 1024))
+  heavy_processes = [
+    subprocess.Popen(["./client_iou"], cwd=build_dir, env=heavy_env,
+                     stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    for _ in range(heavy_count)]
+  time.sleep(1)
+  light_env = dict(base_env, CLIENT_THREADS="1", PIPELINE_DEPTH="1",
+                   NUM_REQUESTS=str(light_requests),
+                   PRIORITY=str(scheduler['LIGHT_PRIORITY']))
+  try:
+    light_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                  env=light_env, stdout=subprocess.PIPE,
+                                  text=True, timeout=120)
+  finally:
+    for process in heavy_processes:
+      process.terminate()
+      process.wait()
+    server_process.terminate()
+    server_process.wait()
+  return light_output.stdout
+
+
+def parse_output(output):
+  latency_match = re.search(
+      r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us, p99\.9: (\d+\.\d+) us', output)
+  return (latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          latency_match.group(3) if latency_match else "N/A")
+
+
+with open('priority_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['HEAVY_CLIENTS', 'SCHEDULER', 'Light p50 (us)',
+                   'Light p99 (us)', 'Light p99.9 (us)'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for heavy_count in heavy_clients:
+    for name, scheduler in schedulers.items():
+      print(f" ### Running HEAVY_CLIENTS={heavy_count}, SCHEDULER={name}")
+      writer.writerow([heavy_count, name,
+                       *parse_output(run(heavy_count, scheduler, port))])
+      port += 1
+
+with open('priority_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,134 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# server_iou behind net_proxy, which makes loopback look like a wide-area
+# link. First what the proxy itself costs: STREAM_PAGES throughput direct and
+# through an undelayed proxy. Then random reads against pipeline depth with
+# the proxy adding a one-way delay, with jitter, and with loss, where every
+# lost chunk holds its direction back by PROXY_RTO_US.
+page_size = 4096
+page_count = 256 * 1024
+stream_pages = 16 * 1024
+proxy_threads = [1, 2]
+pipeline_depths = [1, 8, 64, 256]
+delay_us = 500
+networks = [
+  ('direct', None),
+  ('proxy', {}),
+  ('delay', {'PROXY_DELAY_US': str(delay_us)}),
+  ('jitter', {'PROXY_DELAY_US': str(delay_us), 'PROXY_JITTER_US': '200'}),
+  ('loss', {'PROXY_DELAY_US': str(delay_us), 'PROXY_LOSS_PERCENT': '0.1',
+            'PROXY_RTO_US': '20000'}),
+]
+reactor_threads = 4
+client_threads = 4
+num_requests = 256 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou", "net_proxy"],
+                 cwd=build_dir)
+
+
+def start(binary, ready, env, build_dir):
+  process = subprocess.Popen([binary], cwd=build_dir, env=env,
+                             stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, text=True)
+  for line in process.stdout:
+    if ready in line:
+      break
+  return process
+
+
+# Runs the client against a server on `port`, through a proxy configured by
+# `proxy_env` on `port + 1` unless it is None.
+def run(env, proxy_env, port, build_dir="build"):
+  base_env = dict(os.environ, LOGGING_LEVEL="INFO", PAGE_COUNT=str(page_count),
+                  HOST="127.0.0.1")
+  processes = []
+  try:
+    processes.append(start("./server_iou", "Server started",
+                           dict(base_env, PORT=str(port),
+                                REACTOR_THREADS=str(reactor_threads)),
+                           build_dir))
+    client_port = port
+    if proxy_env is not None:
+      client_port = port + 1
+      processes.append(start("./net_proxy", "Proxy started",
+                             dict(base_env, PORT=str(port),
+                                  PROXY_PORT=str(client_port), **proxy_env),
+                             build_dir))
+    time.sleep(1)
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=dict(base_env, PORT=str(client_port),
+                                            **env),
+                                   stdout=subprocess.PIPE, text=True,
+                                   timeout=600)
+  finally:
+    for process in processes:
+      process.terminate()
+      process.wait()
+  return client_output.stdout
+
+
+def parse_stream(output):
+  gbps = re.search(r'Payload throughput: (\d+\.\d+) Gb/s', output)
+  incorrect = re.search(r'Incorrect responses: (\d+)', output)
+  return [gbps.group(1) if gbps else "N/A",
+          incorrect.group(1) if incorrect else "N/A"]
+
+
+def parse_reads(output):
+  rate = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  latency = re.search(r'Latency p50: ([\d.]+) us, p99: ([\d.]+) us, '
+                      r'p99\.9: ([\d.]+) us', output)
+  incorrect = re.search(r'Incorrect responses: (\d+)', output)
+  return ([rate.group(1) if rate else "N/A"] +
+          (list(latency.groups()) if latency else ["N/A"] * 3) +
+          [incorrect.group(1) if incorrect else "N/A"])
+
+
+build({'PAGE_SIZE': page_size})
+port = initial_port
+
+with open('proxy_overhead_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PROXY_THREADS', 'Throughput (Gb/s)',
+                   'Incorrect Responses'])
+  stream_env = {'CLIENT_THREADS': str(client_threads),
+                'STREAM_PAGES': str(stream_pages)}
+  print(" ### Running stream direct")
+  writer.writerow(['direct', *parse_stream(run(stream_env, None, port))])
+  port += 2
+  for threads in proxy_threads:
+    print(f" ### Running stream through the proxy, PROXY_THREADS={threads}")
+    writer.writerow([threads, *parse_stream(
+      run(stream_env, {'PROXY_THREADS': str(threads)}, port))])
+    port += 2
+
+with open('proxy_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['NETWORK', 'PIPELINE_DEPTH', 'Average Rate (req/s)',
+                   'p50 (us)', 'p99 (us)', 'p99.9 (us)',
+                   'Incorrect Responses'])
+  for name, proxy_env in networks:
+    for depth in pipeline_depths:
+      print(f" ### Running NETWORK={name}, PIPELINE_DEPTH={depth}")
+      env = {'CLIENT_THREADS': str(client_threads),
+             'PIPELINE_DEPTH': str(depth),
+             'NUM_REQUESTS': str(num_requests)}
+      writer.writerow([name, depth, *parse_reads(run(env, proxy_env, port))])
+      port += 2
+
+for results in ['proxy_overhead_results.csv', 'proxy_results.csv']:
+  with open(results, 'r') as file:
+    for line in file:
+      print(line, end='')
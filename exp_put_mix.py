@@ -0,0 +1,72 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Compares read throughput of server_iou with and without concurrent PutPage
+# traffic. Reads should not get slower at a 95/5 read/write mix.
+page_sizes = [16, 512, 4096]
+write_percents = [0, 5]
+client_threads = [4, 16]
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=120)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  gbps_match = re.search(r'Average throughput: (\d+\.\d+) Gb/s', output)
+  stale_match = re.search(r'stale reads: (\d+)', output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          gbps_match.group(1) if gbps_match else "N/A",
+          stale_match.group(1) if stale_match else "N/A")
+
+
+with open('put_mix_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'CLIENT_THREADS', 'WRITE_PERCENT',
+                   'Average Rate (req/s)', 'Average Gbps', 'Stale Reads'])
+  port = initial_port
+  for page_size in page_sizes:
+    build({'PAGE_SIZE': page_size})
+    for client_thread in client_threads:
+      for write_percent in write_percents:
+        print(
+            f" ### Running PAGE_SIZE={page_size}, CLIENT_THREADS={client_thread}, WRITE_PERCENT={write_percent}")
+        env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+               'CLIENT_THREADS': str(client_thread),
+               'REACTOR_THREADS': str(reactor_threads),
+               'WRITE_PERCENT': str(write_percent)}
+        port += 1
+        rate, gbps, stale = parse_output(run(env))
+        writer.writerow(
+            [page_size, client_thread, write_percent, rate, gbps, stale])
+
+with open('put_mix_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
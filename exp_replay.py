@@ -0,0 +1,95 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Records a trace of a zipf workload, then replays it at the recorded speed,
+# scaled up, and as fast as possible over different numbers of connections.
+# In a real use the recording comes from production and only the replays run
+# here.
+page_size = 1024
+page_count = 1024 * 1024
+record_requests = 4 * 1024 * 1024
+record_threads = 8
+replay_speeds = ['1', '4', '0']
+replay_connections = [8, 64]
+reactor_threads = 4
+trace_path = os.path.abspath('requests.trace')
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build", linger=0):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Server started" in line:
+      break
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    time.sleep(linger)
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(client_output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  latency_match = re.search(r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us',
+                            client_output)
+  incorrect_match = re.search(r'Incorrect responses: (\d+)', client_output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          incorrect_match.group(1) if incorrect_match else "N/A")
+
+
+with open('replay_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['Run', 'REPLAY_SPEED', 'CLIENT_THREADS',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  base_env = {'PAGE_COUNT': str(page_count),
+              'REACTOR_THREADS': str(reactor_threads)}
+
+  print(f" ### Recording {record_requests} requests to {trace_path}")
+  env = {**base_env, 'PORT': str(port), 'TRACE': trace_path,
+         'NUM_REQUESTS': str(record_requests), 'KEY_DISTRIBUTION': 'zipf',
+         'CLIENT_THREADS': str(record_threads)}
+  port += 1
+  # Idle reactors write out their last records within a second.
+  _, client_output = run(env, linger=2)
+  writer.writerow(['record', '', record_threads, *parse_output(client_output)])
+
+  for speed in replay_speeds:
+    for connections in replay_connections:
+      print(f" ### Replaying at REPLAY_SPEED={speed} over {connections} "
+            f"connections")
+      env = {**base_env, 'PORT': str(port), 'REPLAY_TRACE': trace_path,
+             'REPLAY_SPEED': speed, 'CLIENT_THREADS': str(connections)}
+      port += 1
+      _, client_output = run(env)
+      writer.writerow(['replay', speed, connections,
+                       *parse_output(client_output)])
+
+with open('replay_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,113 @@
+import csv
+import os
+import re
+import statistics
+import subprocess
+import time
+
+# A primary server_iou pushing every PutPage to its replicas, with the client
+# balancing reads over the primary and the replicas by observed load and
+# sending writes to the primary. Read throughput against the number of
+# replicas on one box, and the replication lag the primary reports (update
+# applied to replica acknowledgement) under a growing share of writes. Runs
+# need to outlast the primary's 5 s report interval to get lag lines.
+page_size = 4096
+page_count = 256 * 1024
+replica_counts = [0, 1, 2, 3]
+write_percents = [0, 10, 30]
+reactor_threads = 2
+client_threads = 8
+pipeline_depth = 64
+num_requests = 16 * 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def start_server(env, build_dir):
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir, env=env,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  for line in server_process.stdout:
+    if "Server started" in line:
+      break
+  return server_process
+
+
+def run(replicas, write_percent, port, build_dir="build"):
+  base_env = dict(os.environ, LOGGING_LEVEL="INFO", PAGE_COUNT=str(page_count),
+                  REACTOR_THREADS=str(reactor_threads))
+  replica_endpoints = [f"127.0.0.1:{port + 1 + i}" for i in range(replicas)]
+  processes = []
+  primary = None
+  primary_output = ""
+  try:
+    # Replicas first: the primary connects to them when it starts.
+    for i in range(replicas):
+      processes.append(start_server(
+        dict(base_env, PORT=str(port + 1 + i)), build_dir))
+    primary = start_server(dict(base_env, PORT=str(port),
+                                REPLICAS=",".join(replica_endpoints)),
+                           build_dir)
+    processes.append(primary)
+    time.sleep(1)
+    client_env = dict(base_env,
+                      ENDPOINTS=",".join([f"127.0.0.1:{port}"] +
+                                         replica_endpoints),
+                      READ_BALANCING="1", WRITE_PERCENT=str(write_percent),
+                      CLIENT_THREADS=str(client_threads),
+                      PIPELINE_DEPTH=str(pipeline_depth),
+                      NUM_REQUESTS=str(num_requests))
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=client_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+    # Lets the primary report the last updates before it stops.
+    time.sleep(6)
+  finally:
+    for process in processes:
+      process.terminate()
+    if primary is not None:
+      primary_output, _ = primary.communicate()
+    for process in processes:
+      process.wait()
+  return client_output.stdout, primary_output
+
+
+def parse_output(client_output, primary_output):
+  rate = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  latency = re.search(r'Latency p50: ([\d.]+) us, p99: ([\d.]+) us',
+                      client_output)
+  incorrect = re.search(r'Incorrect responses: (\d+)', client_output)
+  lags = [(float(p50), float(p99)) for p50, p99 in re.findall(
+    r'replica \S+: [1-9]\d* updates, lag p50: ([\d.]+) us, p99: ([\d.]+) us',
+    primary_output)]
+  lag_p50 = f"{statistics.median(p50 for p50, _ in lags):.1f}" if lags else ""
+  lag_p99 = f"{max(p99 for _, p99 in lags):.1f}" if lags else ""
+  return ([rate.group(1) if rate else "N/A"] +
+          (list(latency.groups()) if latency else ["N/A"] * 2) +
+          [lag_p50, lag_p99, incorrect.group(1) if incorrect else "N/A"])
+
+
+with open('replication_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['REPLICAS', 'WRITE_PERCENT', 'Average Rate (req/s)',
+                   'p50 (us)', 'p99 (us)', 'Lag p50 (us)', 'Lag p99 (us)',
+                   'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for write_percent in write_percents:
+    for replicas in replica_counts:
+      print(f" ### Running REPLICAS={replicas}, WRITE_PERCENT={write_percent}")
+      writer.writerow([replicas, write_percent,
+                       *parse_output(*run(replicas, write_percent, port))])
+      port += replicas + 1
+
+with open('replication_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,76 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Compares same-host transports: loopback TCP and a Unix socket (both
+# server_iou/client_iou) against the shared-memory rings (shm_server/shm_client).
+page_sizes = [128, 4096, 16384]
+client_threads = [1, 8]
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+unix_socket = '/tmp/page_server.sock'
+transports = {'tcp': ('server_iou', 'client_iou', {}),
+              'unix': ('server_iou', 'client_iou', {'UNIX_SOCKET': unix_socket}),
+              'shm': ('shm_server', 'shm_client', {})}
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou", "shm_server",
+                  "shm_client"], cwd=build_dir)
+
+
+def run(server, client, env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen([f"./{server}"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run([f"./{client}"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=120)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  latency_match = re.search(
+      r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us, p99\.9: (\d+\.\d+) us', output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          latency_match.group(3) if latency_match else "N/A")
+
+
+with open('same_host_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'CLIENT_THREADS', 'TRANSPORT',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'p99.9 (us)'])
+  port = initial_port
+  for page_size in page_sizes:
+    build({'PAGE_SIZE': page_size})
+    for client_thread in client_threads:
+      for transport, (server, client, extra_env) in transports.items():
+        print(
+            f" ### Running PAGE_SIZE={page_size}, CLIENT_THREADS={client_thread}, TRANSPORT={transport}")
+        env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+               'CLIENT_THREADS': str(client_thread),
+               'REACTOR_THREADS': str(reactor_threads), **extra_env}
+        port += 1
+        writer.writerow([page_size, client_thread, transport,
+                         *parse_output(run(server, client, env))])
+
+with open('same_host_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,71 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Compares one send per page against one sendmsg per completion batch (with and
+# without MSG_MORE) in simple_iou_server for small pages: requests/s from the
+# client, TCP segments sent from the server's per-client report.
+page_sizes = [4, 16, 64, 256]
+modes = {'per-page': {'SEND_COALESCE': 0, 'USE_MSG_MORE': 0},
+         'sendmsg': {'SEND_COALESCE': 1, 'USE_MSG_MORE': 0},
+         'sendmsg+MSG_MORE': {'SEND_COALESCE': 1, 'USE_MSG_MORE': 1}}
+client_threads = 4
+ring_size = 256
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "simple_iou_server", "simple_iou_client"],
+                 cwd=build_dir)
+
+
+def run(build_dir="build"):
+  server_process = subprocess.Popen(["./simple_iou_server"], cwd=build_dir,
+                                    stdout=subprocess.PIPE, text=True)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./simple_iou_client"], cwd=build_dir,
+                                   stdout=subprocess.PIPE, text=True,
+                                   timeout=120)
+    time.sleep(1)
+  finally:
+    server_process.terminate()
+    server_output, _ = server_process.communicate()
+  return client_output.stdout, server_output
+
+
+def parse_output(client_output, server_output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) it/s', client_output)
+  reports = re.findall(r'(\d+) pages in (\d+) sends and (\d+) segments',
+                       server_output)
+  pages = sum(int(report[0]) for report in reports)
+  sends = sum(int(report[1]) for report in reports)
+  segments = sum(int(report[2]) for report in reports)
+  return (rate_match.group(1) if rate_match else "N/A", pages, sends,
+          segments, f'{pages / segments:.2f}' if segments else "N/A")
+
+
+with open('send_coalesce_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'MODE', 'Average Rate (it/s)', 'Pages',
+                   'Sends', 'Segments', 'Pages per segment'])
+  port = initial_port
+  for page_size in page_sizes:
+    for mode, flags in modes.items():
+      print(f" ### Running PAGE_SIZE={page_size}, MODE={mode}")
+      build({'PAGE_SIZE': page_size, 'RING_SIZE': ring_size,
+             'NUM_REQUESTS': num_requests, 'CLIENT_THREADS': client_threads,
+             'PORT': port, **flags})
+      port += 1
+      writer.writerow([page_size, mode, *parse_output(*run())])
+
+with open('send_coalesce_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,89 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Aggregate throughput of a cluster of local server_iou processes, each with a
+# single reactor, as pages are sharded over more of them by the client's
+# consistent-hash ring. Multi-gets are split per server and their parts sent
+# in parallel.
+page_size = 4096
+page_count = 256 * 1024
+server_counts = [1, 2, 4, 8]
+multi_get_sizes = [1, 8]
+client_threads = 8
+pipeline_depth = 64
+num_requests = 4 * 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def start_server(env, build_dir):
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir, env=env,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  for line in server_process.stdout:
+    if "Server started" in line:
+      break
+  return server_process
+
+
+def run(servers, env, port, build_dir="build"):
+  base_env = dict(os.environ, LOGGING_LEVEL="INFO", PAGE_COUNT=str(page_count),
+                  REACTOR_THREADS="1", FILL_MODE="lazy")
+  processes = []
+  try:
+    for i in range(servers):
+      processes.append(start_server(dict(base_env, PORT=str(port + i)),
+                                    build_dir))
+    time.sleep(1)
+    endpoints = ",".join(f"127.0.0.1:{port + i}" for i in range(servers))
+    client_env = dict(base_env, ENDPOINTS=endpoints, SHARDING="1",
+                      CLIENT_THREADS=str(client_threads),
+                      PIPELINE_DEPTH=str(pipeline_depth),
+                      NUM_REQUESTS=str(num_requests), **env)
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=client_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    for process in processes:
+      process.terminate()
+      process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  latency = re.search(r'Latency p50: ([\d.]+) us, p99: ([\d.]+) us', output)
+  incorrect = re.search(r'Incorrect responses: (\d+)', output)
+  return ([rate.group(1) if rate else "N/A"] +
+          (list(latency.groups()) if latency else ["N/A"] * 2) +
+          [incorrect.group(1) if incorrect else "N/A"])
+
+
+with open('sharding_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['SERVERS', 'MULTI_GET_SIZE', 'Average Rate (req/s)',
+                   'p50 (us)', 'p99 (us)', 'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for multi_get_size in multi_get_sizes:
+    for servers in server_counts:
+      print(f" ### Running SERVERS={servers}, "
+            f"MULTI_GET_SIZE={multi_get_size}")
+      env = {'MULTI_GET_SIZE': str(multi_get_size)}
+      writer.writerow([servers, multi_get_size,
+                       *parse_output(run(servers, env, port))])
+      port += servers
+
+with open('sharding_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
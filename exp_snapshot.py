@@ -0,0 +1,89 @@
+import csv
+import os
+import re
+import subprocess
+
+# Startup time of server_iou when it fills its pages versus when it maps a
+# snapshot written by make_snapshot, plus the rate of a client started right
+# after the server accepts (a snapshot is paged in on first access).
+page_size = 4096
+page_counts = [256 * 1024, 1024 * 1024, 4 * 1024 * 1024]
+sources = ['serial', 'parallel', 'snapshot']
+client_threads = 8
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+snapshot_path = "pages.snap"
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou", "make_snapshot"],
+                 cwd=build_dir)
+
+
+def make_snapshot(page_count, build_dir="build"):
+  env = dict(os.environ, LOGGING_LEVEL="INFO", PAGE_COUNT=str(page_count),
+             SNAPSHOT=snapshot_path)
+  output = subprocess.run(["./make_snapshot"], cwd=build_dir, env=env,
+                          stdout=subprocess.PIPE, text=True).stdout
+  write_match = re.search(r'in (\d+\.\d+) s, (\d+\.\d+) GB/s', output)
+  print(write_match.group(0) if write_match else output)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Accepting after" in line:
+      break
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(server_output, client_output):
+  accept_match = re.search(r'Accepting after (\d+\.\d+) s', server_output)
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  incorrect_match = re.search(r'Incorrect responses: (\d+)', client_output)
+  return (accept_match.group(1) if accept_match else "N/A",
+          rate_match.group(1) if rate_match else "N/A",
+          incorrect_match.group(1) if incorrect_match else "N/A")
+
+
+with open('snapshot_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_COUNT', 'SOURCE', 'Time to accept (s)',
+                   'Average Rate (req/s)', 'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for page_count in page_counts:
+    make_snapshot(page_count)
+    for source in sources:
+      print(f" ### Running PAGE_COUNT={page_count}, SOURCE={source}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'PAGE_COUNT': str(page_count), 'KEY_DISTRIBUTION': 'uniform',
+             'CLIENT_THREADS': str(client_threads),
+             'REACTOR_THREADS': str(reactor_threads)}
+      if source == 'snapshot':
+        env['SNAPSHOT'] = snapshot_path
+      else:
+        env['FILL_MODE'] = source
+      port += 1
+      writer.writerow([page_count, source, *parse_output(*run(env))])
+
+with open('snapshot_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
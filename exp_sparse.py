@@ -0,0 +1,83 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Dense page numbers versus 64-bit ids through the sparse page index, as the
+# store grows. Requests pick random pages so every lookup misses the caches.
+# The largest store needs roughly 8 GB for page data and PageStore slots.
+page_size = 16
+page_counts = [1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024,
+               128 * 1024 * 1024]
+client_threads = 8
+reactor_threads = 4
+num_requests = 4 * 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Server started" in line:
+      break
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(server_output, client_output):
+  index_match = re.search(r'Sparse page index: \d+ ids, (\d+) bytes on .*, '
+                          r'built in (\d+\.\d+) s', server_output)
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  latency_match = re.search(r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us',
+                            client_output)
+  incorrect_match = re.search(r'Incorrect responses: (\d+)', client_output)
+  return (index_match.group(1) if index_match else "0",
+          index_match.group(2) if index_match else "0",
+          rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          incorrect_match.group(1) if incorrect_match else "N/A")
+
+
+with open('sparse_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_COUNT', 'SPARSE', 'Index bytes', 'Index build (s)',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for page_count in page_counts:
+    for sparse in ['0', '1']:
+      print(f" ### Running PAGE_COUNT={page_count}, SPARSE={sparse}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'PAGE_COUNT': str(page_count), 'SPARSE': sparse,
+             'KEY_DISTRIBUTION': 'uniform',
+             'CLIENT_THREADS': str(client_threads),
+             'REACTOR_THREADS': str(reactor_threads)}
+      port += 1
+      writer.writerow([page_count, sparse, *parse_output(*run(env))])
+
+with open('sparse_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
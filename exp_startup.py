@@ -0,0 +1,79 @@
+import csv
+import os
+import re
+import subprocess
+
+# Time until server_iou accepts connections and until every page is filled,
+# for each FILL_MODE. With lazy filling a client starts right after the server
+# accepts, so its rate shows what serving during warm-up costs.
+page_size = 4096
+page_counts = [256 * 1024, 1024 * 1024, 4 * 1024 * 1024]
+fill_modes = ['serial', 'parallel', 'lazy']
+client_threads = 8
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  server_output = ""
+  for line in server_process.stdout:
+    server_output += line
+    if "Accepting after" in line:
+      break
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+    if env['FILL_MODE'] == 'lazy':
+      for line in server_process.stdout:
+        server_output += line
+        if "Page store warm after" in line:
+          break
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return server_output, client_output.stdout
+
+
+def parse_output(server_output, client_output):
+  accept_match = re.search(r'Accepting after (\d+\.\d+) s', server_output)
+  warm_match = re.search(r'Page store warm after (\d+\.\d+) s', server_output)
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', client_output)
+  accept = accept_match.group(1) if accept_match else "N/A"
+  return (accept, warm_match.group(1) if warm_match else accept,
+          rate_match.group(1) if rate_match else "N/A")
+
+
+with open('startup_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_COUNT', 'FILL_MODE', 'Time to accept (s)',
+                   'Time to warm (s)', 'Average Rate (req/s)'])
+  build({'PAGE_SIZE': page_size})
+  port = initial_port
+  for page_count in page_counts:
+    for fill_mode in fill_modes:
+      print(f" ### Running PAGE_COUNT={page_count}, FILL_MODE={fill_mode}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'PAGE_COUNT': str(page_count), 'FILL_MODE': fill_mode,
+             'KEY_DISTRIBUTION': 'uniform',
+             'CLIENT_THREADS': str(client_threads),
+             'REACTOR_THREADS': str(reactor_threads)}
+      port += 1
+      writer.writerow([page_count, fill_mode, *parse_output(*run(env))])
+
+with open('startup_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,97 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Bulk export with STREAM_PAGES against the raw one-way bandwidth of
+# max_client -> max_server moving the same number of bytes over the same
+# number of connections. Streams are sent zero-copy (send_zc straight from
+# page memory) or copied, in chunks of different sizes.
+page_size = 4096
+page_count = 256 * 1024
+client_threads = [1, 4]
+chunk_sizes = [64 * 1024, 1024 * 1024]
+stream_pages = 16 * 1024
+reactor_threads = 4
+initial_port = 12348
+
+
+def build(config, targets, build_dir):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", *targets], cwd=build_dir)
+
+
+def run_stream(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+  for line in server_process.stdout:
+    if "Server started" in line:
+      break
+  time.sleep(1)
+  try:
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=600)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  gbps = re.search(r'Payload throughput: (\d+\.\d+) Gb/s',
+                   client_output.stdout)
+  incorrect = re.search(r'Incorrect responses: (\d+)', client_output.stdout)
+  return (gbps.group(1) if gbps else "N/A",
+          incorrect.group(1) if incorrect else "N/A")
+
+
+def run_raw(build_dir):
+  server_process = subprocess.Popen(["./max_server"], cwd=build_dir,
+                                    stdout=subprocess.PIPE, text=True)
+  time.sleep(1)
+  try:
+    subprocess.run(["./max_client"], cwd=build_dir, stdout=subprocess.DEVNULL,
+                   timeout=600)
+    server_output, _ = server_process.communicate(timeout=60)
+  finally:
+    if server_process.poll() is None:
+      server_process.terminate()
+      server_process.communicate()
+  gbps = re.search(r'Throughput: (\d+(\.\d+)?) Gbps', server_output)
+  return gbps.group(1) if gbps else "N/A"
+
+
+with open('stream_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['CLIENT_THREADS', 'MODE', 'STREAM_CHUNK_BYTES',
+                   'Throughput (Gb/s)', 'Incorrect Responses'])
+  build({'PAGE_SIZE': page_size}, ["server_iou", "client_iou"], "build")
+  port = initial_port
+  for threads in client_threads:
+    # The simple binaries count PAGE_SIZE in 32-bit words.
+    raw_dir = f"build_raw_{threads}"
+    build({'PAGE_SIZE': page_size // 4, 'NUM_REQUESTS': page_count,
+           'CLIENT_THREADS': threads, 'PORT': port},
+          ["max_server", "max_client"], raw_dir)
+    port += 1
+    print(f" ### Running raw bandwidth, CLIENT_THREADS={threads}")
+    writer.writerow([threads, 'raw', '', run_raw(raw_dir), ''])
+    for chunk in chunk_sizes:
+      for zerocopy in ['0', '1']:
+        mode = 'send_zc' if zerocopy == '1' else 'send'
+        print(f" ### Running CLIENT_THREADS={threads}, MODE={mode}, "
+              f"STREAM_CHUNK_BYTES={chunk}")
+        env = {'PORT': str(port), 'PAGE_COUNT': str(page_count),
+               'CLIENT_THREADS': str(threads),
+               'REACTOR_THREADS': str(reactor_threads),
+               'STREAM_PAGES': str(stream_pages),
+               'STREAM_CHUNK_BYTES': str(chunk), 'STREAM_ZEROCOPY': zerocopy}
+        port += 1
+        writer.writerow([threads, mode, chunk, *run_stream(env)])
+
+with open('stream_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,76 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Compares the TCP stream server (server_iou/client_iou) with the UDP datagram
+# server (udp_server/udp_client) on requests per second and tail latency.
+page_sizes = [16, 128, 512, 1024]
+client_threads = [1, 8]
+reactor_threads = 4
+num_requests = 1024 * 1024
+initial_port = 12348
+transports = {'tcp': ('server_iou', 'client_iou'),
+              'udp': ('udp_server', 'udp_client')}
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou", "udp_server",
+                  "udp_client"], cwd=build_dir)
+
+
+def run(server, client, env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen([f"./{server}"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    client_output = subprocess.run([f"./{client}"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=120)
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout
+
+
+def parse_output(output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  latency_match = re.search(
+      r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us, p99\.9: (\d+\.\d+) us', output)
+  retries_match = re.search(r'retries: (\d+)', output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          latency_match.group(3) if latency_match else "N/A",
+          retries_match.group(1) if retries_match else "0")
+
+
+with open('udp_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['PAGE_SIZE', 'CLIENT_THREADS', 'TRANSPORT',
+                   'Average Rate (req/s)', 'p50 (us)', 'p99 (us)',
+                   'p99.9 (us)', 'Retries'])
+  port = initial_port
+  for page_size in page_sizes:
+    build({'PAGE_SIZE': page_size})
+    for client_thread in client_threads:
+      for transport, (server, client) in transports.items():
+        print(
+            f" ### Running PAGE_SIZE={page_size}, CLIENT_THREADS={client_thread}, TRANSPORT={transport}")
+        env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+               'CLIENT_THREADS': str(client_thread),
+               'REACTOR_THREADS': str(reactor_threads)}
+        port += 1
+        writer.writerow([page_size, client_thread, transport,
+                         *parse_output(run(server, client, env))])
+
+with open('udp_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
@@ -0,0 +1,87 @@
+import csv
+import os
+import re
+import subprocess
+import time
+
+# Compares reactor wait strategies on server CPU time and client tail latency
+# at low and high load.
+page_size = 4096
+client_threads = [1, 4, 32]
+strategies = ['block', 'spin', 'adaptive']
+reactor_threads = 4
+num_requests = 1024 * 1024
+max_spin_us = 50
+initial_port = 12348
+clock_ticks = os.sysconf('SC_CLK_TCK')
+
+
+def build(config, build_dir="build"):
+  subprocess.run(["mkdir", "-p", build_dir])
+  cmake_command = ["cmake", "..", "-DCMAKE_BUILD_TYPE=Release"] + [
+    f'-D{key}={value}' for key, value in config.items()]
+  subprocess.run(cmake_command, cwd=build_dir)
+  subprocess.run(["make", "-j32", "server_iou", "client_iou"], cwd=build_dir)
+
+
+def cpu_seconds(pid):
+  with open(f'/proc/{pid}/stat') as stat:
+    fields = stat.read().rsplit(')', 1)[1].split()
+  # utime and stime are fields 14 and 15 of the full line.
+  return (int(fields[11]) + int(fields[12])) / clock_ticks
+
+
+def run(env, build_dir="build"):
+  full_env = dict(os.environ, LOGGING_LEVEL="INFO", **env)
+  server_process = subprocess.Popen(["./server_iou"], cwd=build_dir,
+                                    env=full_env, stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.DEVNULL)
+  time.sleep(1)
+  try:
+    cpu_before = cpu_seconds(server_process.pid)
+    client_output = subprocess.run(["./client_iou"], cwd=build_dir,
+                                   env=full_env, stdout=subprocess.PIPE,
+                                   text=True, timeout=120)
+    server_cpu = cpu_seconds(server_process.pid) - cpu_before
+  finally:
+    server_process.terminate()
+    server_process.wait()
+  return client_output.stdout, server_cpu
+
+
+def parse_output(output):
+  rate_match = re.search(r'Average rate: (\d+\.\d+) req/s', output)
+  latency_match = re.search(
+      r'p50: (\d+\.\d+) us, p99: (\d+\.\d+) us, p99\.9: (\d+\.\d+) us', output)
+  time_match = re.search(r'requests: (\d+\.\d+) s', output)
+  return (rate_match.group(1) if rate_match else "N/A",
+          latency_match.group(1) if latency_match else "N/A",
+          latency_match.group(2) if latency_match else "N/A",
+          time_match.group(1) if time_match else "N/A")
+
+
+with open('wait_strategy_results.csv', 'w', newline='') as file:
+  writer = csv.writer(file)
+  writer.writerow(['CLIENT_THREADS', 'WAIT_STRATEGY', 'Average Rate (req/s)',
+                   'p50 (us)', 'p99 (us)', 'Server CPU (s)',
+                   'Server CPU per request (us)'])
+  port = initial_port
+  build({'PAGE_SIZE': page_size})
+  for client_thread in client_threads:
+    for strategy in strategies:
+      print(
+          f" ### Running CLIENT_THREADS={client_thread}, WAIT_STRATEGY={strategy}")
+      env = {'PORT': str(port), 'NUM_REQUESTS': str(num_requests),
+             'CLIENT_THREADS': str(client_thread),
+             'REACTOR_THREADS': str(reactor_threads),
+             'WAIT_STRATEGY': strategy, 'MAX_SPIN_US': str(max_spin_us)}
+      port += 1
+      output, server_cpu = run(env)
+      rate, p50, p99, _ = parse_output(output)
+      writer.writerow([client_thread, strategy, rate, p50, p99,
+                       f'{server_cpu:.2f}',
+                       f'{server_cpu * 1e6 / num_requests:.2f}'])
+
+with open('wait_strategy_results.csv', 'r') as file:
+  for line in file:
+    print(line, end='')
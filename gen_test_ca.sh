@@ -0,0 +1,20 @@
+#!/bin/bash
+# Creates a throwaway CA and a server certificate signed by it for TLS=1 runs.
+# usage: gen_test_ca.sh [output directory]   (default: build/certs)
+set -e
+
+dir=${1:-build/certs}
+mkdir -p "$dir"
+cd "$dir"
+
+openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+  -days 365 -subj "/CN=fast_net test CA" -keyout ca.key -out ca.crt
+
+openssl req -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+  -subj "/CN=localhost" -keyout server.key -out server.csr
+openssl x509 -req -in server.csr -CA ca.crt -CAkey ca.key -CAcreateserial \
+  -days 365 -out server.crt \
+  -extfile <(printf "subjectAltName=DNS:localhost,IP:127.0.0.1")
+rm server.csr
+
+echo "Wrote CA and server certificate to $dir"
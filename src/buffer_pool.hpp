@@ -1,19 +1,25 @@
+#pragma once
+
 #include <algorithm>
 #include <cstdlib>
 #include <unordered_map>
 #include <vector>
 
+#include "huge_pages.hpp"
 #include "simple_consts.hpp"
 
 class BufferPool {
  public:
+  // With HUGE_PAGES the initial buffers are carved from one huge-page arena;
+  // buffers allocated beyond it still come from malloc.
   explicit BufferPool(const std::vector<size_t>& buffer_sizes,
-                      size_t initial_capacity = 10) {
+                      size_t initial_capacity = 10)
+      : arena(HUGE_PAGES ? arena_size(buffer_sizes, initial_capacity) : 0) {
 #if !ALLOCATE_MALLOC
     for (size_t size : buffer_sizes) {
       pools[size].reserve(initial_capacity);
       for (size_t j = 0; j < initial_capacity; ++j) {
-        pools[size].push_back(static_cast<char*>(std::malloc(size)));
+        pools[size].push_back(new_buffer(size));
       }
     }
 #endif
@@ -23,7 +29,7 @@ class BufferPool {
 #if !ALLOCATE_MALLOC
     for (auto& [size, pool] : pools) {
       for (auto buffer : pool) {
-        std::free(buffer);
+        release(buffer);
       }
     }
 #endif
@@ -58,9 +64,40 @@ class BufferPool {
       }
     }
 #endif
-    std::free(buffer);
+    release(buffer);
   }
 
+  [[nodiscard]] HugePageMode arena_mode() const { return arena.mode(); }
+
  private:
+  static constexpr size_t ARENA_ALIGNMENT = 64;
+
+  static size_t arena_size(const std::vector<size_t>& buffer_sizes,
+                           const size_t initial_capacity) {
+    size_t total = 0;
+    for (size_t size : buffer_sizes) {
+      total += round_up(size, ARENA_ALIGNMENT) * initial_capacity;
+    }
+    return total;
+  }
+
+  char* new_buffer(const size_t size) {
+    const size_t aligned = round_up(size, ARENA_ALIGNMENT);
+    if (arena_used + aligned <= arena.size()) {
+      char* buffer = reinterpret_cast<char*>(arena.data() + arena_used);
+      arena_used += aligned;
+      return buffer;
+    }
+    return static_cast<char*>(std::malloc(size));
+  }
+
+  void release(char* buffer) {
+    if (!arena.contains(buffer)) {
+      std::free(buffer);
+    }
+  }
+
+  HugePageBuffer arena;
+  size_t arena_used = 0;
   std::unordered_map<size_t, std::vector<char*>> pools;
-};
\ No newline at end of file
+};
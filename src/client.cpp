@@ -55,7 +55,8 @@ int main() {
   for (int i = 0; i < Config::num_requests; ++i) {
     auto start = std::chrono::high_resolution_clock::now();
 
-    request.request_id = i;
+    request.header.type = GET_PAGE;
+    request.header.request_id = i;
     request.page_number = i % Config::page_count;
     request.to_network_order();
     if (send(sock, &request, sizeof(request), 0) != sizeof(request)) {
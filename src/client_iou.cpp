@@ -4,35 +4,61 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "consts.hpp"
+#include "crc32c.hpp"
+#include "hedge_delay.hpp"
 #include "memory_block.hpp"
 #include "models/get_page.hpp"
+#include "models/hello.hpp"
+#include "models/put_page.hpp"
+#include "page_codec.hpp"
+#include "page_index.hpp"
 #include "spdlog/spdlog.h"
 #include "static_config.hpp"
 #include "utils.hpp"
 #include "io_uring_utils.hpp"
-
-#define BATCH_SIZE 64
+#include "key_distribution.hpp"
+#include "ktls.hpp"
+#include "latency_recorder.hpp"
+#include "shard_ring.hpp"
+#include "trace.hpp"
 
 struct custom_request {
   int event_type;
 };
 
-enum EventType { SEND, RECEIVE };
+enum EventType { SEND, RECEIVE, HEDGE_TIMER, CANCEL };
+
+// With TLS the socket stays blocking until the handshake is done.
+int setup_socket(const char* addr, int port, const TlsContext* tls) {
+  if (!Config::unix_socket.empty()) {
+    int sock = connect_unix_socket(Config::unix_socket);
+    if (sock != -1) {
+      fcntl(sock, F_SETFL, O_NONBLOCK);
+    }
+    return sock;
+  }
 
-int setup_socket(const char* addr, int port) {
   int sock = socket(AF_INET, SOCK_STREAM, 0);
   if (sock == -1) {
     spdlog::error("Socket creation failed");
     return -1;
   }
 
-  fcntl(sock, F_SETFL, O_NONBLOCK);
+  if (tls == nullptr) {
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+  }
 
   struct sockaddr_in serv_addr {};
   memset(&serv_addr, 0, sizeof(serv_addr));
@@ -48,67 +74,265 @@ int setup_socket(const char* addr, int port) {
     }
   }
 
+  if (tls != nullptr) {
+    std::string error;
+    if (!tls->handshake(sock, error)) {
+      spdlog::error("TLS handshake failed: {}", error);
+      close(sock);
+      return -1;
+    }
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+  }
   return sock;
 }
 
-void send_requests(struct io_uring& ring, int sock,
-                   std::vector<GetPageRequest>& requests, size_t start,
-                   size_t end) {
-  for (size_t j = start; j < end; j++) {
-    spdlog::debug("Creating request {} {}", start, j);
-    uint32_t request_id = j;
+struct ClientStats {
+  size_t reads = 0;
+  size_t writes = 0;
+  size_t stale_reads = 0;
+  size_t wire_bytes = 0;
+  size_t payload_bytes = 0;
+  size_t decode_errors = 0;
+  size_t checksum_failures = 0;
+  size_t overloaded = 0;
+  size_t expired = 0;
+  // Copies sent to a second endpoint, how many of them answered first, and
+  // the responses that arrived after their request was already answered.
+  size_t hedges = 0;
+  size_t hedge_wins = 0;
+  size_t late_responses = 0;
+  // Pages answered by each endpoint of a cluster thread.
+  std::vector<size_t> endpoint_responses;
+  uint32_t features = 0;
+  LatencyRecorder latency;
+};
+
+// Spreads WRITE_PERCENT of the request slots evenly over the run.
+bool is_write(const size_t j) {
+  return (j * 2654435761u >> 7) % 100 < Config::write_percent;
+}
+
+// What one client thread sends: request slots [first, end()) and the page of
+// each. A replayed trace also fixes which slots are writes, which are lookups
+// by a recorded id, and when each is due, in ns after the replay started.
+struct ThreadPlan {
+  size_t first = 0;
+  std::vector<uint32_t> pages;
+  std::vector<uint8_t> writes;
+  // PageIndex::EMPTY for slots that are not lookups by id.
+  std::vector<uint64_t> page_ids;
+  std::vector<uint64_t> due_ns;
 
-    auto* request = &requests[j];
-    request->request_id = request_id;
-    request->page_number = j % Config::page_count;
-    request->to_network_order();
+  [[nodiscard]] size_t end() const { return first + pages.size(); }
 
-    struct io_uring_sqe* sqe_send = io_uring_get_sqe(&ring);
-    auto* req_send = new custom_request{SEND};
-    io_uring_sqe_set_data(sqe_send, req_send);
-    io_uring_prep_send(sqe_send, sock, request, sizeof(GetPageRequest), 0);
+  [[nodiscard]] uint32_t page(const size_t j) const {
+    return pages[j - first];
   }
 
-  io_uring_submit(&ring);
+  [[nodiscard]] bool is_write(const size_t j) const {
+    return writes.empty() ? ::is_write(j) : writes[j - first] != 0;
+  }
+
+  [[nodiscard]] bool has_page_id(const size_t j) const {
+    return !page_ids.empty() && page_ids[j - first] != PageIndex::EMPTY;
+  }
+
+  [[nodiscard]] bool paced() const { return !due_ns.empty(); }
+
+  // The first slot in [from, to) not yet due `elapsed_ns` into the replay.
+  [[nodiscard]] size_t due_until(const size_t from, const size_t to,
+                                 const uint64_t elapsed_ns) const {
+    if (!paced()) {
+      return to;
+    }
+    return first + (std::upper_bound(due_ns.begin() + (from - first),
+                                     due_ns.begin() + (to - first),
+                                     elapsed_ns) -
+                    due_ns.begin());
+  }
+};
+
+void append_frame(std::vector<uint8_t>& out, const void* frame, size_t size) {
+  const size_t offset = out.size();
+  out.resize(offset + size);
+  memcpy(out.data() + offset, frame, size);
 }
 
-void receive_responses(struct io_uring& ring, int sock,
-                       std::vector<GetPageResponse*>& responses, size_t start,
-                       size_t end) {
-  size_t num_responses = end - start;
+// Appends the request frames for slots [start, end) to `out`. With
+// MULTI_GET_SIZE > 1 consecutive reads are grouped into multi-get requests.
+// Writes store the content the verifier expects, so reads stay verifiable.
+void build_requests(std::vector<uint8_t>& out, size_t start, size_t end,
+                    const ThreadPlan& plan, const IFillingStrategy* strategy) {
+  const size_t pages_per_request =
+      std::min<size_t>(std::max<size_t>(Config::multi_get_size, 1),
+                       MAX_MULTI_GET_PAGES);
+  const auto priority =
+      static_cast<uint8_t>(std::min<size_t>(Config::priority, MAX_PRIORITY));
+  const uint64_t deadline_us =
+      Config::deadline_us > 0 ? realtime_us() + Config::deadline_us : 0;
+  size_t j = start;
+  while (j < end) {
+    spdlog::debug("Creating request {} {}", start, j);
+    const uint32_t page_number = plan.page(j);
 
-  for (size_t j = start; j < end; j++) {
-    struct io_uring_sqe* sqe_recv = io_uring_get_sqe(&ring);
-    auto* req_recv = new custom_request{RECEIVE};
-    io_uring_sqe_set_data(sqe_recv, req_recv);
-    io_uring_prep_recv(sqe_recv, sock, responses[j], sizeof(GetPageResponse),
-                       0);
+    if (plan.is_write(j)) {
+      PutPageRequest request{};
+      request.header.type = PUT_PAGE;
+      request.header.priority = priority;
+      request.header.request_id = j;
+      request.page_number = page_number;
+      for (size_t i = 0; i < PAGE_SIZE; ++i) {
+        request.content[i] =
+            strategy->get_value_at(page_number * PAGE_SIZE + i);
+      }
+      request.to_network_order();
+      append_frame(out, &request, sizeof(request));
+      j++;
+    } else if (plan.has_page_id(j) ||
+               (pages_per_request == 1 && Config::sparse)) {
+      GetPageByIdRequest request{};
+      request.header.type = GET_PAGE_BY_ID;
+      request.header.priority = priority;
+      request.header.request_id = j;
+      request.page_id = plan.has_page_id(j) ? plan.page_ids[j - plan.first]
+                                            : sparse_page_id(page_number);
+      request.to_network_order();
+      append_frame(out, &request, sizeof(request));
+      j++;
+    } else if (pages_per_request == 1 && deadline_us > 0) {
+      DeadlineGetPageRequest request{};
+      request.header.type = GET_PAGE_WITH_DEADLINE;
+      request.header.priority = priority;
+      request.header.request_id = j;
+      request.page_number = page_number;
+      request.deadline_us = deadline_us;
+      request.to_network_order();
+      append_frame(out, &request, sizeof(request));
+      j++;
+    } else if (pages_per_request == 1) {
+      GetPageRequest request{};
+      request.header.type = GET_PAGE;
+      request.header.priority = priority;
+      request.header.request_id = j;
+      request.page_number = page_number;
+      request.to_network_order();
+      append_frame(out, &request, sizeof(request));
+      j++;
+    } else {
+      MultiGetPageRequest request{};
+      request.header.type = MULTI_GET_PAGE;
+      request.header.priority = priority;
+      request.header.request_id = j;
+      request.page_count = 0;
+      while (j < end && request.page_count < pages_per_request &&
+             !plan.is_write(j) && !plan.has_page_id(j)) {
+        request.page_numbers[request.page_count++] = plan.page(j);
+        j++;
+      }
+      const size_t size = request.size();
+      request.to_network_order();
+      append_frame(out, &request, size);
+    }
   }
+}
 
-  io_uring_submit(&ring);
+void append_hello(std::vector<uint8_t>& out) {
+  HelloRequest request{};
+  request.header.type = HELLO;
+  request.header.request_id = HELLO_REQUEST_ID;
+  if (Config::compression) {
+    request.features |= FEATURE_COMPRESSION;
+  }
+  if (Config::checksums) {
+    request.features |= FEATURE_CHECKSUM;
+  }
+  request.to_network_order();
+  append_frame(out, &request, sizeof(request));
+}
 
-  for (size_t j = 0; j < num_responses; j++) {
-    struct io_uring_cqe* cqe;
-    auto r = io_uring_wait_cqe(&ring, &cqe);
-    if (r < 0) {
-      spdlog::error("Wait for response failed: {}", strerror(-r));
-      throw std::runtime_error("Wait for response failed");
+void prep_send(struct io_uring& ring, int sock, custom_request* req,
+               const std::vector<uint8_t>& out, size_t sent) {
+  struct io_uring_sqe* sqe = get_sqe(ring);
+  io_uring_prep_send(sqe, sock, out.data() + sent, out.size() - sent, 0);
+  io_uring_sqe_set_data(sqe, req);
+}
+
+// Copies every complete response frame in `in` into the response slots
+// starting at `received`. Returns the number of frames consumed.
+size_t consume_responses(std::vector<uint8_t>& in, size_t& in_used,
+                         std::vector<GetPageResponse*>& responses,
+                         size_t received, size_t end, ClientStats& stats,
+                         std::unordered_map<uint32_t, uint32_t>& versions) {
+  size_t offset = 0;
+  size_t count = 0;
+  while (in_used - offset >= sizeof(GetPageResponseHeader) &&
+         received < end) {
+    GetPageResponseHeader header{};
+    memcpy(&header, in.data() + offset, sizeof(header));
+    header.to_host_order();
+    if (header.content_length > PAGE_SIZE) {
+      spdlog::error("Response content too large: {}", header.content_length);
+      throw std::runtime_error("Malformed response");
     }
-    auto* req = (custom_request*)io_uring_cqe_get_data(cqe);
-    if (req->event_type == SEND) {
-      spdlog::debug("Sent request {}", j);
-      j--;
+    const size_t frame_size = sizeof(header) + header.content_length;
+    if (in_used - offset < frame_size) {
+      break;
     }
-    if (((req->event_type == SEND && cqe->res == 140)
-        || (req->event_type == RECEIVE && cqe->res == 8))) {
-      spdlog::debug("CQE->RES {} ({})", cqe->res, req->event_type);
+
+    const uint8_t* frame = in.data() + offset;
+    if (header.request_id == HELLO_REQUEST_ID) {
+      uint32_t features = 0;
+      memcpy(&features, frame + sizeof(header), sizeof(features));
+      stats.features = ntohl(features);
+      offset += frame_size;
+      continue;
     }
-    if (cqe->res < 0) {
-      spdlog::error("IO operation failed: {}", strerror(-cqe->res));
-      throw std::runtime_error("IO operation failed");
+
+    GetPageResponse* response = responses[received++];
+    if (header.flags & RESPONSE_COMPRESSED) {
+      // Decode straight into the response slot while the frame is still hot.
+      if (!page_codec::decompress(frame + sizeof(header), header.content_length,
+                                  response->content.data(), PAGE_SIZE)) {
+        stats.decode_errors++;
+      }
+      GetPageResponseHeader decoded = header;
+      decoded.flags = 0;
+      decoded.content_length = PAGE_SIZE;
+      decoded.to_network_order();
+      response->header = decoded;
+    } else {
+      memcpy(response, frame, frame_size);
     }
-    io_uring_cqe_seen(&ring, cqe);
+    // Checked right after the page landed, while it is still in cache.
+    if ((header.flags & RESPONSE_CHECKSUMMED) &&
+        crc32c(response->content.data(), PAGE_SIZE) != header.checksum) {
+      spdlog::error("Checksum mismatch for page {}", header.page_number);
+      stats.checksum_failures++;
+    }
+    if (header.status == OVERLOADED) {
+      stats.overloaded++;
+    } else if (header.status == DEADLINE_EXCEEDED) {
+      stats.expired++;
+    } else if (header.content_length == 0) {
+      stats.writes++;
+    } else {
+      stats.reads++;
+      stats.payload_bytes += sizeof(header) + PAGE_SIZE;
+    }
+    if (header.status == SUCCESS) {
+      auto& latest = versions[header.page_number];
+      if (header.version < latest) {
+        stats.stale_reads++;
+      } else {
+        latest = header.version;
+      }
+    }
+    offset += frame_size;
+    count++;
   }
+  memmove(in.data(), in.data() + offset, in_used - offset);
+  in_used -= offset;
+  return count;
 }
 
 void verify_responses(std::vector<GetPageResponse*>& responses,
@@ -118,6 +342,9 @@ void verify_responses(std::vector<GetPageResponse*>& responses,
   for (auto* response : responses) {
     if (response) {
       response->to_host_order();
+      if (response->header.content_length == 0) {
+        continue;
+      }
       if (!verifier.verify(response->content, response->header.page_number)) {
         spdlog::error("Response req id {}", response->header.request_id);
         spdlog::debug("Response status {}", response->header.status);
@@ -135,53 +362,855 @@ void verify_responses(std::vector<GetPageResponse*>& responses,
   }
 }
 
-void client_thread(const char* addr, int port, size_t start, size_t end,
-                   std::vector<GetPageRequest>& requests,
-                   std::vector<GetPageResponse*>& responses) {
+void client_thread(const char* addr, int port, const ThreadPlan& plan,
+                   std::vector<GetPageResponse*>& responses,
+                   const IFillingStrategy* strategy, ClientStats& stats,
+                   const TlsContext* tls, const uint64_t replay_start_ns) {
+  const size_t start = plan.first;
+  const size_t end = plan.end();
   struct io_uring ring {};
   setup_io_uring(ring);
 
-  int sock = setup_socket(addr, port);
+  int sock = setup_socket(addr, port, tls);
+  if (sock < 0) return;
+
+  custom_request send_req{SEND};
+  custom_request recv_req{RECEIVE};
+  std::vector<uint8_t> out;
+  size_t out_sent = 0;
+  bool send_in_flight = false;
+  std::vector<uint8_t> in(
+      std::max(CONNECTION_BUFFER_SIZE, 4 * sizeof(GetPageResponse)));
+  size_t in_used = 0;
+  bool recv_in_flight = false;
+
+  std::unordered_map<uint32_t, uint32_t> versions;
+  const size_t window = std::max<size_t>(Config::pipeline_depth, 1);
+  // Send time of every response slot, for per-request latency.
+  std::vector<uint64_t> sent_ns(end - start);
+  size_t next = start;
+  size_t received = start;
+  if (Config::compression || Config::checksums) {
+    append_hello(out);
+  }
+  while (received < end) {
+    // Set when the window has room but the next replayed request is not due.
+    uint64_t wake_ns = 0;
+    if (!send_in_flight && next < end && next - received < window) {
+      const uint64_t now = now_ns();
+      const size_t batch_end = plan.due_until(
+          next, std::min(end, received + window), now - replay_start_ns);
+      if (batch_end > next) {
+        build_requests(out, next, batch_end, plan, strategy);
+        // Paced requests count from when they were due, so a server that
+        // falls behind the trace shows up in the latency.
+        for (size_t j = next; j < batch_end; ++j) {
+          sent_ns[j - start] =
+              plan.paced() ? replay_start_ns + plan.due_ns[j - start] : now;
+        }
+        next = batch_end;
+        out_sent = 0;
+        prep_send(ring, sock, &send_req, out, out_sent);
+        send_in_flight = true;
+      } else {
+        wake_ns = replay_start_ns + plan.due_ns[next - start];
+      }
+    }
+    if (!recv_in_flight) {
+      struct io_uring_sqe* sqe = get_sqe(ring);
+      io_uring_prep_recv(sqe, sock, in.data() + in_used, in.size() - in_used,
+                         0);
+      io_uring_sqe_set_data(sqe, &recv_req);
+      recv_in_flight = true;
+    }
+    io_uring_submit(&ring);
+
+    struct io_uring_cqe* cqe;
+    int r;
+    if (wake_ns != 0) {
+      const uint64_t delay = wake_ns - std::min(wake_ns, now_ns());
+      struct __kernel_timespec timeout {};
+      timeout.tv_sec = static_cast<long long>(delay / 1000000000);
+      timeout.tv_nsec = static_cast<long long>(delay % 1000000000);
+      r = io_uring_wait_cqe_timeout(&ring, &cqe, &timeout);
+      if (r == -ETIME) {
+        continue;
+      }
+    } else {
+      r = io_uring_wait_cqe(&ring, &cqe);
+    }
+    if (r < 0) {
+      spdlog::error("Wait for response failed: {}", strerror(-r));
+      throw std::runtime_error("Wait for response failed");
+    }
+
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&ring, head, cqe) {
+      auto* req = (custom_request*)io_uring_cqe_get_data(cqe);
+      count++;
+      if (cqe->res < 0) {
+        spdlog::error("IO operation failed: {}", strerror(-cqe->res));
+        throw std::runtime_error("IO operation failed");
+      }
+      if (req->event_type == SEND) {
+        out_sent += cqe->res;
+        if (out_sent < out.size()) {
+          prep_send(ring, sock, &send_req, out, out_sent);
+        } else {
+          spdlog::debug("Sent requests up to {}", next);
+          out.clear();
+          send_in_flight = false;
+        }
+      } else {
+        recv_in_flight = false;
+        if (cqe->res == 0) {
+          spdlog::error("Server closed connection");
+          throw std::runtime_error("Server closed connection");
+        }
+        in_used += cqe->res;
+        stats.wire_bytes += cqe->res;
+        const size_t first = received;
+        received += consume_responses(in, in_used, responses, received, end,
+                                      stats, versions);
+        const uint64_t now = now_ns();
+        for (size_t j = first; j < received; ++j) {
+          stats.latency.record(now - sent_ns[j - start]);
+        }
+      }
+    }
+    io_uring_cq_advance(&ring, count);
+  }
+
+  close(sock);
+  io_uring_queue_exit(&ring);
+}
+
+struct EndpointOp : custom_request {
+  size_t endpoint;
+};
+
+// One thread's connection to one endpoint. Frames queue up while a send is in
+// flight and go out together once it completes.
+struct EndpointConnection {
+  int sock = -1;
+  EndpointOp send_req{};
+  EndpointOp recv_req{};
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> queued;
+  size_t out_sent = 0;
+  bool send_in_flight = false;
+  std::vector<uint8_t> in;
+  size_t in_used = 0;
+  bool recv_in_flight = false;
+  // Responses owed, and a moving average of their latency in ns, to tell how
+  // loaded the endpoint is.
+  size_t outstanding = 0;
+  double latency_ns = 0;
+};
+
+// A request slot of a cluster thread: a single read or write, or a multi-get
+// covering `count` slots whose pages may be split over several endpoints. It
+// doubles as the user data of the slot's hedge timer, so it is only reused
+// once the timer has completed.
+struct ClusterRequest : custom_request {
+  ClusterRequest() : custom_request{HEDGE_TIMER} {}
+
+  size_t slot = 0;
+  size_t count = 0;
+  size_t primary = 0;
+  uint64_t sent_ns = 0;
+  uint64_t deadline_us = 0;
+  struct __kernel_timespec delay {};
+  // Pages not answered yet, and which of the `count` slots have been.
+  size_t remaining = 0;
+  std::bitset<MAX_MULTI_GET_PAGES> filled;
+  // Copies of a single read sent and not answered yet.
+  uint32_t copies = 0;
+  bool timer_armed = false;
+  bool done = false;
+};
+
+void append_read(std::vector<uint8_t>& out, const size_t j,
+                 const uint32_t page_number, const uint64_t deadline_us) {
+  if (deadline_us == 0) {
+    GetPageRequest request{};
+    request.header.type = GET_PAGE;
+    request.header.request_id = j;
+    request.page_number = page_number;
+    request.to_network_order();
+    append_frame(out, &request, sizeof(request));
+    return;
+  }
+  DeadlineGetPageRequest request{};
+  request.header.type = GET_PAGE_WITH_DEADLINE;
+  request.header.request_id = j;
+  request.page_number = page_number;
+  request.deadline_us = deadline_us;
+  request.to_network_order();
+  append_frame(out, &request, sizeof(request));
+}
+
+// The part of multi-get `j` that goes to one endpoint.
+void append_multi_get_part(std::vector<uint8_t>& out, const size_t j,
+                           const std::vector<uint32_t>& pages) {
+  if (pages.size() == 1) {
+    append_read(out, j, pages.front(), 0);
+    return;
+  }
+  MultiGetPageRequest request{};
+  request.header.type = MULTI_GET_PAGE;
+  request.header.request_id = j;
+  request.page_count = pages.size();
+  std::copy(pages.begin(), pages.end(), request.page_numbers);
+  const size_t size = request.size();
+  request.to_network_order();
+  append_frame(out, &request, size);
+}
+
+// Serves the thread's requests from one connection per endpoint. Pages are
+// placed by the consistent-hash ring with SHARDING. With READ_BALANCING the
+// first endpoint is the primary, which takes every write and replicates it
+// to the others, and each read goes to the endpoint with the least
+// outstanding work weighted by its recent latency. Otherwise requests go
+// round robin. A multi-get is split by owner into one part per endpoint, the parts
+// are sent together and the request completes when the last page is in.
+//
+// With HEDGE_PERCENTILE set, every single read arms a timer for that
+// percentile of recent latencies; if it fires before the read is answered, a
+// copy with the same deadline goes to the next endpoint (the owner's
+// successor on the ring) and whichever answers first wins. A read answered in
+// time cancels its timer with IORING_OP_ASYNC_CANCEL; the losing copy's
+// response is dropped when it arrives, and a server that only gets to it
+// after the deadline skips the lookup. Writes and multi-gets are not hedged.
+// Responses are matched by request id and page number, since endpoints answer
+// independently. Replayed traces are sent as fast as the window allows.
+void cluster_thread(const std::vector<Endpoint>& endpoints,
+                    const ShardRing* ring_map, const ThreadPlan& plan,
+                    std::vector<GetPageResponse*>& responses,
+                    const IFillingStrategy* strategy, ClientStats& stats,
+                    const TlsContext* tls) {
+  const size_t start = plan.first;
+  const size_t end = plan.end();
+  struct io_uring ring {};
+  setup_io_uring(ring);
+
+  std::vector<EndpointConnection> connections(endpoints.size());
+  for (size_t i = 0; i < endpoints.size(); ++i) {
+    EndpointConnection& connection = connections[i];
+    connection.sock =
+        setup_socket(endpoints[i].host.c_str(), endpoints[i].port, tls);
+    if (connection.sock < 0) {
+      throw std::runtime_error("Cannot connect to " + endpoints[i].host);
+    }
+    connection.send_req = {{SEND}, i};
+    connection.recv_req = {{RECEIVE}, i};
+    connection.in.resize(
+        std::max(CONNECTION_BUFFER_SIZE, 4 * sizeof(GetPageResponse)));
+  }
+
+  // The endpoint chosen for the request being built with READ_BALANCING.
+  size_t balanced = 0;
+  const auto owner = [&](const size_t j) {
+    if (ring_map != nullptr) {
+      return ring_map->owner(plan.page(j));
+    }
+    if (Config::read_balancing) {
+      return plan.is_write(j) ? size_t{0} : balanced;
+    }
+    return j % endpoints.size();
+  };
+  // Scans from a different endpoint each time so that ties spread out.
+  const auto least_loaded = [&](const size_t j) {
+    size_t best = 0;
+    double best_load = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+      const size_t endpoint = (j + i) % endpoints.size();
+      const EndpointConnection& connection = connections[endpoint];
+      const double load = static_cast<double>(connection.outstanding + 1) *
+                          std::max(connection.latency_ns, 1.0);
+      if (load < best_load) {
+        best = endpoint;
+        best_load = load;
+      }
+    }
+    return best;
+  };
+  const auto hedge_target = [&](const ClusterRequest& request) {
+    return ring_map != nullptr ? ring_map->successor(plan.page(request.slot))
+                               : (request.primary + 1) % endpoints.size();
+  };
+
+  const bool hedging = Config::hedge_percentile > 0 && endpoints.size() > 1;
+  const size_t pages_per_request =
+      std::min<size_t>(std::max<size_t>(Config::multi_get_size, 1),
+                       MAX_MULTI_GET_PAGES);
+  HedgeDelay delay(Config::hedge_percentile, Config::hedge_delay_us * 1000);
+  custom_request cancel_req{CANCEL};
+  const size_t window = std::max<size_t>(Config::pipeline_depth, 1);
+  std::vector<ClusterRequest> requests(window);
+  std::vector<std::vector<uint32_t>> parts(endpoints.size());
+  stats.endpoint_responses.assign(endpoints.size(), 0);
+
+  const auto complete = [&](const GetPageResponseHeader& header,
+                            const uint8_t* frame, const size_t frame_size,
+                            const size_t endpoint) {
+    const size_t j = header.request_id;
+    ClusterRequest& request = requests[j % window];
+    if (request.slot != j || request.done) {
+      stats.late_responses++;
+      return;
+    }
+    EndpointConnection& connection = connections[endpoint];
+    const auto sample = static_cast<double>(now_ns() - request.sent_ns);
+    connection.latency_ns = connection.latency_ns == 0
+                                ? sample
+                                : 0.9 * connection.latency_ns + 0.1 * sample;
+    // The slot of a multi-get page; a page asked for twice fills both.
+    size_t index = 0;
+    while (index < request.count &&
+           (request.filled[index] ||
+            plan.page(request.slot + index) != header.page_number)) {
+      index++;
+    }
+    if (index == request.count) {
+      spdlog::error("Unexpected page {} for request {}", header.page_number, j);
+      stats.late_responses++;
+      return;
+    }
+    if (request.count == 1) {
+      request.copies--;
+      // The other copy may still make it in time.
+      if (header.status == DEADLINE_EXCEEDED && request.copies > 0) {
+        stats.late_responses++;
+        return;
+      }
+      if (endpoint != request.primary) {
+        stats.hedge_wins++;
+      }
+    }
+    request.filled.set(index);
+    stats.endpoint_responses[endpoint]++;
+    if (header.status == OVERLOADED) {
+      stats.overloaded++;
+    } else if (header.status == DEADLINE_EXCEEDED) {
+      stats.expired++;
+    } else if (header.content_length == 0) {
+      stats.writes++;
+    } else {
+      stats.reads++;
+      stats.payload_bytes += frame_size;
+      memcpy(responses[request.slot + index], frame, frame_size);
+    }
+    if (--request.remaining > 0) {
+      return;
+    }
+
+    request.done = true;
+    const uint64_t latency = now_ns() - request.sent_ns;
+    for (size_t i = 0; i < request.count; ++i) {
+      stats.latency.record(latency);
+    }
+    if (request.count == 1) {
+      delay.record(latency);
+    }
+    if (request.timer_armed) {
+      struct io_uring_sqe* sqe = get_sqe(ring);
+      io_uring_prep_cancel(sqe, &request, 0);
+      io_uring_sqe_set_data(sqe, &cancel_req);
+    }
+  };
+
+  const auto consume = [&](const size_t endpoint) {
+    EndpointConnection& connection = connections[endpoint];
+    size_t offset = 0;
+    while (connection.in_used - offset >= sizeof(GetPageResponseHeader)) {
+      GetPageResponseHeader header{};
+      memcpy(&header, connection.in.data() + offset, sizeof(header));
+      header.to_host_order();
+      if (header.content_length > PAGE_SIZE ||
+          (header.flags & RESPONSE_COMPRESSED)) {
+        spdlog::error("Unexpected response of {} bytes, flags {:#x}",
+                      header.content_length, header.flags);
+        throw std::runtime_error("Malformed response");
+      }
+      const size_t frame_size = sizeof(header) + header.content_length;
+      if (connection.in_used - offset < frame_size) {
+        break;
+      }
+      connection.outstanding--;
+      complete(header, connection.in.data() + offset, frame_size, endpoint);
+      offset += frame_size;
+    }
+    memmove(connection.in.data(), connection.in.data() + offset,
+            connection.in_used - offset);
+    connection.in_used -= offset;
+  };
+
+  size_t next = start;
+  size_t oldest = start;
+  while (oldest < end) {
+    while (next < end && next - oldest < window) {
+      ClusterRequest& request = requests[next % window];
+      if (Config::read_balancing) {
+        balanced = least_loaded(next);
+      }
+      request.slot = next;
+      request.primary = owner(next);
+      request.sent_ns = now_ns();
+      request.deadline_us = 0;
+      request.filled.reset();
+      request.copies = 1;
+      request.done = false;
+      if (plan.is_write(next)) {
+        request.count = 1;
+        build_requests(connections[request.primary].queued, next, next + 1,
+                       plan, strategy);
+        connections[request.primary].outstanding++;
+      } else if (pages_per_request > 1) {
+        request.count = 0;
+        while (next + request.count < end &&
+               next + request.count - oldest < window &&
+               request.count < pages_per_request &&
+               !plan.is_write(next + request.count)) {
+          parts[owner(next + request.count)].push_back(
+              plan.page(next + request.count));
+          request.count++;
+        }
+        for (size_t endpoint = 0; endpoint < parts.size(); ++endpoint) {
+          if (!parts[endpoint].empty()) {
+            append_multi_get_part(connections[endpoint].queued, next,
+                                  parts[endpoint]);
+            connections[endpoint].outstanding += parts[endpoint].size();
+            parts[endpoint].clear();
+          }
+        }
+      } else {
+        request.count = 1;
+        if (Config::deadline_us > 0) {
+          request.deadline_us = realtime_us() + Config::deadline_us;
+        }
+        append_read(connections[request.primary].queued, next,
+                    plan.page(next), request.deadline_us);
+        connections[request.primary].outstanding++;
+        if (hedging) {
+          const uint64_t delay_ns = delay.delay_ns();
+          request.delay.tv_sec = static_cast<long long>(delay_ns / 1000000000);
+          request.delay.tv_nsec = static_cast<long long>(delay_ns % 1000000000);
+          struct io_uring_sqe* sqe = get_sqe(ring);
+          io_uring_prep_timeout(sqe, &request.delay, 0, 0);
+          io_uring_sqe_set_data(sqe, &request);
+          request.timer_armed = true;
+        }
+      }
+      request.remaining = request.count;
+      next += request.count;
+    }
+
+    for (auto& connection : connections) {
+      if (!connection.send_in_flight && !connection.queued.empty()) {
+        connection.out.swap(connection.queued);
+        connection.queued.clear();
+        connection.out_sent = 0;
+        prep_send(ring, connection.sock, &connection.send_req, connection.out,
+                  0);
+        connection.send_in_flight = true;
+      }
+      if (!connection.recv_in_flight) {
+        struct io_uring_sqe* sqe = get_sqe(ring);
+        io_uring_prep_recv(sqe, connection.sock,
+                           connection.in.data() + connection.in_used,
+                           connection.in.size() - connection.in_used, 0);
+        io_uring_sqe_set_data(sqe, &connection.recv_req);
+        connection.recv_in_flight = true;
+      }
+    }
+    io_uring_submit(&ring);
+
+    struct io_uring_cqe* cqe;
+    const int r = io_uring_wait_cqe(&ring, &cqe);
+    if (r < 0) {
+      spdlog::error("Wait for response failed: {}", strerror(-r));
+      throw std::runtime_error("Wait for response failed");
+    }
+
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&ring, head, cqe) {
+      auto* req = (custom_request*)io_uring_cqe_get_data(cqe);
+      count++;
+      if (req->event_type == CANCEL) {
+        // Already fired or already cancelled; either way the timer completes.
+        continue;
+      }
+      if (req->event_type == HEDGE_TIMER) {
+        auto* request = static_cast<ClusterRequest*>(req);
+        request->timer_armed = false;
+        if (cqe->res == -ETIME && !request->done) {
+          EndpointConnection& target = connections[hedge_target(*request)];
+          append_read(target.queued, request->slot, plan.page(request->slot),
+                      request->deadline_us);
+          target.outstanding++;
+          request->copies++;
+          stats.hedges++;
+        }
+        continue;
+      }
+      if (cqe->res < 0) {
+        spdlog::error("IO operation failed: {}", strerror(-cqe->res));
+        throw std::runtime_error("IO operation failed");
+      }
+      const size_t endpoint = static_cast<EndpointOp*>(req)->endpoint;
+      EndpointConnection& connection = connections[endpoint];
+      if (req->event_type == SEND) {
+        connection.out_sent += cqe->res;
+        if (connection.out_sent < connection.out.size()) {
+          prep_send(ring, connection.sock, &connection.send_req,
+                    connection.out, connection.out_sent);
+        } else {
+          connection.out.clear();
+          connection.send_in_flight = false;
+        }
+      } else {
+        connection.recv_in_flight = false;
+        if (cqe->res == 0) {
+          spdlog::error("Endpoint {} closed the connection",
+                        endpoints[endpoint].host);
+          throw std::runtime_error("Server closed connection");
+        }
+        connection.in_used += cqe->res;
+        stats.wire_bytes += cqe->res;
+        consume(endpoint);
+      }
+    }
+    io_uring_cq_advance(&ring, count);
+
+    while (oldest < next && requests[oldest % window].done &&
+           !requests[oldest % window].timer_armed) {
+      oldest += requests[oldest % window].count;
+    }
+  }
+
+  for (auto& connection : connections) {
+    close(connection.sock);
+  }
+  io_uring_queue_exit(&ring);
+}
+
+// Waits for the one operation in flight on `ring` and returns its result.
+int complete_one(struct io_uring& ring) {
+  io_uring_submit(&ring);
+  struct io_uring_cqe* cqe;
+  const int r = io_uring_wait_cqe(&ring, &cqe);
+  if (r < 0) {
+    spdlog::error("Wait for completion failed: {}", strerror(-r));
+    throw std::runtime_error("Wait for completion failed");
+  }
+  const int result = cqe->res;
+  io_uring_cqe_seen(&ring, cqe);
+  return result;
+}
+
+void send_all(struct io_uring& ring, int sock, const void* data, size_t size) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    io_uring_prep_send(get_sqe(ring), sock, bytes, size, 0);
+    const int sent = complete_one(ring);
+    if (sent <= 0) {
+      spdlog::error("Send failed: {}", strerror(sent == 0 ? EPIPE : -sent));
+      throw std::runtime_error("Send failed");
+    }
+    bytes += sent;
+    size -= sent;
+  }
+}
+
+// Reads up to `size` bytes, or exactly `size` with MSG_WAITALL.
+size_t receive(struct io_uring& ring, int sock, void* data, size_t size,
+               int flags) {
+  io_uring_prep_recv(get_sqe(ring), sock, data, size, flags);
+  const int received = complete_one(ring);
+  if (received <= 0) {
+    spdlog::error("Receive failed: {}",
+                  received == 0 ? "connection closed" : strerror(-received));
+    throw std::runtime_error("Receive failed");
+  }
+  return received;
+}
+
+// Bulk export of pages [first_page, end_page) in streams of STREAM_PAGES
+// pages, one at a time. Pages land in a reused buffer; the first and last
+// page of every stream are checked against the filling strategy.
+void stream_thread(const char* addr, int port, const uint32_t first_page,
+                   const uint32_t end_page,
+                   const MemoryBlockVerifier<PAGE_SIZE>& verifier,
+                   ClientStats& stats, uint32_t& correct_responses,
+                   uint32_t& incorrect_responses, const TlsContext* tls) {
+  struct io_uring ring {};
+  setup_io_uring(ring);
+  int sock = setup_socket(addr, port, tls);
   if (sock < 0) return;
 
-  for (size_t i = start; i < end; i += BATCH_SIZE) {
-    size_t batch_end = std::min(end, i + BATCH_SIZE);
-    send_requests(ring, sock, requests, i, batch_end);
-    receive_responses(ring, sock, responses, i, batch_end);
+  std::vector<uint8_t> buffer(
+      std::max<size_t>(Config::stream_chunk_bytes, PAGE_SIZE));
+  std::array<uint8_t, PAGE_SIZE> first{};
+  std::array<uint8_t, PAGE_SIZE> last{};
+  for (uint32_t page = first_page; page < end_page;) {
+    const auto count = static_cast<uint32_t>(
+        std::min<size_t>(Config::stream_pages, end_page - page));
+    StreamPagesRequest request{};
+    request.header.type = STREAM_PAGES;
+    request.header.request_id = page;
+    request.first_page = page;
+    request.page_count = count;
+    request.to_network_order();
+    const uint64_t sent_ns = now_ns();
+    send_all(ring, sock, &request, sizeof(request));
+
+    GetPageResponseHeader header{};
+    receive(ring, sock, &header, sizeof(header), MSG_WAITALL);
+    header.to_host_order();
+    stats.wire_bytes += sizeof(header);
+    if (header.status != SUCCESS || !(header.flags & RESPONSE_STREAM) ||
+        header.content_length != count) {
+      spdlog::error("Stream of {} pages from {} refused with status {}", count,
+                    page, header.status);
+      throw std::runtime_error("Stream refused");
+    }
+
+    const size_t total = size_t{count} * PAGE_SIZE;
+    const size_t last_offset = total - PAGE_SIZE;
+    size_t offset = 0;
+    while (offset < total) {
+      const size_t received = receive(
+          ring, sock, buffer.data(), std::min(buffer.size(), total - offset), 0);
+      // Copies whatever part of the first and last page this piece holds.
+      const auto keep = [&](std::array<uint8_t, PAGE_SIZE>& page_copy,
+                            const size_t page_offset) {
+        const size_t from = std::max(offset, page_offset);
+        const size_t to = std::min(offset + received, page_offset + PAGE_SIZE);
+        if (from < to) {
+          memcpy(page_copy.data() + (from - page_offset),
+                 buffer.data() + (from - offset), to - from);
+        }
+      };
+      keep(first, 0);
+      keep(last, last_offset);
+      offset += received;
+    }
+    stats.latency.record(now_ns() - sent_ns);
+    stats.wire_bytes += total;
+    stats.payload_bytes += total;
+    stats.reads += count;
+
+    for (const auto& [content, page_number] :
+         {std::pair{&first, page}, std::pair{&last, page + count - 1}}) {
+      if (verifier.verify(*content, page_number)) {
+        correct_responses++;
+      } else {
+        spdlog::error("Verification failed for streamed page {}", page_number);
+        incorrect_responses++;
+      }
+    }
+    page += count;
   }
 
   close(sock);
   io_uring_queue_exit(&ring);
 }
 
+// Splits the page store evenly over the threads, each streaming its share.
+void run_streams(const MemoryBlockVerifier<PAGE_SIZE>& verifier,
+                 const TlsContext* tls) {
+  const size_t threads = Config::client_threads;
+  std::vector<ClientStats> stats(threads);
+  std::vector<uint32_t> correct(threads, 0);
+  std::vector<uint32_t> incorrect(threads, 0);
+  std::vector<std::thread> streamers;
+  const uint64_t start_ns = now_ns();
+  for (size_t i = 0; i < threads; i++) {
+    const auto first_page =
+        static_cast<uint32_t>(Config::page_count * i / threads);
+    const auto end_page =
+        static_cast<uint32_t>(Config::page_count * (i + 1) / threads);
+    spdlog::info("Starting thread {} streaming pages {} {}", i, first_page,
+                 end_page);
+    streamers.emplace_back(stream_thread, Config::host.c_str(), Config::port,
+                           first_page, end_page, std::cref(verifier),
+                           std::ref(stats[i]), std::ref(correct[i]),
+                           std::ref(incorrect[i]), tls);
+  }
+  for (auto& streamer : streamers) {
+    streamer.join();
+  }
+  const double total_time = static_cast<double>(now_ns() - start_ns) / 1e9;
+
+  ClientStats total{};
+  uint32_t correct_responses = 0;
+  uint32_t incorrect_responses = 0;
+  for (size_t i = 0; i < threads; i++) {
+    total.reads += stats[i].reads;
+    total.wire_bytes += stats[i].wire_bytes;
+    total.payload_bytes += stats[i].payload_bytes;
+    total.latency.merge(stats[i].latency);
+    correct_responses += correct[i];
+    incorrect_responses += incorrect[i];
+  }
+  spdlog::info("======================================");
+  spdlog::info("Correct responses: {}", correct_responses);
+  spdlog::info("Incorrect responses: {}", incorrect_responses);
+  spdlog::info("Streamed {} pages in {} streams of up to {} pages in {:.2f} s",
+               total.reads, total.latency.count(), Config::stream_pages,
+               total_time);
+  spdlog::info("Stream time p50: {:.1f} us, p99: {:.1f} us",
+               total.latency.percentile_us(50),
+               total.latency.percentile_us(99));
+  spdlog::info("Payload throughput: {:03.2f} Gb/s",
+               total.payload_bytes * 8 / total_time / 1e9);
+  spdlog::info("Wire throughput: {:03.2f} Gb/s",
+               total.wire_bytes * 8 / total_time / 1e9);
+  spdlog::info("======================================");
+}
+
+// Splits the request slots evenly over the threads and draws their pages
+// from KEY_DISTRIBUTION, one generator per thread.
+std::vector<ThreadPlan> generate_plans(const size_t num_requests) {
+  const KeyDistributionParams distribution = config_key_distribution();
+
+  const size_t threads = Config::client_threads;
+  const size_t requests_per_thread = num_requests / threads;
+  std::vector<ThreadPlan> plans(threads);
+  std::vector<std::thread> generators;
+  for (size_t i = 0; i < threads; i++) {
+    generators.emplace_back([&, i] {
+      const size_t start = i * requests_per_thread;
+      const size_t end =
+          i == threads - 1 ? num_requests : (i + 1) * requests_per_thread;
+      plans[i].first = start;
+      plans[i].pages = generate_keys(distribution, start, end);
+    });
+  }
+  for (auto& generator : generators) {
+    generator.join();
+  }
+  return plans;
+}
+
+// Gives every recorded connection to one thread, round robin in order of
+// first appearance, and keeps its requests in recorded order. With
+// REPLAY_SPEED 0 they go out as fast as the window allows; otherwise with the
+// recorded gaps divided by the speed.
+std::vector<ThreadPlan> replay_plans(const std::vector<TraceRecord>& records) {
+  std::vector<ThreadPlan> plans(Config::client_threads);
+  std::unordered_map<uint64_t, size_t> thread_of;
+  const uint64_t origin = records.empty() ? 0 : records.front().time_ns;
+  for (const auto& record : records) {
+    const uint64_t stream =
+        static_cast<uint64_t>(record.reactor) << 32 | record.connection;
+    const size_t thread =
+        thread_of.try_emplace(stream, thread_of.size() % plans.size())
+            .first->second;
+    ThreadPlan& plan = plans[thread];
+    const bool by_id = record.type == GET_PAGE_BY_ID;
+    // Lookups by id resolve to their slot on the server.
+    plan.pages.push_back(by_id ? 0 : static_cast<uint32_t>(record.page));
+    plan.page_ids.push_back(by_id ? record.page : PageIndex::EMPTY);
+    plan.writes.push_back(record.type == PUT_PAGE);
+    if (Config::replay_speed > 0) {
+      plan.due_ns.push_back(static_cast<uint64_t>(
+          static_cast<double>(record.time_ns - origin) / Config::replay_speed));
+    }
+  }
+  size_t first = 0;
+  for (auto& plan : plans) {
+    plan.first = first;
+    first += plan.pages.size();
+  }
+  return plans;
+}
+
 int main() {
   Config::load_config();
-  MemoryBlockVerifier<PAGE_SIZE> verifier(Config::page_count,
-                                          new PseudoRandomFillingStrategy());
+  const IFillingStrategy* strategy = new PseudoRandomFillingStrategy();
+  MemoryBlockVerifier<PAGE_SIZE> verifier(Config::page_count, strategy);
 
   srand(time(nullptr));  // NOLINT(*-msc51-cpp)
-  auto start_time = std::chrono::high_resolution_clock::now();
 
+  std::unique_ptr<TlsContext> tls;
+  if (Config::tls && Config::unix_socket.empty()) {
+    tls = std::make_unique<TlsContext>(TlsRole::CLIENT, Config::tls_ca, "", "",
+                                       Config::tls_server_name);
+  }
+
+  if (Config::stream_pages > 0) {
+    run_streams(verifier, tls.get());
+    return 0;
+  }
+
+  // Every page a thread asks for is known before the clock starts.
+  const uint64_t plan_start_ns = now_ns();
+  std::vector<ThreadPlan> plans;
+  if (Config::replay_trace.empty()) {
+    plans = generate_plans(Config::num_requests);
+    spdlog::info("Key distribution: {} over {} pages, generated in {:.3f} s",
+                 Config::key_distribution, Config::page_count,
+                 static_cast<double>(now_ns() - plan_start_ns) / 1e9);
+  } else {
+    const std::vector<TraceRecord> records = load_trace(Config::replay_trace);
+    plans = replay_plans(records);
+    Config::num_requests = records.size();
+    spdlog::info("Replaying {} requests from {} at speed {}, loaded in "
+                 "{:.3f} s",
+                 records.size(), Config::replay_trace, Config::replay_speed,
+                 static_cast<double>(now_ns() - plan_start_ns) / 1e9);
+  }
   size_t num_requests = Config::num_requests;
+
+  auto start_time = std::chrono::high_resolution_clock::now();
   uint32_t correct_responses = 0;
   uint32_t incorrect_responses = 0;
 
-  std::vector<GetPageRequest> requests(num_requests);
   std::vector<GetPageResponse*> responses(num_requests);
   for (size_t i = 0; i < num_requests; i++) {
     responses[i] = new GetPageResponse();
   }
 
+  const std::vector<Endpoint> endpoints = parse_endpoints(Config::endpoints);
+  std::unique_ptr<ShardRing> shard_ring;
+  if (!endpoints.empty()) {
+    spdlog::info("Endpoints: {}, placement: {}, hedging at p{} (initially {} "
+                 "us), deadline {} us",
+                 endpoints.size(),
+                 Config::sharding         ? "consistent hashing"
+                 : Config::read_balancing ? "read balancing"
+                                          : "round robin",
+                 Config::hedge_percentile, Config::hedge_delay_us,
+                 Config::deadline_us);
+  }
+  if (!endpoints.empty() && Config::sharding) {
+    std::vector<std::string> names;
+    for (const auto& endpoint : endpoints) {
+      names.push_back(endpoint.host + ":" + std::to_string(endpoint.port));
+    }
+    shard_ring = std::make_unique<ShardRing>(names);
+  }
+
+  std::vector<ClientStats> stats(Config::client_threads);
   std::vector<std::thread> threads;
-  size_t requests_per_thread = num_requests / Config::client_threads;
+  const uint64_t replay_start_ns = now_ns();
   for (size_t i = 0; i < Config::client_threads; i++) {
-    size_t start = i * requests_per_thread;
-    size_t end = (i == Config::client_threads - 1)
-                     ? num_requests
-                     : (i + 1) * requests_per_thread;
-    spdlog::info("Starting thread {} for range {} {}", i, start, end);
+    spdlog::info("Starting thread {} for range {} {}", i, plans[i].first,
+                 plans[i].end());
+    if (!endpoints.empty()) {
+      threads.emplace_back(cluster_thread, std::cref(endpoints),
+                           shard_ring.get(), std::cref(plans[i]),
+                           std::ref(responses), strategy, std::ref(stats[i]),
+                           tls.get());
+      continue;
+    }
     threads.emplace_back(client_thread, Config::host.c_str(), Config::port,
-                         start, end, std::ref(requests), std::ref(responses));
+                         std::cref(plans[i]), std::ref(responses), strategy,
+                         std::ref(stats[i]), tls.get(), replay_start_ns);
   }
 
   for (auto& thread : threads) {
@@ -201,14 +1230,65 @@ int main() {
 
   verify_responses(responses, verifier, correct_responses, incorrect_responses);
 
+  ClientStats total{};
+  for (const auto& thread_stats : stats) {
+    total.reads += thread_stats.reads;
+    total.writes += thread_stats.writes;
+    total.stale_reads += thread_stats.stale_reads;
+    total.wire_bytes += thread_stats.wire_bytes;
+    total.payload_bytes += thread_stats.payload_bytes;
+    total.decode_errors += thread_stats.decode_errors;
+    total.checksum_failures += thread_stats.checksum_failures;
+    total.overloaded += thread_stats.overloaded;
+    total.expired += thread_stats.expired;
+    total.hedges += thread_stats.hedges;
+    total.hedge_wins += thread_stats.hedge_wins;
+    total.late_responses += thread_stats.late_responses;
+    total.endpoint_responses.resize(thread_stats.endpoint_responses.size());
+    for (size_t i = 0; i < thread_stats.endpoint_responses.size(); ++i) {
+      total.endpoint_responses[i] += thread_stats.endpoint_responses[i];
+    }
+    total.latency.merge(thread_stats.latency);
+  }
+  const double wire_gbps = total.wire_bytes * 8 / total_time / 1e9;
+  const double payload_gbps = total.payload_bytes * 8 / total_time / 1e9;
+
   spdlog::info("======================================");
   spdlog::info("Correct responses: {}", correct_responses);
   spdlog::info("Incorrect responses: {}", incorrect_responses);
+  spdlog::info("Reads: {}, writes: {}, stale reads: {}, overloaded: {}",
+               total.reads, total.writes, total.stale_reads, total.overloaded);
+  if (Config::deadline_us > 0) {
+    spdlog::info("Expired: {}", total.expired);
+  }
+  if (!endpoints.empty()) {
+    spdlog::info("Hedges: {} sent, {} won, {} late responses dropped",
+                 total.hedges, total.hedge_wins, total.late_responses);
+    std::string shares;
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+      shares += fmt::format("{}{}:{} {}", i == 0 ? "" : ", ", endpoints[i].host,
+                            endpoints[i].port, total.endpoint_responses[i]);
+    }
+    spdlog::info("Responses per endpoint: {}", shares);
+  }
+  if (Config::compression || Config::checksums) {
+    spdlog::info("Negotiated features: {:#x}, decode errors: {}",
+                 stats[0].features, total.decode_errors);
+  }
+  if (Config::checksums) {
+    spdlog::info("Checksum failures: {} (CRC32C in hardware: {})",
+                 total.checksum_failures, crc32c_hardware_available());
+  }
   spdlog::info("Total time for {} requests: {:.2f} s", Config::num_requests,
                total_time);
   spdlog::info("Average time per request: {:.2f} s", avg_time);
   spdlog::info("Average rate: {:03.2f} req/s", avg_rate);
+  spdlog::info("Latency p50: {:.1f} us, p99: {:.1f} us, p99.9: {:.1f} us",
+               total.latency.percentile_us(50), total.latency.percentile_us(99),
+               total.latency.percentile_us(99.9));
   spdlog::info("Average throughput: {:03.2f} Gb/s", avg_gbps);
+  spdlog::info("Payload throughput: {:03.2f} Gb/s", payload_gbps);
+  spdlog::info("Wire throughput: {:03.2f} Gb/s", wire_gbps);
   spdlog::info("======================================");
 
   return 0;
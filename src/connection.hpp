@@ -0,0 +1,257 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "consts.hpp"
+#include "models/get_page.hpp"
+#include "models/hello.hpp"
+#include "models/put_page.hpp"
+
+enum EventType {
+  ACCEPT,
+  READ,
+  WRITE,
+  COALESCE_TIMEOUT,
+  TRACE_WRITE,
+  FORWARD,
+  STREAM,
+  REPLICA_SEND,
+  REPLICA_ACK,
+  TLS_READY
+};
+
+struct Connection;
+
+struct custom_request {
+  int event_type;
+  Connection* conn;
+};
+
+// A page request travelling between reactors with IORING_OP_MSG_RING: from
+// the reactor that read it to the one owning the page, and back with a copy
+// of the page. The copy is sent from and freed with the response.
+struct PageForward : custom_request {
+  PageForward(Connection* conn, const size_t origin, const uint32_t request_id,
+              const uint32_t page_number)
+      : custom_request{FORWARD, conn},
+        origin(origin),
+        request_id(request_id),
+        page_number(page_number) {}
+
+  size_t origin;
+  uint32_t request_id;
+  uint32_t page_number;
+  bool answered = false;
+  bool found = false;
+  uint32_t version = 0;
+  uint32_t checksum = 0;
+  alignas(64) uint8_t content[PAGE_SIZE];
+};
+
+// A StreamPagesRequest being answered. Its response header goes out like any
+// other; after that the stream owns the connection's write side until the
+// last page is sent. The pages go out in chunks straight from page memory.
+struct StreamPages : custom_request {
+  StreamPages(Connection* conn, const uint32_t first_page,
+              const uint32_t end_page)
+      : custom_request{STREAM, conn},
+        next_page(first_page),
+        end_page(end_page) {}
+
+  uint32_t next_page;
+  uint32_t end_page;
+  // The chunk being sent, and how much of it the kernel has taken.
+  const uint8_t* chunk = nullptr;
+  size_t chunk_length = 0;
+  size_t chunk_sent = 0;
+  bool chunk_zerocopy = false;
+  // Epoch pinned for a chunk taken from an updated page version, else 0.
+  uint64_t chunk_epoch = 0;
+  // Zero-copy notifications still to come; the stream is freed once it is
+  // finished and they have all arrived.
+  size_t notifications = 0;
+  bool finished = false;
+  uint64_t start_ns = 0;
+  size_t bytes = 0;
+};
+
+struct OutgoingPage {
+  GetPageResponseHeader header;  // already in network order
+  const uint8_t* content;
+  uint32_t content_length;
+  // Epoch pinned while `content` may still be read by the kernel, 0 if the
+  // content is not owned by the page store.
+  uint64_t epoch;
+  // Owner of `content` for pages answered by another reactor.
+  PageForward* forward = nullptr;
+  // Set on the header of a stream, which starts once the header is written.
+  StreamPages* stream = nullptr;
+};
+
+// All state a reactor keeps for one client socket. At most one read and one
+// write are in flight at any time so that the byte stream stays ordered.
+struct Connection {
+  int fd;
+  uint32_t id;
+  custom_request read_req{READ, this};
+  custom_request write_req{WRITE, this};
+
+  std::vector<uint8_t> in = std::vector<uint8_t>(CONNECTION_BUFFER_SIZE);
+  size_t in_used = 0;
+
+  // Responses produced since the last flush.
+  std::vector<OutgoingPage> pending;
+  // Responses owned by the in-flight write.
+  std::vector<OutgoingPage> writing;
+  std::vector<iovec> iov;
+  size_t iov_offset = 0;
+  msghdr msg{};
+
+  // Features negotiated through HELLO, and the reply body sent for it.
+  uint32_t features = 0;
+  uint32_t hello_reply = 0;
+
+  bool read_in_flight = false;
+  bool write_in_flight = false;
+  bool dirty = false;
+  bool closed = false;
+  // Reading stops while the connection has used up its response credits.
+  bool read_paused = false;
+  // Queued on the reactor's scheduler with complete requests buffered, and
+  // the bytes of work it may still do in the current round.
+  bool runnable = false;
+  size_t deficit = 0;
+  // Counters reported when the connection closes.
+  size_t responses_sent = 0;
+  size_t sends = 0;
+  // Number of coalesced or forwarded fetches still waiting to be answered on
+  // this socket.
+  size_t waiters = 0;
+  // The stream being sent; holds write_in_flight until it is done.
+  StreamPages* stream = nullptr;
+
+  Connection(const int fd, const uint32_t id) : fd(fd), id(id) {}
+
+  // Responses owed to the client that have not been fully written yet.
+  [[nodiscard]] size_t outstanding() const {
+    return pending.size() + writing.size() + waiters + (stream ? 1 : 0);
+  }
+
+  [[nodiscard]] bool can_release() const {
+    return closed && !read_in_flight && !write_in_flight && !dirty &&
+           !runnable && waiters == 0;
+  }
+
+  // Moves everything in `pending` into `writing` and lays out the iovecs for
+  // a single writev. A stream header ends the batch: what was queued after it
+  // waits for the stream. Returns false if there is nothing to send.
+  bool prepare_write() {
+    if (write_in_flight || pending.empty()) {
+      return false;
+    }
+    const auto stream_header =
+        std::find_if(pending.begin(), pending.end(),
+                     [](const OutgoingPage& page) { return page.stream; });
+    if (stream_header == pending.end()) {
+      writing.swap(pending);
+      pending.clear();
+    } else {
+      writing.assign(pending.begin(), stream_header + 1);
+      pending.erase(pending.begin(), stream_header + 1);
+    }
+    iov.clear();
+    iov.reserve(writing.size() * 2);
+    for (auto& page : writing) {
+      iov.push_back({&page.header, sizeof(page.header)});
+      if (page.content_length > 0) {
+        iov.push_back({const_cast<uint8_t*>(page.content), page.content_length});
+      }
+    }
+    iov_offset = 0;
+    responses_sent += writing.size();
+    return true;
+  }
+
+  // True if the next send does not carry everything that is queued.
+  [[nodiscard]] bool more_after_next_send() const {
+    return iov_offset + iov_count() < iov.size();
+  }
+
+  [[nodiscard]] unsigned iov_count() const {
+    const size_t remaining = iov.size() - iov_offset;
+    return static_cast<unsigned>(remaining < IOV_MAX ? remaining : IOV_MAX);
+  }
+
+  // Accounts for `written` bytes of the in-flight writev. Returns true once
+  // the whole batch has been written.
+  bool advance_write(size_t written) {
+    while (written > 0 && iov_offset < iov.size()) {
+      iovec& current = iov[iov_offset];
+      if (written >= current.iov_len) {
+        written -= current.iov_len;
+        iov_offset++;
+      } else {
+        current.iov_base = static_cast<uint8_t*>(current.iov_base) + written;
+        current.iov_len -= written;
+        written = 0;
+      }
+    }
+    return iov_offset == iov.size();
+  }
+};
+
+// Returns the size of the request frame at the front of `data`, 0 if more
+// bytes are needed to tell, or SIZE_MAX if the frame is malformed.
+inline size_t next_request_size(const uint8_t* data, const size_t available) {
+  if (available < sizeof(RequestHeader)) {
+    return 0;
+  }
+  RequestHeader header{};
+  memcpy(&header, data, sizeof(header));
+  header.to_host_order();
+
+  switch (header.get_type()) {
+    case GET_PAGE:
+      return sizeof(GetPageRequest);
+    case GET_PAGE_BY_ID:
+      return sizeof(GetPageByIdRequest);
+    case GET_PAGE_WITH_DEADLINE:
+      return sizeof(DeadlineGetPageRequest);
+    case PUT_PAGE:
+      return sizeof(PutPageRequest);
+    case REPLICATE_PAGE:
+      return sizeof(ReplicatePageRequest);
+    case HELLO:
+      return sizeof(HelloRequest);
+    case STREAM_PAGES:
+      return sizeof(StreamPagesRequest);
+    case MULTI_GET_PAGE: {
+      if (available < MultiGetPageRequest::size_for(0)) {
+        return 0;
+      }
+      uint32_t page_count;
+      memcpy(&page_count, data + sizeof(RequestHeader), sizeof(page_count));
+      page_count = ntohl(page_count);
+      if (page_count == 0 || page_count > MAX_MULTI_GET_PAGES) {
+        return SIZE_MAX;
+      }
+      return MultiGetPageRequest::size_for(page_count);
+    }
+    default:
+      return SIZE_MAX;
+  }
+}
+
+// True if the input buffer starts with a complete frame, or with one that is
+// already known to be malformed.
+inline bool has_complete_request(const Connection& conn) {
+  const size_t size = next_request_size(conn.in.data(), conn.in_used);
+  return size != 0 && (size == SIZE_MAX || size <= conn.in_used);
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <liburing.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "buffer_pool.hpp"
+#include "huge_pages.hpp"
+#include "simple_consts.hpp"
+
+// What one connection costs a ConnectionLoop while it is idle: no buffers,
+// no ring of its own and no thread, only this and the kernel socket.
+struct LoopConnection {
+  int fd = -1;
+  uint32_t sends_in_flight = 0;
+  // The start of a request split across two receives, kept for the handler.
+  uint8_t partial[4]{};
+  uint8_t partial_length = 0;
+  // A multishot receive is armed.
+  bool receiving = false;
+  // Receiving stopped because too many sends are in flight.
+  bool paused = false;
+  bool closing = false;
+};
+
+struct LoopCounters {
+  std::atomic<size_t> accepted{0};
+  std::atomic<size_t> closed{0};
+};
+
+// Serves any number of connections from one thread and one ring. All loops
+// accept from the same listening socket with a multishot accept. Each
+// connection has a multishot receive that takes its buffer from a ring of
+// RECV_BUFFER_COUNT buffers shared by the whole loop, and the buffer goes
+// back as soon as the handler returns; response buffers are only held while
+// their send is in flight. Memory therefore follows the number of active
+// requests, not the number of connections. A connection with
+// MAX_SENDS_IN_FLIGHT sends outstanding stops receiving until half of them
+// are done, so a client that pipelines but reads slowly cannot grow the send
+// pool without limit.
+//
+// `on_data(loop, slot, data, length)` is called for every receive; it may
+// send on `slot` with allocate_send() and send().
+template <typename OnData>
+class ConnectionLoop {
+ public:
+  static constexpr unsigned LOOP_RING_SIZE = 4096;
+  static constexpr unsigned RECV_BUFFER_COUNT = 4096;
+  static constexpr unsigned RECV_BUFFER_SIZE = 1024;
+  static constexpr int RECV_BUFFER_GROUP = 0;
+  static constexpr uint32_t MAX_SENDS_IN_FLIGHT =
+      MAX_OUTSTANDING_SENDS > 0 ? MAX_OUTSTANDING_SENDS : 256;
+
+  ConnectionLoop(const int server_fd, const size_t send_size,
+                 LoopCounters& counters, OnData on_data)
+      : server_fd(server_fd),
+        send_size(send_size),
+        counters(counters),
+        on_data(on_data),
+        send_pool({sizeof(RequestData) + send_size},
+                  BUFFER_POOL_INITIAL_POOL_SIZE),
+        recv_buffers(size_t{RECV_BUFFER_COUNT} * RECV_BUFFER_SIZE, HUGE_PAGES) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 4 * LOOP_RING_SIZE;
+    int r = io_uring_queue_init_params(LOOP_RING_SIZE, &ring, &params);
+    if (r < 0) {
+      std::cout << "io_uring_queue_init failed: " << strerror(-r) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    buffer_ring = io_uring_setup_buf_ring(&ring, RECV_BUFFER_COUNT,
+                                          RECV_BUFFER_GROUP, 0, &r);
+    if (buffer_ring == nullptr) {
+      std::cout << "io_uring_setup_buf_ring failed: " << strerror(-r)
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    for (unsigned id = 0; id < RECV_BUFFER_COUNT; ++id) {
+      recycle_buffer(id);
+    }
+    io_uring_buf_ring_advance(buffer_ring, static_cast<int>(recycled));
+    recycled = 0;
+  }
+
+  ConnectionLoop(const ConnectionLoop&) = delete;
+  ConnectionLoop& operator=(const ConnectionLoop&) = delete;
+
+  ~ConnectionLoop() {
+    for (auto& connection : connections) {
+      if (connection.fd >= 0) {
+        close(connection.fd);
+      }
+    }
+    io_uring_free_buf_ring(&ring, buffer_ring, RECV_BUFFER_COUNT,
+                           RECV_BUFFER_GROUP);
+    io_uring_queue_exit(&ring);
+  }
+
+  void run(const std::atomic<bool>& stop) {
+    add_accept();
+    io_uring_submit(&ring);
+    while (!stop.load(std::memory_order_relaxed)) {
+      struct __kernel_timespec timeout {
+        0, 100 * 1000 * 1000
+      };
+      struct io_uring_cqe* cqe;
+      const int r = io_uring_wait_cqe_timeout(&ring, &cqe, &timeout);
+      if (r == -ETIME || r == -EINTR) {
+        continue;
+      }
+      if (r < 0) {
+        std::cout << "io_uring_wait_cqe failed: " << strerror(-r) << std::endl;
+        exit(EXIT_FAILURE);
+      }
+
+      unsigned head;
+      unsigned count = 0;
+      io_uring_for_each_cqe(&ring, head, cqe) {
+        count++;
+        handle_cqe(cqe);
+      }
+      io_uring_cq_advance(&ring, count);
+
+      if (recycled > 0) {
+        io_uring_buf_ring_advance(buffer_ring, static_cast<int>(recycled));
+        recycled = 0;
+      }
+      // Receives that ran out of buffers restart once this batch has given
+      // its buffers back.
+      for (const uint32_t slot : starved) {
+        if (connections[slot].closing) {
+          release_if_done(slot);
+        } else if (!connections[slot].paused) {
+          add_recv(slot);
+        }
+      }
+      starved.clear();
+      io_uring_submit(&ring);
+    }
+  }
+
+  LoopConnection& connection(const uint32_t slot) { return connections[slot]; }
+
+  RequestData* allocate_send() {
+    return reinterpret_cast<RequestData*>(
+        send_pool.allocate(sizeof(RequestData) + send_size));
+  }
+
+  // Sends the first `length` bytes of `req`'s buffer, which the loop frees
+  // once they are out. MSG_WAITALL makes the kernel finish short sends
+  // itself, so sends on one connection never interleave.
+  void send(const uint32_t slot, RequestData* req, const size_t length) {
+    LoopConnection& connection = connections[slot];
+    req->seq[0] = slot;
+    req->event_type = SEND_EVENT;
+    req->buffer_size = length;
+    struct io_uring_sqe* sqe = get_sqe();
+    io_uring_prep_send(sqe, connection.fd, req->buffer, length, MSG_WAITALL);
+    io_uring_sqe_set_data(sqe, req);
+    connection.sends_in_flight++;
+  }
+
+ private:
+  // Pointers to RequestData never have the top bits set.
+  static constexpr uint64_t RECV_TAG = 1ull << 63;
+  static constexpr uint64_t ACCEPT_TAG = 1ull << 62;
+  static constexpr uint64_t CANCEL_TAG = 1ull << 61;
+
+  struct io_uring_sqe* get_sqe() {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    while (sqe == nullptr) {
+      io_uring_submit(&ring);
+      sqe = io_uring_get_sqe(&ring);
+    }
+    return sqe;
+  }
+
+  void add_accept() {
+    struct io_uring_sqe* sqe = get_sqe();
+    io_uring_prep_multishot_accept(sqe, server_fd, nullptr, nullptr, 0);
+    io_uring_sqe_set_data64(sqe, ACCEPT_TAG);
+  }
+
+  void add_recv(const uint32_t slot) {
+    struct io_uring_sqe* sqe = get_sqe();
+    io_uring_prep_recv_multishot(sqe, connections[slot].fd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    io_uring_sqe_set_data64(sqe, RECV_TAG | slot);
+    connections[slot].receiving = true;
+  }
+
+  void recycle_buffer(const unsigned id) {
+    io_uring_buf_ring_add(buffer_ring,
+                          recv_buffers.data() + size_t{id} * RECV_BUFFER_SIZE,
+                          RECV_BUFFER_SIZE, static_cast<unsigned short>(id),
+                          io_uring_buf_ring_mask(RECV_BUFFER_COUNT),
+                          static_cast<int>(recycled++));
+  }
+
+  void handle_cqe(struct io_uring_cqe* cqe) {
+    const uint64_t data = io_uring_cqe_get_data64(cqe);
+    if (data == ACCEPT_TAG) {
+      handle_accept(cqe);
+    } else if (data == CANCEL_TAG) {
+      return;
+    } else if (data & RECV_TAG) {
+      handle_recv(cqe, static_cast<uint32_t>(data & ~RECV_TAG));
+    } else {
+      handle_send(cqe, reinterpret_cast<RequestData*>(data));
+    }
+  }
+
+  void handle_accept(struct io_uring_cqe* cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      add_accept();
+    }
+    if (cqe->res < 0) {
+      std::cout << "Accept failed: " << strerror(-cqe->res) << std::endl;
+      return;
+    }
+    uint32_t slot;
+    if (!free_slots.empty()) {
+      slot = free_slots.back();
+      free_slots.pop_back();
+    } else {
+      slot = static_cast<uint32_t>(connections.size());
+      connections.emplace_back();
+    }
+    connections[slot] = LoopConnection{};
+    connections[slot].fd = cqe->res;
+    add_recv(slot);
+    counters.accepted.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void handle_recv(struct io_uring_cqe* cqe, const uint32_t slot) {
+    LoopConnection& connection = connections[slot];
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+      const unsigned id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      if (cqe->res > 0 && !connection.closing) {
+        on_data(*this, slot,
+                recv_buffers.data() + size_t{id} * RECV_BUFFER_SIZE,
+                static_cast<size_t>(cqe->res));
+        if (connection.sends_in_flight >= MAX_SENDS_IN_FLIGHT &&
+            connection.receiving && !connection.paused) {
+          pause_recv(slot);
+        }
+      }
+      recycle_buffer(id);
+    }
+    if (cqe->flags & IORING_CQE_F_MORE) {
+      return;
+    }
+    // The multishot receive ended. It is rearmed if it only ran out of
+    // buffers, or once sends drain if it was paused; end of stream or an
+    // error closes the connection.
+    connection.receiving = false;
+    if (connection.paused && (cqe->res > 0 || cqe->res == -ECANCELED ||
+                              cqe->res == -ENOBUFS)) {
+      maybe_resume(slot);
+      return;
+    }
+    if (cqe->res > 0 || cqe->res == -ENOBUFS) {
+      starved.push_back(slot);
+      return;
+    }
+    if (cqe->res < 0 && cqe->res != -ECONNRESET) {
+      std::cout << "Receive failed: " << strerror(-cqe->res) << std::endl;
+    }
+    connection.closing = true;
+    release_if_done(slot);
+  }
+
+  void handle_send(struct io_uring_cqe* cqe, RequestData* req) {
+    const auto slot = static_cast<uint32_t>(req->seq[0]);
+    LoopConnection& connection = connections[slot];
+    if (cqe->res < 0 || static_cast<size_t>(cqe->res) < req->buffer_size) {
+      if (!connection.closing) {
+        std::cout << "Send failed: "
+                  << strerror(cqe->res < 0 ? -cqe->res : EPIPE) << std::endl;
+        connection.closing = true;
+        // Ends the multishot receive, which then releases the slot.
+        shutdown(connection.fd, SHUT_RDWR);
+      }
+    }
+    send_pool.deallocate(reinterpret_cast<char*>(req),
+                         sizeof(RequestData) + send_size);
+    connection.sends_in_flight--;
+    maybe_resume(slot);
+    release_if_done(slot);
+  }
+
+  // Stops the multishot receive; buffers it already filled still arrive.
+  void pause_recv(const uint32_t slot) {
+    connections[slot].paused = true;
+    struct io_uring_sqe* sqe = get_sqe();
+    io_uring_prep_cancel64(sqe, RECV_TAG | slot, 0);
+    io_uring_sqe_set_data64(sqe, CANCEL_TAG);
+  }
+
+  // Rearms a paused receive once half of the sends in flight are done.
+  void maybe_resume(const uint32_t slot) {
+    LoopConnection& connection = connections[slot];
+    if (connection.paused && !connection.receiving && !connection.closing &&
+        connection.sends_in_flight <= MAX_SENDS_IN_FLIGHT / 2) {
+      connection.paused = false;
+      add_recv(slot);
+    }
+  }
+
+  void release_if_done(const uint32_t slot) {
+    LoopConnection& connection = connections[slot];
+    if (!connection.closing || connection.receiving ||
+        connection.sends_in_flight > 0 || connection.fd < 0) {
+      return;
+    }
+    close(connection.fd);
+    connection.fd = -1;
+    free_slots.push_back(slot);
+    counters.closed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  int server_fd;
+  size_t send_size;
+  LoopCounters& counters;
+  OnData on_data;
+  struct io_uring ring {};
+  struct io_uring_buf_ring* buffer_ring = nullptr;
+  BufferPool send_pool;
+  HugePageBuffer recv_buffers;
+  unsigned recycled = 0;
+  std::vector<LoopConnection> connections;
+  std::vector<uint32_t> free_slots;
+  std::vector<uint32_t> starved;
+};
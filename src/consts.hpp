@@ -1,5 +1,12 @@
 #pragma once
 
-constexpr size_t PAGE_SIZE = 128;
+#include <cstddef>
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 128
+#endif
+
 constexpr size_t MAX_QUEUE = 1024;
-constexpr int PSEUDO_RANDOM_SEED = 42;
\ No newline at end of file
+constexpr int PSEUDO_RANDOM_SEED = 42;
+constexpr size_t MAX_MULTI_GET_PAGES = 256;
+constexpr size_t CONNECTION_BUFFER_SIZE = 16 * 1024;
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+// CRC32C (Castagnoli) as used by iSCSI/ext4, with the SSE4.2 / ARMv8 CRC
+// instructions when the CPU has them. `crc32c_extend` can be fed a buffer in
+// pieces, so data can be checked as it arrives.
+namespace crc32c_detail {
+
+constexpr uint32_t POLYNOMIAL = 0x82F63B78;
+
+inline const std::array<uint32_t, 256>& table() {
+  static const std::array<uint32_t, 256> values = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ (POLYNOMIAL & (0u - (crc & 1)));
+      }
+      t[i] = crc;
+    }
+    return t;
+  }();
+  return values;
+}
+
+inline uint32_t extend_software(uint32_t crc, const uint8_t* data,
+                                size_t length) {
+  const auto& t = table();
+  for (size_t i = 0; i < length; ++i) {
+    crc = t[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) inline uint32_t extend_hardware(
+    uint32_t crc, const uint8_t* data, size_t length) {
+  uint64_t crc64 = crc;
+  while (length >= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += sizeof(word);
+    length -= sizeof(word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (length-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+
+inline bool has_hardware() {
+  static const bool supported = __builtin_cpu_supports("sse4.2");
+  return supported;
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc"))) inline uint32_t extend_hardware(
+    uint32_t crc, const uint8_t* data, size_t length) {
+  while (length >= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += sizeof(word);
+    length -= sizeof(word);
+  }
+  while (length-- > 0) {
+    crc = __crc32cb(crc, *data++);
+  }
+  return crc;
+}
+
+inline bool has_hardware() {
+  static const bool supported = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+  return supported;
+}
+#else
+inline uint32_t extend_hardware(uint32_t crc, const uint8_t* data,
+                                size_t length) {
+  return extend_software(crc, data, length);
+}
+
+inline bool has_hardware() { return false; }
+#endif
+
+}  // namespace crc32c_detail
+
+// Continues a checksum returned by a previous call; start with 0.
+inline uint32_t crc32c_extend(const uint32_t crc, const uint8_t* data,
+                              const size_t length) {
+  const uint32_t state = ~crc;
+  const uint32_t result =
+      crc32c_detail::has_hardware()
+          ? crc32c_detail::extend_hardware(state, data, length)
+          : crc32c_detail::extend_software(state, data, length);
+  return ~result;
+}
+
+inline uint32_t crc32c(const uint8_t* data, const size_t length) {
+  return crc32c_extend(0, data, length);
+}
+
+inline bool crc32c_hardware_available() {
+  return crc32c_detail::has_hardware();
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation for objects that reactors hand to the kernel by
+// pointer. A reactor pins the global epoch before it loads shared pointers and
+// keeps the epoch referenced until the sends using them complete, so a retired
+// object is only freed once no reactor can still be sending from it.
+class EpochReclaimer {
+ public:
+  static constexpr uint64_t IDLE = UINT64_MAX;
+
+  class Participant {
+   public:
+    // Must be called before loading any pointer that may be retired.
+    uint64_t enter() {
+      pin = owner->global_epoch.load();
+      active.store(std::min(pin, oldest_referenced()));
+      return pin;
+    }
+
+    // Publishes the oldest epoch still referenced by in-flight I/O and frees
+    // whatever every participant has moved past.
+    void leave() {
+      active.store(oldest_referenced());
+      if (!retired.empty()) {
+        reclaim();
+      }
+    }
+
+    void reference(const uint64_t epoch) {
+      if (in_flight.empty() || in_flight.back().first != epoch) {
+        in_flight.emplace_back(epoch, 0);
+      }
+      in_flight.back().second++;
+    }
+
+    void unreference(const uint64_t epoch) {
+      for (auto& [e, count] : in_flight) {
+        if (e == epoch) {
+          count--;
+          break;
+        }
+      }
+      while (!in_flight.empty() && in_flight.front().second == 0) {
+        in_flight.pop_front();
+      }
+    }
+
+    // Call after the object has been unlinked from every shared slot.
+    void retire(std::function<void()> deleter) {
+      const uint64_t tag = owner->global_epoch.fetch_add(1);
+      retired.emplace_back(tag, std::move(deleter));
+    }
+
+    [[nodiscard]] uint64_t current_pin() const { return pin; }
+
+   private:
+    friend class EpochReclaimer;
+
+    [[nodiscard]] uint64_t oldest_referenced() const {
+      return in_flight.empty() ? IDLE : in_flight.front().first;
+    }
+
+    void reclaim() {
+      const uint64_t safe = owner->min_active();
+      auto it = std::partition(retired.begin(), retired.end(),
+                               [&](const auto& entry) {
+                                 return entry.first >= safe;
+                               });
+      for (auto done = it; done != retired.end(); ++done) {
+        done->second();
+      }
+      retired.erase(it, retired.end());
+    }
+
+    EpochReclaimer* owner = nullptr;
+    alignas(64) std::atomic<uint64_t> active{IDLE};
+    uint64_t pin = 0;
+    // Epochs pinned by responses that are queued or being written, oldest
+    // first. Pins only grow, so this rarely holds more than one entry.
+    std::deque<std::pair<uint64_t, size_t>> in_flight;
+    std::vector<std::pair<uint64_t, std::function<void()>>> retired;
+  };
+
+  explicit EpochReclaimer(const size_t participant_count)
+      : participants(participant_count) {
+    for (auto& participant : participants) {
+      participant.owner = this;
+    }
+  }
+
+  ~EpochReclaimer() {
+    for (auto& participant : participants) {
+      for (auto& [tag, deleter] : participant.retired) {
+        deleter();
+      }
+    }
+  }
+
+  Participant& participant(const size_t index) { return participants[index]; }
+
+ private:
+  [[nodiscard]] uint64_t min_active() const {
+    uint64_t result = IDLE;
+    for (const auto& participant : participants) {
+      result = std::min(result, participant.active.load());
+    }
+    return result;
+  }
+
+  std::atomic<uint64_t> global_epoch{1};
+  std::vector<Participant> participants;
+};
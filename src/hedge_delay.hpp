@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How long a request may go unanswered before a copy of it is sent to another
+// endpoint: the given percentile of the last WINDOW latencies, recomputed
+// every UPDATE_INTERVAL completions. Until a full window is in, the initial
+// delay. Latencies of hedged requests are those of the copy that won, so the
+// slow tail hedging cuts off does not push the delay up.
+class HedgeDelay {
+ public:
+  static constexpr size_t WINDOW = 1024;
+  static constexpr size_t UPDATE_INTERVAL = 128;
+
+  HedgeDelay(const double percentile, const uint64_t initial_ns)
+      : percentile(std::clamp(percentile, 0.0, 100.0)), delay(initial_ns) {
+    recent.reserve(WINDOW);
+  }
+
+  [[nodiscard]] uint64_t delay_ns() const { return delay; }
+
+  void record(const uint64_t latency_ns) {
+    if (recent.size() < WINDOW) {
+      recent.push_back(latency_ns);
+    } else {
+      recent[recorded % WINDOW] = latency_ns;
+    }
+    recorded++;
+    if (recent.size() == WINDOW && recorded % UPDATE_INTERVAL == 0) {
+      scratch = recent;
+      const auto nth =
+          scratch.begin() +
+          static_cast<std::ptrdiff_t>(percentile / 100.0 * (WINDOW - 1));
+      std::nth_element(scratch.begin(), nth, scratch.end());
+      delay = *nth;
+    }
+  }
+
+ private:
+  double percentile;
+  uint64_t delay;
+  std::vector<uint64_t> recent;
+  std::vector<uint64_t> scratch;
+  size_t recorded = 0;
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 4U
+#endif
+#ifndef MFD_HUGE_2MB
+#define MFD_HUGE_2MB MAP_HUGE_2MB
+#endif
+
+constexpr size_t HUGE_PAGE_2M = size_t{2} << 20;
+constexpr size_t HUGE_PAGE_1G = size_t{1} << 30;
+
+enum class HugePageMode { HUGETLB_1G, HUGETLB_2M, TRANSPARENT, NONE, FILE };
+
+inline const char* huge_page_mode_name(const HugePageMode mode) {
+  switch (mode) {
+    case HugePageMode::HUGETLB_1G:
+      return "hugetlb 1 GiB";
+    case HugePageMode::HUGETLB_2M:
+      return "hugetlb 2 MiB";
+    case HugePageMode::TRANSPARENT:
+      return "transparent 2 MiB";
+    case HugePageMode::FILE:
+      return "file mapping";
+    default:
+      return "4 KiB pages";
+  }
+}
+
+inline size_t round_up(const size_t value, const size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// madvise(MADV_HUGEPAGE) succeeds even when THP is switched off, so the
+// sysfs setting decides whether the advice means anything.
+inline bool transparent_huge_pages_enabled() {
+  std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string setting;
+  std::getline(file, setting);
+  return !setting.empty() && setting.find("[never]") == std::string::npos;
+}
+
+// Zero-initialised anonymous memory on the largest pages the system hands
+// out: explicit 1 GiB hugetlb pages for buffers of at least 1 GiB, then 2 MiB
+// hugetlb pages, then a 2 MiB aligned mapping advised for transparent huge
+// pages, then plain 4 KiB pages. Explicit hugetlb pages come from the
+// reserved pool (vm.nr_hugepages), so the first attempts fail cleanly when it
+// is empty.
+class HugePageBuffer {
+ public:
+  HugePageBuffer() = default;
+
+  explicit HugePageBuffer(const size_t size, const bool huge_pages = true)
+      : length(size) {
+    if (size == 0) {
+      return;
+    }
+    if (huge_pages) {
+      if (size >= HUGE_PAGE_1G &&
+          map_hugetlb(HUGE_PAGE_1G, MAP_HUGE_1GB, HugePageMode::HUGETLB_1G)) {
+        return;
+      }
+      if (map_hugetlb(HUGE_PAGE_2M, MAP_HUGE_2MB, HugePageMode::HUGETLB_2M)) {
+        return;
+      }
+    }
+    map_regular(huge_pages && transparent_huge_pages_enabled());
+  }
+
+  // Read-only shared mapping of a whole file, served from the page cache.
+  static HugePageBuffer map_file(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat status {};
+    if (fd < 0 || fstat(fd, &status) < 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("cannot open " + path);
+    }
+    HugePageBuffer buffer;
+    buffer.length = static_cast<size_t>(status.st_size);
+    buffer.mapping_length = buffer.length;
+    void* address =
+        mmap(nullptr, buffer.length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+      throw std::runtime_error("cannot map " + path);
+    }
+    madvise(address, buffer.length, MADV_WILLNEED);
+    buffer.mapping = address;
+    buffer.start = static_cast<uint8_t*>(address);
+    buffer.page_mode = HugePageMode::FILE;
+    return buffer;
+  }
+
+  // Zero-initialised memory in a memfd that other processes can map, on 2 MiB
+  // hugetlb pages if the pool has them.
+  static HugePageBuffer shared(const size_t size,
+                               const bool huge_pages = true) {
+    HugePageBuffer buffer;
+    buffer.length = size;
+    if (huge_pages && buffer.map_memfd(HUGE_PAGE_2M, MFD_HUGETLB | MFD_HUGE_2MB,
+                                       HugePageMode::HUGETLB_2M)) {
+      return buffer;
+    }
+    if (!buffer.map_memfd(static_cast<size_t>(getpagesize()), 0,
+                          HugePageMode::NONE)) {
+      throw std::bad_alloc();
+    }
+    return buffer;
+  }
+
+  // Makes a shared buffer immutable: remaps it read-only in place and seals
+  // the memfd against writes and resizing, which needs every writable mapping
+  // gone.
+  void seal() {
+    const std::string path = "/proc/self/fd/" + std::to_string(memfd);
+    const int read_only = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (read_only < 0) {
+      throw std::runtime_error("cannot reopen memfd read-only");
+    }
+    void* address = mmap(mapping, mapping_length, PROT_READ,
+                         MAP_SHARED | MAP_FIXED, read_only, 0);
+    close(read_only);
+    if (address == MAP_FAILED ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) <
+            0) {
+      throw std::runtime_error("cannot seal memfd");
+    }
+  }
+
+  HugePageBuffer(const HugePageBuffer&) = delete;
+  HugePageBuffer& operator=(const HugePageBuffer&) = delete;
+
+  HugePageBuffer(HugePageBuffer&& other) noexcept { swap(other); }
+
+  HugePageBuffer& operator=(HugePageBuffer&& other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~HugePageBuffer() {
+    if (mapping != nullptr) {
+      munmap(mapping, mapping_length);
+    }
+    if (memfd >= 0) {
+      close(memfd);
+    }
+  }
+
+  [[nodiscard]] uint8_t* data() { return start; }
+  [[nodiscard]] const uint8_t* data() const { return start; }
+  [[nodiscard]] size_t size() const { return length; }
+  [[nodiscard]] HugePageMode mode() const { return page_mode; }
+  // The memfd behind a shared() buffer and its size, -1 for other buffers.
+  [[nodiscard]] int fd() const { return memfd; }
+  [[nodiscard]] size_t mapped_size() const { return mapping_length; }
+
+  uint8_t& operator[](const size_t index) { return start[index]; }
+  const uint8_t& operator[](const size_t index) const { return start[index]; }
+
+  [[nodiscard]] bool contains(const void* pointer) const {
+    const auto* byte = static_cast<const uint8_t*>(pointer);
+    return byte >= start && byte < start + length;
+  }
+
+ private:
+  bool map_hugetlb(const size_t page_size, const int size_flag,
+                   const HugePageMode mode) {
+    const size_t rounded = round_up(length, page_size);
+    void* address =
+        mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+    if (address == MAP_FAILED) {
+      return false;
+    }
+    mapping = address;
+    mapping_length = rounded;
+    start = static_cast<uint8_t*>(address);
+    page_mode = mode;
+    return true;
+  }
+
+  bool map_memfd(const size_t page_size, const unsigned int flags,
+                 const HugePageMode mode) {
+    const size_t rounded = round_up(length, page_size);
+    const int fd =
+        memfd_create("pages", MFD_CLOEXEC | MFD_ALLOW_SEALING | flags);
+    if (fd < 0) {
+      return false;
+    }
+    void* address = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(rounded)) == 0) {
+      address =
+          mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (address == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    memfd = fd;
+    mapping = address;
+    mapping_length = rounded;
+    start = static_cast<uint8_t*>(address);
+    page_mode = mode;
+    return true;
+  }
+
+  // Over-allocates by one huge page so the buffer can start on a 2 MiB
+  // boundary; otherwise its first and last few MiB never get huge pages.
+  void map_regular(const bool transparent) {
+    mapping_length = transparent ? round_up(length, HUGE_PAGE_2M) + HUGE_PAGE_2M
+                                 : length;
+    void* address = mmap(nullptr, mapping_length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    mapping = address;
+    start = static_cast<uint8_t*>(address);
+    page_mode = HugePageMode::NONE;
+    if (transparent) {
+      start = reinterpret_cast<uint8_t*>(
+          round_up(reinterpret_cast<uintptr_t>(address), HUGE_PAGE_2M));
+      if (madvise(start, round_up(length, HUGE_PAGE_2M), MADV_HUGEPAGE) == 0) {
+        page_mode = HugePageMode::TRANSPARENT;
+      }
+    }
+  }
+
+  void swap(HugePageBuffer& other) noexcept {
+    std::swap(mapping, other.mapping);
+    std::swap(mapping_length, other.mapping_length);
+    std::swap(start, other.start);
+    std::swap(length, other.length);
+    std::swap(page_mode, other.page_mode);
+    std::swap(memfd, other.memfd);
+  }
+
+  void* mapping = nullptr;
+  size_t mapping_length = 0;
+  uint8_t* start = nullptr;
+  size_t length = 0;
+  HugePageMode page_mode = HugePageMode::NONE;
+  int memfd = -1;
+};
@@ -1,13 +1,15 @@
 
 #include <sys/uio.h>
 
+#include "static_config.hpp"
+
 #define IO_URING_QUEUE_DEPTH 512
 
 void setup_io_uring(struct io_uring& ring) {
   struct io_uring_params params {};
   memset(&params, 0, sizeof(params));
   params.flags = IORING_SETUP_SQPOLL;
-  params.sq_thread_idle = 10000;
+  params.sq_thread_idle = Config::sq_thread_idle_ms;
 
   int r = io_uring_queue_init_params(IO_URING_QUEUE_DEPTH, &ring, &params);
   if (r < 0) {
@@ -15,3 +17,30 @@ void setup_io_uring(struct io_uring& ring) {
     exit(1);
   }
 }
+
+// Lets the kernel busy-poll the NIC queues of the ring's sockets while the
+// reactor waits, if liburing and the kernel support it.
+void register_napi(struct io_uring& ring, const unsigned busy_poll_us) {
+#if LIBURING_VERSION_MAJOR > 2 || \
+    (LIBURING_VERSION_MAJOR == 2 && LIBURING_VERSION_MINOR >= 6)
+  struct io_uring_napi napi {};
+  napi.busy_poll_to = busy_poll_us;
+  napi.prefer_busy_poll = 1;
+  int r = io_uring_register_napi(&ring, &napi);
+  if (r < 0) {
+    spdlog::warn("NAPI busy poll not available: {}", strerror(-r));
+  }
+#else
+  spdlog::warn("NAPI busy poll needs liburing 2.6");
+#endif
+}
+
+// Returns a free SQE, submitting pending entries first if the ring is full.
+struct io_uring_sqe* get_sqe(struct io_uring& ring) {
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+  while (sqe == nullptr) {
+    io_uring_submit(&ring);
+    sqe = io_uring_get_sqe(&ring);
+  }
+  return sqe;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Which pages a client asks for. Keys are drawn up front for a thread's whole
+// share of the run, so generation never competes with the send loop, and the
+// stream depends only on the distribution and the slot range: two runs with
+// the same settings request the same pages in the same order.
+enum class KeyDistribution { SEQUENTIAL, UNIFORM, ZIPF, HOTSPOT, SCAN };
+
+inline KeyDistribution parse_key_distribution(const std::string& name) {
+  if (name == "sequential") return KeyDistribution::SEQUENTIAL;
+  if (name == "uniform") return KeyDistribution::UNIFORM;
+  if (name == "zipf") return KeyDistribution::ZIPF;
+  if (name == "hotspot") return KeyDistribution::HOTSPOT;
+  if (name == "scan") return KeyDistribution::SCAN;
+  throw std::invalid_argument("unknown key distribution: " + name);
+}
+
+struct KeyDistributionParams {
+  KeyDistribution kind = KeyDistribution::SEQUENTIAL;
+  uint64_t key_count = 1;
+  // Zipf exponent; 0 is uniform, YCSB uses 0.99. Must not be 1.
+  double zipf_theta = 0.99;
+  // HOTSPOT: `hotspot_probability` of requests go to the first
+  // `hotspot_fraction` of the keys.
+  double hotspot_fraction = 0.2;
+  double hotspot_probability = 0.8;
+  // SCAN: runs of consecutive keys starting at uniformly random keys.
+  size_t scan_length = 64;
+};
+
+class SplitMix64 {
+ public:
+  explicit SplitMix64(const uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = state += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  double unit() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+  // Uniform in [0, bound) without a division.
+  uint64_t below(const uint64_t bound) {
+    return static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(next()) * bound) >> 64);
+  }
+
+ private:
+  uint64_t state;
+};
+
+// Zipf ranks by the method of Gray et al., "Quickly generating billion-record
+// synthetic databases": constant time per key after computing zeta(n) once.
+// Rank 0 is the most popular key.
+class ZipfGenerator {
+ public:
+  ZipfGenerator(const uint64_t n, const double theta) : n(n) {
+    if (theta < 0 || theta == 1.0) {
+      throw std::invalid_argument("zipf theta must be >= 0 and != 1");
+    }
+    alpha = 1.0 / (1.0 - theta);
+    zetan = zeta(n, theta);
+    const double zeta2 = zeta(std::min<uint64_t>(n, 2), theta);
+    eta = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) /
+          (1.0 - zeta2 / zetan);
+    second = 1.0 + std::pow(0.5, theta);
+  }
+
+  uint64_t next(SplitMix64& rng) const {
+    const double u = rng.unit();
+    const double uz = u * zetan;
+    if (uz < 1.0) return 0;
+    if (uz < second) return std::min<uint64_t>(1, n - 1);
+    const auto rank = static_cast<uint64_t>(static_cast<double>(n) *
+                                            std::pow(eta * u - eta + 1, alpha));
+    return std::min(rank, n - 1);
+  }
+
+ private:
+  // Summed exactly for the first million terms; the tail is the Euler-Maclaurin
+  // estimate, which is accurate to far below the sampling noise and keeps
+  // start-up instant for stores of billions of pages.
+  static double zeta(const uint64_t n, const double theta) {
+    constexpr uint64_t EXACT_TERMS = 1 << 20;
+    const uint64_t m = std::min(n, EXACT_TERMS);
+    double sum = 0;
+    for (uint64_t i = m; i >= 1; --i) {
+      sum += std::pow(static_cast<double>(i), -theta);
+    }
+    if (n > m) {
+      const double a = static_cast<double>(m);
+      const double b = static_cast<double>(n);
+      sum += (std::pow(b, 1 - theta) - std::pow(a, 1 - theta)) / (1 - theta) +
+             (std::pow(b, -theta) - std::pow(a, -theta)) / 2;
+    }
+    return sum;
+  }
+
+  uint64_t n;
+  double alpha;
+  double zetan;
+  double eta;
+  double second;
+};
+
+// Keys for request slots [start, end). Popular Zipf ranks are scattered over
+// the key space by a multiplicative permutation, so that the hot set does not
+// sit in a handful of neighbouring pages; the hotspot stays contiguous on
+// purpose.
+inline std::vector<uint32_t> generate_keys(const KeyDistributionParams& params,
+                                           const size_t start,
+                                           const size_t end) {
+  const uint64_t n = std::max<uint64_t>(params.key_count, 1);
+  std::vector<uint32_t> keys(end - start);
+  SplitMix64 rng(start * 0x2545F4914F6CDD1Dull + n);
+  switch (params.kind) {
+    case KeyDistribution::SEQUENTIAL:
+      for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<uint32_t>((start + i) % n);
+      }
+      break;
+    case KeyDistribution::UNIFORM:
+      for (auto& key : keys) {
+        key = static_cast<uint32_t>(rng.below(n));
+      }
+      break;
+    case KeyDistribution::ZIPF: {
+      const ZipfGenerator zipf(n, params.zipf_theta);
+      // 2654435761 is prime, so this is a permutation unless it divides n.
+      const uint64_t scatter = n % 2654435761u == 0 ? 1 : 2654435761u;
+      for (auto& key : keys) {
+        key = static_cast<uint32_t>(
+            static_cast<unsigned __int128>(zipf.next(rng)) * scatter % n);
+      }
+      break;
+    }
+    case KeyDistribution::HOTSPOT: {
+      const uint64_t hot = std::clamp<uint64_t>(
+          static_cast<uint64_t>(params.hotspot_fraction * n), 1, n);
+      for (auto& key : keys) {
+        const bool in_hot =
+            hot == n || rng.unit() < params.hotspot_probability;
+        key = static_cast<uint32_t>(in_hot ? rng.below(hot)
+                                           : hot + rng.below(n - hot));
+      }
+      break;
+    }
+    case KeyDistribution::SCAN: {
+      const size_t length = std::max<size_t>(params.scan_length, 1);
+      uint64_t key = 0;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if ((start + i) % length == 0 || i == 0) {
+          key = rng.below(n);
+        }
+        keys[i] = static_cast<uint32_t>(key);
+        key = key + 1 == n ? 0 : key + 1;
+      }
+      break;
+    }
+  }
+  return keys;
+}
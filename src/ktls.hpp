@@ -0,0 +1,286 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#if USE_KTLS
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/ssl.h>
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+// Kernel TLS: the TLS 1.3 handshake runs in user space with OpenSSL, then the
+// traffic keys are handed to the kernel with setsockopt(SOL_TLS) and the
+// socket is used exactly like a plaintext one, io_uring sends and receives
+// included. Only TLS_AES_128_GCM_SHA256 is offered so the keys always fit
+// tls12_crypto_info_aes_gcm_128, and session tickets are disabled: the kernel
+// starts both directions at record sequence number 0, so no record may follow
+// the handshake in user space.
+
+enum class TlsRole { SERVER, CLIENT };
+
+// What a non-blocking handshake is waiting for, or how it ended.
+enum class TlsStep { DONE, WANT_READ, WANT_WRITE, FAILED };
+
+// A handshake that is not done after this long in total fails, however
+// steadily a slow peer keeps trickling bytes.
+constexpr int TLS_HANDSHAKE_TIMEOUT_MS = 5000;
+
+#if USE_KTLS
+
+struct TrafficSecrets {
+  std::vector<uint8_t> client;
+  std::vector<uint8_t> server;
+};
+
+inline std::vector<uint8_t> parse_hex(const std::string_view hex) {
+  std::vector<uint8_t> bytes(hex.size() / 2);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(
+        std::stoul(std::string(hex.substr(2 * i, 2)), nullptr, 16));
+  }
+  return bytes;
+}
+
+// OpenSSL reports every secret through the key log callback as
+// "<label> <client random> <secret>"; only the first application traffic
+// secrets are kept.
+inline void capture_secret(const SSL* ssl, const char* line) {
+  auto* secrets = static_cast<TrafficSecrets*>(SSL_get_app_data(ssl));
+  const std::string_view entry(line);
+  const std::string_view label = entry.substr(0, entry.find(' '));
+  const std::string_view secret = entry.substr(entry.rfind(' ') + 1);
+  if (label == "CLIENT_TRAFFIC_SECRET_0") {
+    secrets->client = parse_hex(secret);
+  } else if (label == "SERVER_TRAFFIC_SECRET_0") {
+    secrets->server = parse_hex(secret);
+  }
+}
+
+// HKDF-Expand-Label from RFC 8446 with an empty context.
+inline bool hkdf_expand_label(const std::vector<uint8_t>& secret,
+                              const std::string& label, uint8_t* out,
+                              size_t length) {
+  const std::string full_label = "tls13 " + label;
+  std::vector<uint8_t> info{static_cast<uint8_t>(length >> 8),
+                            static_cast<uint8_t>(length),
+                            static_cast<uint8_t>(full_label.size())};
+  info.insert(info.end(), full_label.begin(), full_label.end());
+  info.push_back(0);
+
+  EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+  const bool ok =
+      ctx != nullptr && EVP_PKEY_derive_init(ctx) > 0 &&
+      EVP_PKEY_CTX_set_hkdf_mode(ctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+      EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) > 0 &&
+      EVP_PKEY_CTX_set1_hkdf_key(ctx, secret.data(),
+                                 static_cast<int>(secret.size())) > 0 &&
+      EVP_PKEY_CTX_add1_hkdf_info(ctx, info.data(),
+                                  static_cast<int>(info.size())) > 0 &&
+      EVP_PKEY_derive(ctx, out, &length) > 0;
+  EVP_PKEY_CTX_free(ctx);
+  return ok;
+}
+
+// `direction` is TLS_TX or TLS_RX.
+inline bool install_key(const int fd, const int direction,
+                        const std::vector<uint8_t>& secret) {
+  tls12_crypto_info_aes_gcm_128 info{};
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+  uint8_t iv[TLS_CIPHER_AES_GCM_128_SALT_SIZE + TLS_CIPHER_AES_GCM_128_IV_SIZE];
+  if (!hkdf_expand_label(secret, "key", info.key, sizeof(info.key)) ||
+      !hkdf_expand_label(secret, "iv", iv, sizeof(iv))) {
+    return false;
+  }
+  memcpy(info.salt, iv, sizeof(info.salt));
+  memcpy(info.iv, iv + sizeof(info.salt), sizeof(info.iv));
+  return setsockopt(fd, SOL_TLS, direction, &info, sizeof(info)) == 0;
+}
+
+inline std::string openssl_error() {
+  const unsigned long code = ERR_get_error();
+  return code == 0 ? "handshake failed" : ERR_error_string(code, nullptr);
+}
+
+// One handshake on a non-blocking socket. step() gets as far as the socket
+// allows and says what to wait for next; DONE means kTLS is set up in both
+// directions. After FAILED `error` says why and the socket must be closed.
+class TlsHandshake {
+ public:
+  TlsHandshake(SSL_CTX* ctx, const TlsRole role,
+               const std::string& server_name, const int fd)
+      : role(role), fd(fd), ssl(SSL_new(ctx)) {
+    SSL_set_app_data(ssl, &secrets);
+    SSL_set_fd(ssl, fd);
+    if (role == TlsRole::CLIENT && !server_name.empty()) {
+      SSL_set1_host(ssl, server_name.c_str());
+    }
+  }
+
+  TlsHandshake(const TlsHandshake&) = delete;
+  TlsHandshake& operator=(const TlsHandshake&) = delete;
+
+  // The socket BIO does not own the fd, and freeing sends nothing.
+  ~TlsHandshake() { SSL_free(ssl); }
+
+  TlsStep step(std::string& error) {
+    const int r = role == TlsRole::SERVER ? SSL_accept(ssl) : SSL_connect(ssl);
+    if (r != 1) {
+      switch (SSL_get_error(ssl, r)) {
+        case SSL_ERROR_WANT_READ:
+          return TlsStep::WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+          return TlsStep::WANT_WRITE;
+        default:
+          error = openssl_error();
+          return TlsStep::FAILED;
+      }
+    }
+    if (secrets.client.empty() || secrets.server.empty()) {
+      error = "traffic secrets not captured";
+      return TlsStep::FAILED;
+    }
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+      error = std::string("TCP_ULP tls: ") + strerror(errno);
+      return TlsStep::FAILED;
+    }
+    const bool server = role == TlsRole::SERVER;
+    if (!install_key(fd, TLS_TX, server ? secrets.server : secrets.client) ||
+        !install_key(fd, TLS_RX, server ? secrets.client : secrets.server)) {
+      error = std::string("SOL_TLS: ") + strerror(errno);
+      return TlsStep::FAILED;
+    }
+    return TlsStep::DONE;
+  }
+
+ private:
+  TlsRole role;
+  int fd;
+  TrafficSecrets secrets;
+  SSL* ssl;
+};
+
+class TlsContext {
+ public:
+  // Servers present `cert_file`/`key_file`; clients verify the server chain
+  // against `ca_file` and, if `server_name` is set, the certificate name.
+  TlsContext(const TlsRole role, const std::string& ca_file,
+             const std::string& cert_file, const std::string& key_file,
+             const std::string& server_name = "")
+      : role(role), server_name(server_name) {
+    ctx = SSL_CTX_new(role == TlsRole::SERVER ? TLS_server_method()
+                                              : TLS_client_method());
+    if (ctx == nullptr) {
+      throw std::runtime_error("SSL_CTX_new failed");
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256");
+    SSL_CTX_set_num_tickets(ctx, 0);
+    SSL_CTX_set_keylog_callback(ctx, capture_secret);
+    if (role == TlsRole::SERVER) {
+      if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1 ||
+          SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(),
+                                      SSL_FILETYPE_PEM) != 1) {
+        throw std::runtime_error("cannot load " + cert_file + " / " +
+                                 key_file + ": " + openssl_error());
+      }
+    } else {
+      if (SSL_CTX_load_verify_locations(ctx, ca_file.c_str(), nullptr) != 1) {
+        throw std::runtime_error("cannot load " + ca_file + ": " +
+                                 openssl_error());
+      }
+      SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+    }
+  }
+
+  TlsContext(const TlsContext&) = delete;
+  TlsContext& operator=(const TlsContext&) = delete;
+
+  ~TlsContext() { SSL_CTX_free(ctx); }
+
+  // Starts a handshake on the connected socket `fd`, which the caller must
+  // have made non-blocking.
+  [[nodiscard]] std::unique_ptr<TlsHandshake> start(const int fd) const {
+    return std::make_unique<TlsHandshake>(ctx, role, server_name, fd);
+  }
+
+  // Runs a whole handshake on the connected socket `fd` and switches it to
+  // kTLS in both directions, giving up after TLS_HANDSHAKE_TIMEOUT_MS. On
+  // failure `error` says why and the socket must be closed.
+  bool handshake(const int fd, std::string& error) const {
+    const int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(TLS_HANDSHAKE_TIMEOUT_MS);
+    const auto handshake = start(fd);
+    TlsStep step = handshake->step(error);
+    while (step == TlsStep::WANT_READ || step == TlsStep::WANT_WRITE) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - std::chrono::steady_clock::now())
+                            .count();
+      pollfd pfd{fd, static_cast<short>(step == TlsStep::WANT_READ ? POLLIN
+                                                                    : POLLOUT),
+                 0};
+      if (left <= 0 || poll(&pfd, 1, static_cast<int>(left)) == 0) {
+        error = "handshake timed out";
+        step = TlsStep::FAILED;
+        break;
+      }
+      step = handshake->step(error);
+    }
+    fcntl(fd, F_SETFL, flags);
+    return step == TlsStep::DONE;
+  }
+
+ private:
+  TlsRole role;
+  std::string server_name;
+  SSL_CTX* ctx;
+};
+
+#else
+
+class TlsHandshake {
+ public:
+  TlsStep step(std::string& error) {
+    error = "built without kTLS";
+    return TlsStep::FAILED;
+  }
+};
+
+class TlsContext {
+ public:
+  TlsContext(TlsRole, const std::string&, const std::string&,
+             const std::string&, const std::string& = "") {
+    throw std::runtime_error("TLS requested, but built without -DKTLS=ON");
+  }
+
+  [[nodiscard]] std::unique_ptr<TlsHandshake> start(int) const {
+    return std::make_unique<TlsHandshake>();
+  }
+
+  bool handshake(int, std::string& error) const {
+    error = "built without kTLS";
+    return false;
+  }
+};
+
+#endif
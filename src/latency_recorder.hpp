@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+inline uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Wall-clock time, for deadlines that have to mean the same on both ends.
+inline uint64_t realtime_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Keeps every sample so percentiles are exact; one recorder per thread,
+// merged at the end of a run.
+class LatencyRecorder {
+ public:
+  void record(const uint64_t latency_ns) { samples.push_back(latency_ns); }
+
+  void merge(const LatencyRecorder& other) {
+    samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    sorted = false;
+  }
+
+  [[nodiscard]] size_t count() const { return samples.size(); }
+
+  // `p` in [0, 100]. Returns 0 if nothing was recorded.
+  double percentile_us(const double p) {
+    if (samples.empty()) {
+      return 0;
+    }
+    if (!sorted) {
+      std::sort(samples.begin(), samples.end());
+      sorted = true;
+    }
+    const auto index = static_cast<size_t>(
+        p / 100.0 * static_cast<double>(samples.size() - 1));
+    return static_cast<double>(samples[index]) / 1000.0;
+  }
+
+ private:
+  std::vector<uint64_t> samples;
+  bool sorted = false;
+};
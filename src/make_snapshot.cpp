@@ -0,0 +1,49 @@
+#include <spdlog/spdlog.h>
+
+#include "latency_recorder.hpp"
+#include "memory_block.hpp"
+#include "page_index.hpp"
+#include "snapshot.hpp"
+#include "static_config.hpp"
+
+// Converts a filling strategy into a snapshot that server_iou can load with
+// SNAPSHOT=<path>. Uses PAGE_COUNT, FILL_STRATEGY and CHECKSUMS; with SPARSE
+// the pages get the ids of sparse_page_id.
+int main() {
+  Config::load_config();
+  if (Config::snapshot.empty()) {
+    spdlog::critical("Set SNAPSHOT to the output path");
+    return EXIT_FAILURE;
+  }
+
+  uint64_t start_ns = now_ns();
+  MemoryBlock<PAGE_SIZE> memory_block(
+      Config::page_count, make_filling_strategy(Config::fill_strategy),
+      Config::huge_pages, FillMode::PARALLEL, Config::fill_threads);
+  spdlog::info("Filled {} pages of {} bytes with {} in {:.3f} s",
+               memory_block.page_count(), PAGE_SIZE, Config::fill_strategy,
+               static_cast<double>(now_ns() - start_ns) / 1e9);
+
+  std::vector<uint64_t> page_ids;
+  if (Config::sparse) {
+    page_ids.resize(memory_block.page_count());
+    for (size_t i = 0; i < page_ids.size(); ++i) {
+      page_ids[i] = sparse_page_id(i);
+    }
+  }
+
+  start_ns = now_ns();
+  try {
+    write_snapshot(Config::snapshot, PAGE_SIZE, memory_block.page_count(),
+                   memory_block.page(0),
+                   page_ids.empty() ? nullptr : page_ids.data(),
+                   Config::checksums);
+  } catch (const std::exception& e) {
+    spdlog::critical("Writing {} failed: {}", Config::snapshot, e.what());
+    return EXIT_FAILURE;
+  }
+  const double seconds = static_cast<double>(now_ns() - start_ns) / 1e9;
+  spdlog::info("Wrote {} (checksums: {}) in {:.3f} s, {:.2f} GB/s",
+               Config::snapshot, Config::checksums, seconds,
+               static_cast<double>(memory_block.size_bytes()) / seconds / 1e9);
+}
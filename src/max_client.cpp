@@ -35,7 +35,8 @@ int setup_socket() {
   return sock;
 }
 
-void send_data(size_t start_index, size_t end_index, size_t thread_index) {
+void send_data(size_t start_index, size_t end_index, size_t thread_index,
+               const uint32_t* pages) {
   size_t local_num_requests = end_index - start_index;
   printf("[%lu] Sending %lu requests\n", thread_index, local_num_requests);
   int sock = setup_socket();
@@ -54,7 +55,10 @@ void send_data(size_t start_index, size_t end_index, size_t thread_index) {
     return;
   }
 
-  std::vector<int32_t> buffer(PAGE_SIZE);
+  // One page-sized request per ring slot, each led by its page number; a
+  // slot comes round again only after RING_SIZE more sends were queued, and
+  // at most RING_SIZE are ever in flight.
+  std::vector<int32_t> buffers(RING_SIZE * PAGE_SIZE);
   size_t requests_sent = 0;
   size_t requests_completed = 0;
 
@@ -66,9 +70,9 @@ void send_data(size_t start_index, size_t end_index, size_t thread_index) {
       struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
       if (!sqe) break;
 
-      // std::fill(buffer.begin(), buffer.end(), start_index + requests_sent);
-      io_uring_prep_send(sqe, sock, buffer.data(),
-                         buffer.size() * sizeof(int32_t), 0);
+      int32_t* buffer = &buffers[(requests_sent % RING_SIZE) * PAGE_SIZE];
+      buffer[0] = static_cast<int32_t>(pages[start_index + requests_sent]);
+      io_uring_prep_send(sqe, sock, buffer, PAGE_SIZE * sizeof(int32_t), 0);
       io_uring_sqe_set_data(sqe, (void*)(start_index + requests_sent));
 
       requests_sent++;
@@ -119,6 +123,9 @@ void send_data(size_t start_index, size_t end_index, size_t thread_index) {
 int main() {
   std::vector<std::thread> threads;
   size_t requests_per_thread = NUM_REQUESTS / CLIENT_THREADS;
+  const std::vector<uint32_t> pages =
+      generate_keys(simple_key_distribution(), 0, NUM_REQUESTS);
+  std::cout << "Key distribution: " << KEY_DISTRIBUTION << std::endl;
 
   auto start_time = std::chrono::high_resolution_clock::now();
 
@@ -127,7 +134,7 @@ int main() {
     size_t end_index = (i == CLIENT_THREADS - 1)
                            ? NUM_REQUESTS
                            : (i + 1) * requests_per_thread;
-    threads.emplace_back(send_data, start_index, end_index, i);
+    threads.emplace_back(send_data, start_index, end_index, i, pages.data());
   }
 
   for (auto& thread : threads) {
@@ -14,10 +14,13 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 
 #include "buffer_pool.hpp"
+#include "connection_loop.hpp"
+#include "process_stats.hpp"
 #include "simple_consts.hpp"
 
 void add_read_request(struct io_uring& ring, int client_socket,
@@ -35,6 +38,10 @@ uint64_t event_loop(struct io_uring& ring, int client_socket,
   std::vector buffer_sizes = {sizeof(RequestData) +
                               PAGE_SIZE * sizeof(int32_t)};
   BufferPool buffer_pool(buffer_sizes, BUFFER_POOL_INITIAL_POOL_SIZE);
+#if HUGE_PAGES
+  std::cout << "Buffer arena on " << huge_page_mode_name(buffer_pool.arena_mode())
+            << std::endl;
+#endif
 
   for (int i = 0; i < RING_SIZE; i++) {
     auto* req = (RequestData*)buffer_pool.allocate(sizeof(RequestData) +
@@ -118,6 +125,28 @@ int main() {
   bool started = false;
   auto start_time = std::chrono::high_resolution_clock::now();
 
+#if EVENT_LOOPS
+  // Nothing is sent back, so the loops only count bytes. The clock starts
+  // when the loops do rather than at the first accept.
+  raise_fd_limit();
+  auto count_bytes = [&total_bytes_received](auto&, uint32_t, const uint8_t*,
+                                             const size_t length) {
+    total_bytes_received += length;
+  };
+  using CountingLoop = ConnectionLoop<decltype(count_bytes)>;
+  LoopCounters counters;
+  std::vector<std::unique_ptr<CountingLoop>> loops;
+  for (int i = 0; i < EVENT_LOOPS; i++) {
+    loops.push_back(
+        std::make_unique<CountingLoop>(server_fd, 0, counters, count_bytes));
+  }
+  ConnectionMemoryReport report;
+  std::atomic<bool> stop{false};
+  for (auto& loop : loops) {
+    client_threads.emplace_back([&loop, &stop] { loop->run(stop); });
+  }
+  start_time = std::chrono::high_resolution_clock::now();
+#else
   for (int i = 0; i < CLIENT_THREADS; ++i) {
     int new_socket;
     if ((new_socket = accept(server_fd, reinterpret_cast<sockaddr*>(&address),
@@ -135,6 +164,7 @@ int main() {
                                 std::ref(total_bytes_received),
                                 std::ref(finished_threads));
   }
+#endif
 
   uint64_t expected_total_bytes =
       (int64_t)NUM_REQUESTS * PAGE_SIZE * sizeof(int32_t);
@@ -159,9 +189,20 @@ int main() {
   std::cout << "Time taken: " << seconds << " seconds" << std::endl;
   std::cout << "Throughput: " << gbps << " Gbps" << std::endl;
 
+#if EVENT_LOOPS
+  while (counters.closed.load() < CLIENT_THREADS) {
+    report.sample(counters.accepted.load() - counters.closed.load(),
+                  counters.closed.load());
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+  stop = true;
+#endif
   for (auto& thread : client_threads) {
     thread.join();
   }
+#if EVENT_LOOPS
+  report.print_peak();
+#endif
 
   close(server_fd);
   std::cout << "Server shutting down" << std::endl;
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "consts.hpp"
+#include "huge_pages.hpp"
+#include "snapshot.hpp"
 
 class IFillingStrategy {
  public:
@@ -33,28 +41,168 @@ class PseudoRandomFillingStrategy final : public IFillingStrategy {
   }
 };
 
-template <size_t PAGE_SIZE>
+inline const IFillingStrategy* make_filling_strategy(const std::string& name) {
+  if (name == "alphabetical") {
+    return new AlphabeticalFillingStrategy();
+  }
+  if (name == "pseudo_random") {
+    return new PseudoRandomFillingStrategy();
+  }
+  throw std::runtime_error("Unknown filling strategy: " + name);
+}
+
+// SERIAL and PARALLEL fill every page before the constructor returns. LAZY
+// leaves the memory untouched: a page is filled by whoever calls materialize()
+// on it first, readers or a background warm_up().
+enum class FillMode { SERIAL, PARALLEL, LAZY };
+
+inline FillMode parse_fill_mode(const std::string& name) {
+  if (name == "serial") {
+    return FillMode::SERIAL;
+  }
+  if (name == "lazy") {
+    return FillMode::LAZY;
+  }
+  return FillMode::PARALLEL;
+}
+
+template <size_t PageSize>
 class MemoryBlock {
  public:
-  std::vector<uint8_t> data;
+  HugePageBuffer data;
   const IFillingStrategy* strategy;
+  // CRC32C of every page, if a snapshot provided them.
+  const uint32_t* checksums = nullptr;
+  // Id of every page, ascending, if a sparse snapshot provided them.
+  const uint64_t* page_ids = nullptr;
 
-  MemoryBlock(const size_t page_count, const IFillingStrategy* strategy)
-      : data(PAGE_SIZE * page_count, 0), strategy(strategy) {
+  // `threads` == 0 uses every core.
+  MemoryBlock(const size_t page_count, const IFillingStrategy* strategy,
+              const bool huge_pages = true,
+              const FillMode mode = FillMode::SERIAL, const size_t threads = 0)
+      : MemoryBlock(HugePageBuffer(PageSize * page_count, huge_pages),
+                    page_count, strategy, mode, threads) {}
+
+  // Fills `buffer`, which must hold `page_count` pages, e.g. a
+  // HugePageBuffer::shared() one that is handed to other processes.
+  MemoryBlock(HugePageBuffer buffer, const size_t page_count,
+              const IFillingStrategy* strategy,
+              const FillMode mode = FillMode::SERIAL, const size_t threads = 0)
+      : data(std::move(buffer)),
+        strategy(strategy),
+        pages(data.data()),
+        pages_count(page_count) {
     if (strategy == nullptr) {
       throw std::runtime_error("Filling strategy is not set");
     }
-    fill();
+    switch (mode) {
+      case FillMode::SERIAL:
+        fill();
+        break;
+      case FillMode::PARALLEL:
+        for_each_range(threads, [this](const size_t begin, const size_t end) {
+          fill_pages(begin, end);
+        });
+        break;
+      case FillMode::LAZY:
+        states = std::make_unique<std::atomic<uint8_t>[]>(page_count);
+        break;
+    }
   }
 
-  void fill() {
-    for (size_t i = 0; i < data.size(); ++i) {
-      data[i] = strategy->get_value_at(i);
+  // Serves the pages of a snapshot in place, from one mapping of the whole
+  // file.
+  explicit MemoryBlock(const std::string& snapshot_path)
+      : data(HugePageBuffer::map_file(snapshot_path)), strategy(nullptr) {
+    const SnapshotView view(data.data(), data.size());
+    if (view.header->page_size != PageSize) {
+      throw std::runtime_error("snapshot has " +
+                               std::to_string(view.header->page_size) +
+                               " byte pages, expected " +
+                               std::to_string(PageSize));
     }
+    pages = view.pages;
+    pages_count = view.header->page_count;
+    checksums = view.checksums;
+    page_ids = view.page_ids;
   }
+
+  [[nodiscard]] const uint8_t* page(const size_t page_number) const {
+    return pages + page_number * PageSize;
+  }
+
+  [[nodiscard]] size_t page_count() const { return pages_count; }
+
+  [[nodiscard]] size_t size_bytes() const { return pages_count * PageSize; }
+
+  void fill() { fill_pages(0, page_count()); }
+
+  [[nodiscard]] bool lazy() const { return states != nullptr; }
+
+  // Fills the page unless that already happened; waits if another thread is
+  // filling it right now. Does nothing for eagerly filled blocks.
+  void materialize(const size_t page_number) const {
+    if (states == nullptr ||
+        states[page_number].load(std::memory_order_acquire) == READY) {
+      return;
+    }
+    uint8_t expected = EMPTY;
+    if (states[page_number].compare_exchange_strong(
+            expected, FILLING, std::memory_order_acquire)) {
+      fill_pages(page_number, page_number + 1);
+      states[page_number].store(READY, std::memory_order_release);
+      return;
+    }
+    while (states[page_number].load(std::memory_order_acquire) != READY) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Materializes every page, split across `threads` (0 = every core).
+  void warm_up(const size_t threads = 0) const {
+    for_each_range(threads, [this](const size_t begin, const size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        materialize(i);
+      }
+    });
+  }
+
+ private:
+  static constexpr uint8_t EMPTY = 0;
+  static constexpr uint8_t FILLING = 1;
+  static constexpr uint8_t READY = 2;
+
+  // Writing through a const block is fine: a page is only ever written once,
+  // before anybody may read it.
+  void fill_pages(const size_t begin, const size_t end) const {
+    auto* bytes = const_cast<uint8_t*>(pages);
+    for (size_t i = begin * PageSize; i < end * PageSize; ++i) {
+      bytes[i] = strategy->get_value_at(i);
+    }
+  }
+
+  template <typename F>
+  void for_each_range(size_t threads, const F& work) const {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const size_t pages = page_count();
+    const size_t per_thread = (pages + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (size_t begin = 0; begin < pages; begin += per_thread) {
+      workers.emplace_back(work, begin, std::min(pages, begin + per_thread));
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  const uint8_t* pages = nullptr;
+  size_t pages_count = 0;
+  std::unique_ptr<std::atomic<uint8_t>[]> states;
 };
 
-template <size_t PAGE_SIZE>
+template <size_t PageSize>
 class MemoryBlockVerifier {
  public:
   size_t page_count;
@@ -67,14 +215,14 @@ class MemoryBlockVerifier {
     }
   }
 
-  [[nodiscard]] bool verify(const std::array<uint8_t, PAGE_SIZE>& page_content,
+  [[nodiscard]] bool verify(const std::array<uint8_t, PageSize>& page_content,
                             const size_t page_number) const {
     if (page_number >= page_count) {
       return false;
     }
-    for (size_t i = 0; i < PAGE_SIZE; ++i) {
+    for (size_t i = 0; i < PageSize; ++i) {
       if (page_content[i] !=
-          strategy->get_value_at(page_number * PAGE_SIZE + i)) {
+          strategy->get_value_at(page_number * PageSize + i)) {
         return false;
       }
     }
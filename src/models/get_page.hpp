@@ -1,28 +1,149 @@
 #pragma once
 
+#include <endian.h>
+
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include "../consts.hpp"
+#include "request.hpp"
 
 enum GetPageStatus : uint32_t {
   SUCCESS = 200,
   INVALID_PAGE_NUMBER = 400,
+  // The server is over its memory budget; the request was not served.
+  OVERLOADED = 503,
+  // The request's deadline passed before the server got to it.
+  DEADLINE_EXCEEDED = 504,
+};
+
+enum ResponseFlags : uint32_t {
+  // Content is a page_codec block that decodes to PAGE_SIZE bytes.
+  RESPONSE_COMPRESSED = 1u << 0,
+  // `checksum` holds the CRC32C of the uncompressed page.
+  RESPONSE_CHECKSUMMED = 1u << 1,
+  // Answers a StreamPagesRequest: `content_length` counts whole pages, which
+  // follow the header back to back.
+  RESPONSE_STREAM = 1u << 2,
 };
 
 #pragma pack(push, 1)
 struct GetPageRequest {
-  uint32_t request_id;
+  RequestHeader header;
   uint32_t page_number;
 
   void to_network_order() {
-    request_id = htonl(request_id);
+    header.to_network_order();
     page_number = htonl(page_number);
   }
 
   void to_host_order() {
-    request_id = ntohl(request_id);
+    header.to_host_order();
+    page_number = ntohl(page_number);
+  }
+};
+#pragma pack(pop)
+
+// A GetPageRequest the server drops once `deadline_us` has passed, answering
+// DEADLINE_EXCEEDED without a body. The deadline is absolute, in microseconds
+// of CLOCK_REALTIME, so time spent in socket buffers counts against it; client
+// and server clocks are assumed to be synchronised.
+#pragma pack(push, 1)
+struct DeadlineGetPageRequest {
+  RequestHeader header;
+  uint32_t page_number;
+  uint64_t deadline_us;
+
+  void to_network_order() {
+    header.to_network_order();
+    page_number = htonl(page_number);
+    deadline_us = htobe64(deadline_us);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
     page_number = ntohl(page_number);
+    deadline_us = be64toh(deadline_us);
+  }
+};
+#pragma pack(pop)
+
+// Looks a page up by its 64-bit id in a sparse store. The response is a
+// regular GetPageResponse whose page_number is the slot the id maps to.
+#pragma pack(push, 1)
+struct GetPageByIdRequest {
+  RequestHeader header;
+  uint64_t page_id;
+
+  void to_network_order() {
+    header.to_network_order();
+    page_id = htobe64(page_id);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
+    page_id = be64toh(page_id);
+  }
+};
+#pragma pack(pop)
+
+// Asks for up to MAX_MULTI_GET_PAGES pages at once. Only the first
+// `page_count` entries of `page_numbers` go over the wire; the server answers
+// with one GetPageResponse per entry, all carrying the same request_id.
+#pragma pack(push, 1)
+struct MultiGetPageRequest {
+  RequestHeader header;
+  uint32_t page_count;
+  uint32_t page_numbers[MAX_MULTI_GET_PAGES];
+
+  static constexpr size_t size_for(const size_t page_count) {
+    return sizeof(RequestHeader) + sizeof(uint32_t) +
+           page_count * sizeof(uint32_t);
+  }
+
+  // Must be called while the request is in host order.
+  [[nodiscard]] size_t size() const { return size_for(page_count); }
+
+  void to_network_order() {
+    header.to_network_order();
+    for (uint32_t i = 0; i < page_count; ++i) {
+      page_numbers[i] = htonl(page_numbers[i]);
+    }
+    page_count = htonl(page_count);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
+    page_count = ntohl(page_count);
+    for (uint32_t i = 0; i < page_count; ++i) {
+      page_numbers[i] = ntohl(page_numbers[i]);
+    }
+  }
+};
+#pragma pack(pop)
+
+// Asks for pages [first_page, first_page + page_count) in bulk. The answer is
+// one GetPageResponseHeader with RESPONSE_STREAM, page_number = first_page and
+// content_length = page_count, followed by the raw pages without per-page
+// headers. Each page is sent at whatever version is current when the server
+// reaches it, so a stream that overlaps writes is not a snapshot.
+#pragma pack(push, 1)
+struct StreamPagesRequest {
+  RequestHeader header;
+  uint32_t first_page;
+  uint32_t page_count;
+
+  void to_network_order() {
+    header.to_network_order();
+    first_page = htonl(first_page);
+    page_count = htonl(page_count);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
+    first_page = ntohl(first_page);
+    page_count = ntohl(page_count);
   }
 };
 #pragma pack(pop)
@@ -32,17 +153,31 @@ struct GetPageResponseHeader {
   uint32_t request_id;
   uint32_t status;
   uint32_t page_number;
+  // Version of the page the content was taken from; bumped by every PutPage.
+  uint32_t version;
+  // Number of content bytes following the header.
+  uint32_t content_length;
+  uint32_t flags;
+  uint32_t checksum;
 
   void to_network_order() {
     request_id = htonl(request_id);
     status = htonl(status);
     page_number = htonl(page_number);
+    version = htonl(version);
+    content_length = htonl(content_length);
+    flags = htonl(flags);
+    checksum = htonl(checksum);
   }
 
   void to_host_order() {
     request_id = ntohl(request_id);
     status = ntohl(status);
     page_number = ntohl(page_number);
+    version = ntohl(version);
+    content_length = ntohl(content_length);
+    flags = ntohl(flags);
+    checksum = ntohl(checksum);
   }
 
   [[nodiscard]] GetPageStatus get_status() const {
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "request.hpp"
+
+// Optional protocol features, negotiated once per connection. The client
+// lists what it supports, the server answers with a GetPageResponseHeader
+// whose 4-byte content is the subset it enabled for this connection.
+enum Feature : uint32_t {
+  FEATURE_COMPRESSION = 1u << 0,
+  FEATURE_CHECKSUM = 1u << 1,
+};
+
+// Request id reserved for the handshake so its reply is never mistaken for a
+// page response.
+constexpr uint32_t HELLO_REQUEST_ID = UINT32_MAX;
+
+#pragma pack(push, 1)
+struct HelloRequest {
+  RequestHeader header;
+  uint32_t features;
+
+  void to_network_order() {
+    header.to_network_order();
+    features = htonl(features);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
+    features = ntohl(features);
+  }
+};
+#pragma pack(pop)
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "../consts.hpp"
+#include "request.hpp"
+
+// Replaces the content of a page. The server answers with a
+// GetPageResponseHeader without content that carries the new version.
+#pragma pack(push, 1)
+struct PutPageRequest {
+  RequestHeader header;
+  uint32_t page_number;
+  std::array<uint8_t, PAGE_SIZE> content;
+
+  void to_network_order() {
+    header.to_network_order();
+    page_number = htonl(page_number);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
+    page_number = ntohl(page_number);
+  }
+};
+#pragma pack(pop)
+
+// A page update a primary pushes to its replicas. The replica keeps the
+// primary's version number and ignores updates older than what it has, then
+// acknowledges with a GetPageResponseHeader carrying its current version.
+#pragma pack(push, 1)
+struct ReplicatePageRequest {
+  RequestHeader header;
+  uint32_t page_number;
+  uint32_t version;
+  std::array<uint8_t, PAGE_SIZE> content;
+
+  void to_network_order() {
+    header.to_network_order();
+    page_number = htonl(page_number);
+    version = htonl(version);
+  }
+
+  void to_host_order() {
+    header.to_host_order();
+    page_number = ntohl(page_number);
+    version = ntohl(version);
+  }
+};
+#pragma pack(pop)
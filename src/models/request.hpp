@@ -0,0 +1,43 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <cstdint>
+
+enum RequestType : uint32_t {
+  GET_PAGE = 1,
+  MULTI_GET_PAGE = 2,
+  PUT_PAGE = 3,
+  HELLO = 4,
+  GET_PAGE_BY_ID = 5,
+  STREAM_PAGES = 6,
+  GET_PAGE_WITH_DEADLINE = 7,
+  REPLICATE_PAGE = 8,
+};
+
+// Requests with a higher priority get a proportionally larger share of a
+// reactor when it schedules connections (see DRR_QUANTUM_BYTES).
+constexpr uint8_t MAX_PRIORITY = 7;
+
+#pragma pack(push, 1)
+struct RequestHeader {
+  uint16_t type;
+  uint8_t priority;
+  uint8_t reserved;
+  uint32_t request_id;
+
+  void to_network_order() {
+    type = htons(type);
+    request_id = htonl(request_id);
+  }
+
+  void to_host_order() {
+    type = ntohs(type);
+    request_id = ntohl(request_id);
+  }
+
+  [[nodiscard]] RequestType get_type() const {
+    return static_cast<RequestType>(type);
+  }
+};
+#pragma pack(pop)
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "get_page.hpp"
+
+// Largest UDP payload that fits a 1500 byte MTU without IP fragmentation.
+constexpr size_t UDP_MAX_PAYLOAD = 1500 - 20 - 8;
+
+// Every response datagram starts with this header. Pages that do not fit in
+// one datagram are split into equally sized fragments (the last one may be
+// shorter); `page.content_length` is the length of this fragment.
+#pragma pack(push, 1)
+struct UdpResponseHeader {
+  GetPageResponseHeader page;
+  uint16_t fragment_index;
+  uint16_t fragment_count;
+
+  void to_network_order() {
+    page.to_network_order();
+    fragment_index = htons(fragment_index);
+    fragment_count = htons(fragment_count);
+  }
+
+  void to_host_order() {
+    page.to_host_order();
+    fragment_index = ntohs(fragment_index);
+    fragment_count = ntohs(fragment_count);
+  }
+};
+#pragma pack(pop)
+
+constexpr size_t UDP_FRAGMENT_SIZE = UDP_MAX_PAYLOAD - sizeof(UdpResponseHeader);
+constexpr size_t UDP_FRAGMENTS_PER_PAGE =
+    (PAGE_SIZE + UDP_FRAGMENT_SIZE - 1) / UDP_FRAGMENT_SIZE;
+// All fragments of a page go out in one GSO send, which is limited to 64
+// segments and one maximum-sized UDP payload.
+static_assert(UDP_FRAGMENTS_PER_PAGE <= 64 &&
+                  UDP_FRAGMENTS_PER_PAGE * UDP_MAX_PAYLOAD <= 65507,
+              "PAGE_SIZE too large for UDP mode");
@@ -0,0 +1,535 @@
+#include <liburing.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "consts.hpp"
+#include "io_uring_utils.hpp"
+#include "latency_recorder.hpp"
+#include "spdlog/spdlog.h"
+#include "static_config.hpp"
+#include "utils.hpp"
+
+// A TCP proxy that makes a loopback connection behave like a wide-area one.
+// Every connection to PROXY_PORT is relayed to HOST:PORT, and each direction
+// is held back by PROXY_DELAY_US plus up to PROXY_JITTER_US, limited to
+// PROXY_BANDWIDTH_MBPS, and reset with PROXY_RESET_PERCENT. Bytes cannot be
+// dropped from a TCP stream, so PROXY_LOSS_PERCENT models what the receiver
+// of a lost segment sees: that data and everything behind it arrive
+// PROXY_RTO_US late, as after a retransmission timeout. Probabilities apply
+// to every chunk read from a socket, of up to CHUNK_SIZE bytes.
+
+constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+enum ProxyEvent {
+  PROXY_ACCEPT,
+  PROXY_CONNECT,
+  PROXY_RECV,
+  PROXY_SEND,
+  PROXY_CANCEL
+};
+
+struct Flow;
+
+struct ProxyOp {
+  ProxyEvent type;
+  Flow* flow;
+};
+
+struct Chunk {
+  std::unique_ptr<uint8_t[]> data;
+  size_t length;
+  size_t sent;
+  uint64_t due_ns;
+};
+
+struct Link;
+
+// One direction of a proxied connection: read from `from`, delayed, written
+// to `to`.
+struct Flow {
+  Flow(Link* link, const int from, const int to, const bool upstream)
+      : link(link), from(from), to(to), upstream(upstream) {}
+
+  Link* link;
+  int from;
+  int to;
+  bool upstream;
+  ProxyOp recv_op{PROXY_RECV, this};
+  ProxyOp send_op{PROXY_SEND, this};
+  std::unique_ptr<uint8_t[]> recv_buffer;
+  std::deque<Chunk> chunks;
+  size_t queued_bytes = 0;
+  // When the last chunk cleared the bandwidth limit, and when it is due.
+  uint64_t last_departure_ns = 0;
+  uint64_t last_due_ns = 0;
+  bool recv_in_flight = false;
+  bool send_in_flight = false;
+  // The sender closed its side; passed on once every chunk is delivered.
+  bool eof = false;
+  bool shut_down = false;
+};
+
+struct Link {
+  Link(const int client_fd, const int server_fd)
+      : client_fd(client_fd),
+        server_fd(server_fd),
+        upstream(this, client_fd, server_fd, true),
+        downstream(this, server_fd, client_fd, false) {}
+
+  int client_fd;
+  int server_fd;
+  Flow upstream;
+  Flow downstream;
+  ProxyOp connect_op{PROXY_CONNECT, &upstream};
+  bool connect_in_flight = false;
+  // Operations in flight and timer entries that still point at the link.
+  size_t refs = 0;
+  bool closing = false;
+};
+
+struct Proxy {
+  Proxy(const size_t index, const int listen_fd, const sockaddr_storage& target,
+        const socklen_t target_length)
+      : index(index),
+        listen_fd(listen_fd),
+        target(target),
+        target_length(target_length),
+        random(std::random_device{}()) {}
+
+  size_t index;
+  int listen_fd;
+  sockaddr_storage target;
+  socklen_t target_length;
+  struct io_uring ring {};
+  ProxyOp accept_op{PROXY_ACCEPT, nullptr};
+  ProxyOp cancel_op{PROXY_CANCEL, nullptr};
+  // Flows whose first chunk is not due yet, earliest first.
+  std::priority_queue<std::pair<uint64_t, Flow*>,
+                      std::vector<std::pair<uint64_t, Flow*>>,
+                      std::greater<>>
+      timers;
+  std::vector<std::unique_ptr<uint8_t[]>> free_buffers;
+  std::mt19937_64 random;
+  std::uniform_real_distribution<double> percent{0, 100};
+  // Reset at every report.
+  size_t links = 0;
+  size_t bytes_up = 0;
+  size_t bytes_down = 0;
+  size_t lost = 0;
+  size_t resets = 0;
+};
+
+std::unique_ptr<uint8_t[]> take_buffer(Proxy& proxy) {
+  if (proxy.free_buffers.empty()) {
+    return std::make_unique<uint8_t[]>(CHUNK_SIZE);
+  }
+  auto buffer = std::move(proxy.free_buffers.back());
+  proxy.free_buffers.pop_back();
+  return buffer;
+}
+
+void add_accept_request(Proxy& proxy) {
+  struct io_uring_sqe* sqe = get_sqe(proxy.ring);
+  io_uring_prep_accept(sqe, proxy.listen_fd, nullptr, nullptr, 0);
+  io_uring_sqe_set_data(sqe, &proxy.accept_op);
+}
+
+void add_connect_request(Proxy& proxy, Link* link) {
+  struct io_uring_sqe* sqe = get_sqe(proxy.ring);
+  io_uring_prep_connect(sqe, link->server_fd,
+                        reinterpret_cast<sockaddr*>(&proxy.target),
+                        proxy.target_length);
+  io_uring_sqe_set_data(sqe, &link->connect_op);
+  link->connect_in_flight = true;
+  link->refs++;
+}
+
+void add_recv_request(Proxy& proxy, Flow* flow) {
+  if (!flow->recv_buffer) {
+    flow->recv_buffer = take_buffer(proxy);
+  }
+  struct io_uring_sqe* sqe = get_sqe(proxy.ring);
+  io_uring_prep_recv(sqe, flow->from, flow->recv_buffer.get(), CHUNK_SIZE, 0);
+  io_uring_sqe_set_data(sqe, &flow->recv_op);
+  flow->recv_in_flight = true;
+  flow->link->refs++;
+}
+
+void add_cancel_request(Proxy& proxy, ProxyOp* op) {
+  struct io_uring_sqe* sqe = get_sqe(proxy.ring);
+  io_uring_prep_cancel(sqe, op, 0);
+  io_uring_sqe_set_data(sqe, &proxy.cancel_op);
+}
+
+// Frees the link once nothing refers to it any more. Closing the sockets
+// only now means a reset really goes out as one: SO_LINGER 0 takes effect on
+// the last close.
+void release_link(Proxy& proxy, Link* link) {
+  if (!link->closing || link->refs > 0) {
+    return;
+  }
+  close(link->client_fd);
+  close(link->server_fd);
+  for (Flow* flow : {&link->upstream, &link->downstream}) {
+    for (auto& chunk : flow->chunks) {
+      proxy.free_buffers.push_back(std::move(chunk.data));
+    }
+    if (flow->recv_buffer) {
+      proxy.free_buffers.push_back(std::move(flow->recv_buffer));
+    }
+  }
+  delete link;
+}
+
+void close_link(Proxy& proxy, Link* link, const bool reset) {
+  if (link->closing) {
+    return;
+  }
+  link->closing = true;
+  if (reset) {
+    const linger abort{1, 0};
+    setsockopt(link->client_fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    setsockopt(link->server_fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+  }
+  for (Flow* flow : {&link->upstream, &link->downstream}) {
+    if (flow->recv_in_flight) {
+      add_cancel_request(proxy, &flow->recv_op);
+    }
+    if (flow->send_in_flight) {
+      add_cancel_request(proxy, &flow->send_op);
+    }
+  }
+  if (link->connect_in_flight) {
+    add_cancel_request(proxy, &link->connect_op);
+  }
+  release_link(proxy, link);
+}
+
+// Sends the first chunk if it is due and nothing is being sent already.
+void try_send(Proxy& proxy, Flow* flow) {
+  if (flow->send_in_flight || flow->chunks.empty()) {
+    return;
+  }
+  const Chunk& chunk = flow->chunks.front();
+  if (chunk.due_ns > now_ns()) {
+    return;
+  }
+  struct io_uring_sqe* sqe = get_sqe(proxy.ring);
+  io_uring_prep_send(sqe, flow->to, chunk.data.get() + chunk.sent,
+                     chunk.length - chunk.sent, MSG_NOSIGNAL);
+  io_uring_sqe_set_data(sqe, &flow->send_op);
+  flow->send_in_flight = true;
+  flow->link->refs++;
+}
+
+// Passes an end of stream on once everything before it is delivered, and
+// closes the link when both directions are done.
+void finish_flow(Proxy& proxy, Flow* flow) {
+  if (!flow->eof || !flow->chunks.empty() || flow->shut_down) {
+    return;
+  }
+  shutdown(flow->to, SHUT_WR);
+  flow->shut_down = true;
+  Link* link = flow->link;
+  if (link->upstream.shut_down && link->downstream.shut_down) {
+    close_link(proxy, link, false);
+  }
+}
+
+// Queues what was just read with the time it may leave: after the bytes
+// ahead of it have passed the bandwidth limit, plus the one-way delay and
+// jitter, plus a retransmission timeout if it is lost. Chunks never
+// overtake each other, so a late one holds back everything behind it.
+void queue_chunk(Proxy& proxy, Flow* flow, const size_t length) {
+  const uint64_t now = now_ns();
+  uint64_t departure = std::max(now, flow->last_departure_ns);
+  if (Config::proxy_bandwidth_mbps > 0) {
+    departure += static_cast<uint64_t>(static_cast<double>(length) * 8000 /
+                                       Config::proxy_bandwidth_mbps);
+  }
+  flow->last_departure_ns = departure;
+  uint64_t due = departure + Config::proxy_delay_us * 1000;
+  if (Config::proxy_jitter_us > 0) {
+    due += static_cast<uint64_t>(proxy.percent(proxy.random) / 100 *
+                                 static_cast<double>(Config::proxy_jitter_us) *
+                                 1000);
+  }
+  if (Config::proxy_loss_percent > 0 &&
+      proxy.percent(proxy.random) < Config::proxy_loss_percent) {
+    due += Config::proxy_rto_us * 1000;
+    proxy.lost++;
+  }
+  due = std::max(due, flow->last_due_ns);
+  flow->last_due_ns = due;
+
+  flow->chunks.push_back({std::move(flow->recv_buffer), length, 0, due});
+  flow->queued_bytes += length;
+  if (due > now && flow->chunks.size() == 1) {
+    proxy.timers.emplace(due, flow);
+    flow->link->refs++;
+  }
+}
+
+// Reads on unless too much is waiting to go out in this direction; a
+// send completion resumes reading.
+void resume_recv(Proxy& proxy, Flow* flow) {
+  if (!flow->recv_in_flight && !flow->eof && !flow->link->closing &&
+      flow->queued_bytes < Config::proxy_buffer_bytes) {
+    add_recv_request(proxy, flow);
+  }
+}
+
+void handle_accept(Proxy& proxy, const int client_fd) {
+  add_accept_request(proxy);
+  if (client_fd < 0) {
+    spdlog::error("[proxy {}] accept failed: {}", proxy.index,
+                  strerror(-client_fd));
+    return;
+  }
+  const int server_fd = socket(proxy.target.ss_family, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    spdlog::error("[proxy {}] socket failed: {}", proxy.index,
+                  strerror(errno));
+    close(client_fd);
+    return;
+  }
+  configure_socket_to_not_fragment(client_fd);
+  configure_socket_to_not_fragment(server_fd);
+  add_connect_request(proxy, new Link(client_fd, server_fd));
+  proxy.links++;
+}
+
+void handle_connect(Proxy& proxy, Link* link, const int res) {
+  link->connect_in_flight = false;
+  link->refs--;
+  if (link->closing) {
+    release_link(proxy, link);
+    return;
+  }
+  if (res < 0) {
+    spdlog::error("[proxy {}] Cannot reach {}:{}: {}", proxy.index,
+                  Config::host, Config::port, strerror(-res));
+    close_link(proxy, link, true);
+    return;
+  }
+  add_recv_request(proxy, &link->upstream);
+  add_recv_request(proxy, &link->downstream);
+}
+
+void handle_recv(Proxy& proxy, Flow* flow, const int res) {
+  Link* link = flow->link;
+  flow->recv_in_flight = false;
+  link->refs--;
+  if (link->closing) {
+    release_link(proxy, link);
+    return;
+  }
+  if (res < 0) {
+    close_link(proxy, link, true);
+    return;
+  }
+  if (res == 0) {
+    flow->eof = true;
+    finish_flow(proxy, flow);
+    return;
+  }
+  if (Config::proxy_reset_percent > 0 &&
+      proxy.percent(proxy.random) < Config::proxy_reset_percent) {
+    proxy.resets++;
+    close_link(proxy, link, true);
+    return;
+  }
+  queue_chunk(proxy, flow, static_cast<size_t>(res));
+  try_send(proxy, flow);
+  resume_recv(proxy, flow);
+}
+
+void handle_send(Proxy& proxy, Flow* flow, const int res) {
+  Link* link = flow->link;
+  flow->send_in_flight = false;
+  link->refs--;
+  if (link->closing) {
+    release_link(proxy, link);
+    return;
+  }
+  if (res <= 0) {
+    close_link(proxy, link, true);
+    return;
+  }
+  Chunk& chunk = flow->chunks.front();
+  chunk.sent += static_cast<size_t>(res);
+  (flow->upstream ? proxy.bytes_up : proxy.bytes_down) +=
+      static_cast<size_t>(res);
+  if (chunk.sent == chunk.length) {
+    flow->queued_bytes -= chunk.length;
+    proxy.free_buffers.push_back(std::move(chunk.data));
+    flow->chunks.pop_front();
+    // The next chunk may not be due yet.
+    if (!flow->chunks.empty() && flow->chunks.front().due_ns > now_ns()) {
+      proxy.timers.emplace(flow->chunks.front().due_ns, flow);
+      link->refs++;
+    }
+  }
+  try_send(proxy, flow);
+  resume_recv(proxy, flow);
+  finish_flow(proxy, flow);
+}
+
+void handle_cqe(Proxy& proxy, struct io_uring_cqe* cqe) {
+  auto* op = static_cast<ProxyOp*>(io_uring_cqe_get_data(cqe));
+  switch (op->type) {
+    case PROXY_ACCEPT:
+      handle_accept(proxy, cqe->res);
+      break;
+    case PROXY_CONNECT:
+      handle_connect(proxy, op->flow->link, cqe->res);
+      break;
+    case PROXY_RECV:
+      handle_recv(proxy, op->flow, cqe->res);
+      break;
+    case PROXY_SEND:
+      handle_send(proxy, op->flow, cqe->res);
+      break;
+    case PROXY_CANCEL:
+      break;
+  }
+}
+
+// Starts the sends whose time has come.
+void run_timers(Proxy& proxy) {
+  const uint64_t now = now_ns();
+  while (!proxy.timers.empty() && proxy.timers.top().first <= now) {
+    Flow* flow = proxy.timers.top().second;
+    proxy.timers.pop();
+    flow->link->refs--;
+    if (flow->link->closing) {
+      release_link(proxy, flow->link);
+    } else {
+      try_send(proxy, flow);
+    }
+  }
+}
+
+void report(Proxy& proxy, std::chrono::steady_clock::time_point& last_report) {
+  const auto now = std::chrono::steady_clock::now();
+  const double wall =
+      std::chrono::duration<double>(now - last_report).count();
+  spdlog::info(
+      "[proxy {}] {} new links, up {:.2f} Gb/s, down {:.2f} Gb/s, "
+      "lost chunks {}, resets {}",
+      proxy.index, proxy.links,
+      static_cast<double>(proxy.bytes_up) * 8 / wall / 1e9,
+      static_cast<double>(proxy.bytes_down) * 8 / wall / 1e9, proxy.lost,
+      proxy.resets);
+  last_report = now;
+  proxy.links = 0;
+  proxy.bytes_up = 0;
+  proxy.bytes_down = 0;
+  proxy.lost = 0;
+  proxy.resets = 0;
+}
+
+void run_proxy(const size_t index, const int listen_fd,
+               const sockaddr_storage& target, const socklen_t target_length) {
+  Proxy proxy(index, listen_fd, target, target_length);
+  setup_io_uring(proxy.ring);
+  add_accept_request(proxy);
+  io_uring_submit(&proxy.ring);
+
+  constexpr auto REPORT_INTERVAL = std::chrono::seconds(5);
+  auto last_report = std::chrono::steady_clock::now();
+  while (true) {
+    if (std::chrono::steady_clock::now() - last_report >= REPORT_INTERVAL &&
+        proxy.bytes_up + proxy.bytes_down > 0) {
+      report(proxy, last_report);
+    }
+
+    // Wake up for the earliest chunk that falls due, or once a second.
+    struct __kernel_timespec wait_timeout {};
+    wait_timeout.tv_sec = 1;
+    if (!proxy.timers.empty()) {
+      const uint64_t now = now_ns();
+      const uint64_t due = proxy.timers.top().first;
+      const uint64_t wait_ns =
+          due > now ? std::min<uint64_t>(due - now, 1000000000) : 0;
+      wait_timeout.tv_sec = static_cast<long long>(wait_ns / 1000000000);
+      wait_timeout.tv_nsec = static_cast<long long>(wait_ns % 1000000000);
+    }
+    struct io_uring_cqe* cqe;
+    int r = wait_timeout.tv_sec == 0 && wait_timeout.tv_nsec == 0
+                ? io_uring_peek_cqe(&proxy.ring, &cqe)
+                : io_uring_wait_cqe_timeout(&proxy.ring, &cqe, &wait_timeout);
+    if (r < 0 && r != -EAGAIN && r != -ETIME && r != -EINTR) {
+      spdlog::critical("[proxy {}] io_uring_wait_cqe failed: {}", index,
+                       strerror(-r));
+      break;
+    }
+
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&proxy.ring, head, cqe) {
+      handle_cqe(proxy, cqe);
+      count++;
+    }
+    io_uring_cq_advance(&proxy.ring, count);
+    run_timers(proxy);
+    io_uring_submit(&proxy.ring);
+  }
+  io_uring_queue_exit(&proxy.ring);
+}
+
+int main() {
+  Config::load_config();
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  const std::string port = std::to_string(Config::port);
+  const int r =
+      getaddrinfo(Config::host.c_str(), port.c_str(), &hints, &result);
+  if (r != 0 || result == nullptr) {
+    spdlog::critical("Cannot resolve {}: {}", Config::host, gai_strerror(r));
+    return EXIT_FAILURE;
+  }
+  sockaddr_storage target{};
+  const socklen_t target_length = result->ai_addrlen;
+  memcpy(&target, result->ai_addr, result->ai_addrlen);
+  freeaddrinfo(result);
+
+  spdlog::info(
+      "Proxying port {} to {}:{}, delay {} us, jitter {} us, bandwidth {} "
+      "Mb/s, loss {}%, RTO {} us, resets {}%",
+      Config::proxy_port, Config::host, Config::port, Config::proxy_delay_us,
+      Config::proxy_jitter_us, Config::proxy_bandwidth_mbps,
+      Config::proxy_loss_percent, Config::proxy_rto_us,
+      Config::proxy_reset_percent);
+
+  std::vector<std::thread> proxies;
+  for (size_t i = 0; i < Config::proxy_threads; ++i) {
+    const int listen_fd =
+        create_listen_socket(static_cast<in_port_t>(Config::proxy_port));
+    proxies.emplace_back(run_proxy, i, listen_fd, std::cref(target),
+                         target_length);
+  }
+  spdlog::info("Proxy started.");
+  for (auto& proxy : proxies) {
+    proxy.join();
+  }
+  return 0;
+}
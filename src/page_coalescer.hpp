@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "connection.hpp"
+
+struct PageWaiter {
+  Connection* conn;
+  uint32_t request_id;
+};
+
+// Collects page fetches from every connection of a reactor so that identical
+// pages requested within one window are looked up only once and the result is
+// fanned out to all waiters.
+class PageCoalescer {
+ public:
+  void add(const uint32_t page_number, Connection* conn,
+           const uint32_t request_id) {
+    auto& waiters = pending[page_number];
+    if (waiters.empty()) {
+      order.push_back(page_number);
+    }
+    waiters.push_back({conn, request_id});
+    conn->waiters++;
+    requests++;
+  }
+
+  [[nodiscard]] bool empty() const { return order.empty(); }
+
+  // Calls `fetch(page_number)` once per distinct page and
+  // `deliver(waiter, page_number, content)` for every waiter of that page.
+  template <typename Fetch, typename Deliver>
+  void flush(Fetch&& fetch, Deliver&& deliver) {
+    for (const uint32_t page_number : order) {
+      auto it = pending.find(page_number);
+      const auto content = fetch(page_number);
+      lookups++;
+      for (const auto& waiter : it->second) {
+        waiter.conn->waiters--;
+        deliver(waiter, page_number, content);
+      }
+      it->second.clear();
+    }
+    order.clear();
+    if (pending.size() > MAX_IDLE_ENTRIES) {
+      pending.clear();
+    }
+  }
+
+  size_t requests = 0;
+  size_t lookups = 0;
+
+ private:
+  static constexpr size_t MAX_IDLE_ENTRIES = 64 * 1024;
+
+  // Waiter vectors are kept around between windows to avoid reallocating
+  // them for hot pages.
+  std::unordered_map<uint32_t, std::vector<PageWaiter>> pending;
+  std::vector<uint32_t> order;
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Small LZ77 codec producing the LZ4 block format. Pages are compressed once
+// when they enter the page store and sent as-is, so only decompression sits
+// on a hot path.
+namespace page_codec {
+
+constexpr size_t MIN_MATCH = 4;
+// The last match must start at least this many bytes before the end of the
+// input and the last bytes are always literals, as in LZ4.
+constexpr size_t MF_LIMIT = 12;
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t HASH_LOG = 12;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr size_t WILD_COPY = 16;
+
+constexpr size_t max_compressed_size(const size_t input_size) {
+  return input_size + input_size / 255 + 16;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t hash4(const uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+inline uint8_t* write_length(uint8_t* out, size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = static_cast<uint8_t>(length);
+  return out;
+}
+
+// Compresses `input` into `out` and returns the compressed size. `out` must
+// hold at least max_compressed_size(input_size) bytes.
+inline size_t compress(const uint8_t* input, const size_t input_size,
+                       uint8_t* out) {
+  uint16_t table[1 << HASH_LOG];
+  memset(table, 0, sizeof(table));
+
+  const uint8_t* const out_start = out;
+  const uint8_t* anchor = input;
+  const uint8_t* ip = input;
+  const uint8_t* const input_end = input + input_size;
+  const uint8_t* const match_limit =
+      input_size > MF_LIMIT ? input_end - MF_LIMIT : input;
+
+  // Positions are stored relative to input + 1 so that 0 means "empty".
+  while (ip < match_limit && input_size <= MAX_OFFSET) {
+    const uint32_t sequence = read32(ip);
+    const uint32_t h = hash4(sequence);
+    const uint8_t* candidate = table[h] == 0 ? nullptr : input + table[h] - 1;
+    table[h] = static_cast<uint16_t>(ip - input + 1);
+
+    if (candidate == nullptr || read32(candidate) != sequence) {
+      ip++;
+      continue;
+    }
+
+    const uint8_t* match_end = ip + MIN_MATCH;
+    const uint8_t* candidate_end = candidate + MIN_MATCH;
+    while (match_end < input_end - LAST_LITERALS &&
+           *match_end == *candidate_end) {
+      match_end++;
+      candidate_end++;
+    }
+
+    const size_t literal_length = ip - anchor;
+    const size_t match_length = match_end - ip - MIN_MATCH;
+    uint8_t* token = out++;
+    *token = static_cast<uint8_t>(
+        (literal_length >= 15 ? 15 : literal_length) << 4 |
+        (match_length >= 15 ? 15 : match_length));
+    if (literal_length >= 15) {
+      out = write_length(out, literal_length - 15);
+    }
+    memcpy(out, anchor, literal_length);
+    out += literal_length;
+
+    const auto offset = static_cast<uint16_t>(ip - candidate);
+    *out++ = static_cast<uint8_t>(offset);
+    *out++ = static_cast<uint8_t>(offset >> 8);
+    if (match_length >= 15) {
+      out = write_length(out, match_length - 15);
+    }
+
+    ip = match_end;
+    anchor = ip;
+  }
+
+  const size_t literal_length = input_end - anchor;
+  *out++ = static_cast<uint8_t>((literal_length >= 15 ? 15 : literal_length)
+                                << 4);
+  if (literal_length >= 15) {
+    out = write_length(out, literal_length - 15);
+  }
+  memcpy(out, anchor, literal_length);
+  out += literal_length;
+  return out - out_start;
+}
+
+// Copies in 16-byte steps; may write up to WILD_COPY - 1 bytes past `end`.
+inline void wild_copy(uint8_t* out, const uint8_t* in, uint8_t* const end) {
+  do {
+    memcpy(out, in, WILD_COPY);
+    out += WILD_COPY;
+    in += WILD_COPY;
+  } while (out < end);
+}
+
+inline bool read_length(const uint8_t*& ip, const uint8_t* const input_end,
+                        size_t& length) {
+  uint8_t byte;
+  do {
+    if (ip >= input_end) {
+      return false;
+    }
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// Decompresses a block into exactly `output_size` bytes. Returns false if the
+// input is malformed or does not decode to `output_size` bytes. Long runs are
+// copied 16 bytes at a time while there is room, the tail byte by byte, so
+// `out` needs no slack.
+inline bool decompress(const uint8_t* input, const size_t input_size,
+                       uint8_t* out, const size_t output_size) {
+  const uint8_t* ip = input;
+  const uint8_t* const input_end = input + input_size;
+  uint8_t* op = out;
+  uint8_t* const output_end = out + output_size;
+
+  while (ip < input_end) {
+    const uint8_t token = *ip++;
+
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !read_length(ip, input_end, literal_length)) {
+      return false;
+    }
+    if (literal_length > static_cast<size_t>(input_end - ip) ||
+        literal_length > static_cast<size_t>(output_end - op)) {
+      return false;
+    }
+    if (op + literal_length + WILD_COPY <= output_end &&
+        ip + literal_length + WILD_COPY <= input_end) {
+      wild_copy(op, ip, op + literal_length);
+    } else {
+      memcpy(op, ip, literal_length);
+    }
+    op += literal_length;
+    ip += literal_length;
+
+    if (ip == input_end) {
+      break;
+    }
+
+    if (input_end - ip < 2) {
+      return false;
+    }
+    const size_t offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > static_cast<size_t>(op - out)) {
+      return false;
+    }
+
+    size_t match_length = token & 15;
+    if (match_length == 15 && !read_length(ip, input_end, match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (match_length > static_cast<size_t>(output_end - op)) {
+      return false;
+    }
+
+    const uint8_t* match = op - offset;
+    if (offset >= WILD_COPY && op + match_length + WILD_COPY <= output_end) {
+      wild_copy(op, match, op + match_length);
+      op += match_length;
+    } else {
+      // Overlapping matches replicate a short pattern, copy byte by byte.
+      for (size_t i = 0; i < match_length; ++i) {
+        *op++ = *match++;
+      }
+    }
+  }
+
+  return op == output_end;
+}
+
+}  // namespace page_codec
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#include "huge_pages.hpp"
+
+// Ids of the synthetic sparse store: increasing, so they double as a sorted
+// snapshot index, and spread over the 64-bit space with 20 bits of per-slot
+// noise so that neighbouring slots share no structure.
+inline uint64_t sparse_page_id(const uint64_t slot) {
+  uint64_t z = slot + 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return (slot << 20) | ((z ^ (z >> 31)) & 0xFFFFF);
+}
+
+// Maps 64-bit page ids to store slots. Flat open addressing over groups of
+// eight keys that fill one cache line; a lookup hashes to a group, compares
+// all eight keys at once and only moves on to the next group if the group is
+// full without a match. At the load factor used here almost every lookup
+// touches one key line and one value line, however many pages there are.
+// Built once; the key space of a store does not change at run time.
+class PageIndex {
+ public:
+  static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+  static constexpr size_t GROUP_SIZE = 8;
+
+  PageIndex(const uint64_t* ids, const size_t count) {
+    if (count >= NOT_FOUND) {
+      throw std::runtime_error("too many pages for 32-bit slots");
+    }
+    // At most half full, rounded up to a power of two groups.
+    size_t groups = 2;
+    while (groups * GROUP_SIZE < 2 * count) {
+      groups <<= 1;
+    }
+    group_mask = groups - 1;
+    shift = 64;
+    for (size_t g = groups; g > 1; g >>= 1) {
+      shift--;
+    }
+    keys = HugePageBuffer(groups * sizeof(Group));
+    values = HugePageBuffer(groups * GROUP_SIZE * sizeof(uint32_t));
+    memset(keys.data(), 0xFF, keys.size());
+
+    for (size_t slot = 0; slot < count; ++slot) {
+      insert(ids[slot], static_cast<uint32_t>(slot));
+    }
+  }
+
+  [[nodiscard]] uint32_t find(const uint64_t id) const {
+    // EMPTY marks free keys; probing for it would match one of them.
+    if (id == EMPTY) {
+      return NOT_FOUND;
+    }
+    size_t g = group_of(id);
+    // The value line is fetched in parallel with the key line it belongs to.
+    __builtin_prefetch(values.data() + g * GROUP_SIZE * sizeof(uint32_t));
+    for (;; g = (g + 1) & group_mask) {
+      const Group& group = this->group(g);
+      const unsigned matches = match(group, id);
+      if (matches != 0) {
+        return value(g, __builtin_ctz(matches));
+      }
+      if (match(group, EMPTY) != 0) {
+        return NOT_FOUND;
+      }
+    }
+  }
+
+  [[nodiscard]] size_t memory_bytes() const {
+    return keys.size() + values.size();
+  }
+
+  [[nodiscard]] HugePageMode memory_mode() const { return keys.mode(); }
+
+  static constexpr uint64_t EMPTY = UINT64_MAX;
+
+ private:
+  struct alignas(64) Group {
+    uint64_t keys[GROUP_SIZE];
+  };
+
+  // Bit i is set if key i of the group equals `id`.
+  static unsigned match(const Group& group, const uint64_t id) {
+#if defined(__x86_64__)
+    // SSE2 has no 64-bit compare: compare 32-bit halves, then require both
+    // halves of a lane to match.
+    const __m128i needle = _mm_set1_epi64x(static_cast<long long>(id));
+    unsigned mask = 0;
+    for (size_t i = 0; i < GROUP_SIZE; i += 2) {
+      const __m128i lanes = _mm_load_si128(
+          reinterpret_cast<const __m128i*>(group.keys + i));
+      const __m128i halves = _mm_cmpeq_epi32(lanes, needle);
+      const __m128i both =
+          _mm_and_si128(halves, _mm_shuffle_epi32(halves, 0xB1));
+      mask |= static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(both)))
+              << i;
+    }
+    return mask;
+#else
+    unsigned mask = 0;
+    for (size_t i = 0; i < GROUP_SIZE; ++i) {
+      mask |= static_cast<unsigned>(group.keys[i] == id) << i;
+    }
+    return mask;
+#endif
+  }
+
+  [[nodiscard]] size_t group_of(const uint64_t id) const {
+    return (id * 0x9E3779B97F4A7C15ull) >> shift & group_mask;
+  }
+
+  [[nodiscard]] const Group& group(const size_t g) const {
+    return reinterpret_cast<const Group*>(keys.data())[g];
+  }
+
+  [[nodiscard]] uint32_t value(const size_t g, const size_t i) const {
+    return reinterpret_cast<const uint32_t*>(values.data())[g * GROUP_SIZE + i];
+  }
+
+  void insert(const uint64_t id, const uint32_t slot) {
+    if (id == EMPTY) {
+      throw std::runtime_error("page id reserved for empty entries");
+    }
+    auto* groups = reinterpret_cast<Group*>(keys.data());
+    auto* slots = reinterpret_cast<uint32_t*>(values.data());
+    for (size_t g = group_of(id);; g = (g + 1) & group_mask) {
+      if (match(groups[g], id) != 0) {
+        throw std::runtime_error("duplicate page id");
+      }
+      const unsigned empty = match(groups[g], EMPTY);
+      if (empty != 0) {
+        const int i = __builtin_ctz(empty);
+        groups[g].keys[i] = id;
+        slots[g * GROUP_SIZE + i] = slot;
+        return;
+      }
+    }
+  }
+
+  HugePageBuffer keys;
+  HugePageBuffer values;
+  size_t group_mask;
+  int shift;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "crc32c.hpp"
+#include "epoch_reclaimer.hpp"
+#include "memory_block.hpp"
+#include "page_codec.hpp"
+
+// One immutable version of a page. Readers send straight from `data`, so a
+// version is never modified after it is published; updates publish a new one.
+struct PageVersion {
+  uint32_t version;
+  const uint8_t* data;
+  std::unique_ptr<uint8_t[]> owned;
+  // page_codec block of `data`, only kept if it is smaller than the page.
+  std::unique_ptr<uint8_t[]> compressed;
+  uint32_t compressed_length = 0;
+  // CRC32C of `data`, only computed if the store keeps checksums.
+  uint32_t checksum = 0;
+};
+
+struct PageStoreOptions {
+  // Keep a page_codec block of every page that compresses.
+  bool compress = false;
+  // Precompute a CRC32C of every page.
+  bool checksums = false;
+};
+
+// Versioned view over a MemoryBlock that supports in-place updates while
+// reactors keep serving reads without locks (RCU-style). Untouched pages keep
+// pointing into the MemoryBlock; every PutPage swaps in a fresh copy and the
+// replaced version is reclaimed once no in-flight send can reference it.
+// Initial pages of a lazy MemoryBlock are materialized by the first get(),
+// unless compression or checksums need all of them up front.
+template <size_t PageSize>
+class PageStore {
+ public:
+  static constexpr uint32_t INITIAL_VERSION = 1;
+
+  PageStore(const MemoryBlock<PageSize>& memory_block,
+            const size_t reactor_count, const PageStoreOptions options = {})
+      : initial(memory_block.page_count()),
+        slots(memory_block.page_count()),
+        reclaimer(reactor_count),
+        options(options) {
+    const bool eager = options.compress || options.checksums;
+    if (memory_block.lazy() && !eager) {
+      lazy_pages = &memory_block;
+    }
+    for (size_t i = 0; i < initial.size(); ++i) {
+      initial[i].version = INITIAL_VERSION;
+      initial[i].data = memory_block.page(i);
+      if (eager) {
+        memory_block.materialize(i);
+      }
+      prepare_version(initial[i], memory_block.checksums != nullptr
+                                      ? &memory_block.checksums[i]
+                                      : nullptr);
+      compressed_bytes += initial[i].compressed_length > 0
+                              ? initial[i].compressed_length
+                              : PageSize;
+      slots[i].store(&initial[i], std::memory_order_relaxed);
+    }
+  }
+
+  ~PageStore() {
+    for (auto& slot : slots) {
+      const PageVersion* current = slot.load();
+      if (current->owned) {
+        delete current;
+      }
+    }
+  }
+
+  [[nodiscard]] size_t page_count() const { return slots.size(); }
+
+  // The caller must have entered an epoch on its participant.
+  [[nodiscard]] const PageVersion* get(const size_t page_number) const {
+    const PageVersion* current =
+        slots[page_number].load(std::memory_order_acquire);
+    if (lazy_pages != nullptr && current == &initial[page_number]) {
+      lazy_pages->materialize(page_number);
+    }
+    return current;
+  }
+
+  // Publishes a new version of the page and returns its version number.
+  uint32_t put(const size_t page_number, const uint8_t* content,
+               EpochReclaimer::Participant& participant) {
+    PageVersion* next = copy_version(content);
+    const PageVersion* current = slots[page_number].load();
+    do {
+      next->version = current->version + 1;
+    } while (!slots[page_number].compare_exchange_weak(current, next));
+
+    if (current->owned) {
+      participant.retire([current] { delete current; });
+    }
+    return next->version;
+  }
+
+  // Publishes `content` as `version` of the page unless the page is already
+  // at that version or newer, and returns the version current afterwards.
+  // Replicas apply a primary's updates with it, which may arrive out of order.
+  uint32_t put_version(const size_t page_number, const uint8_t* content,
+                       const uint32_t version,
+                       EpochReclaimer::Participant& participant) {
+    const PageVersion* current = slots[page_number].load();
+    if (current->version >= version) {
+      return current->version;
+    }
+    PageVersion* next = copy_version(content);
+    next->version = version;
+    do {
+      if (current->version >= version) {
+        delete next;
+        return current->version;
+      }
+    } while (!slots[page_number].compare_exchange_weak(current, next));
+
+    if (current->owned) {
+      participant.retire([current] { delete current; });
+    }
+    return version;
+  }
+
+  EpochReclaimer::Participant& participant(const size_t reactor_index) {
+    return reclaimer.participant(reactor_index);
+  }
+
+  // Bytes needed to send every initial page in its smallest form.
+  size_t compressed_bytes = 0;
+
+ private:
+  PageVersion* copy_version(const uint8_t* content) const {
+    auto* next = new PageVersion{
+        0, nullptr, std::unique_ptr<uint8_t[]>(new uint8_t[PageSize])};
+    memcpy(next->owned.get(), content, PageSize);
+    next->data = next->owned.get();
+    prepare_version(*next);
+    return next;
+  }
+
+  // `known_checksum` comes with pages loaded from a snapshot.
+  void prepare_version(PageVersion& page,
+                       const uint32_t* known_checksum = nullptr) const {
+    if (options.compress) {
+      compress_version(page);
+    }
+    if (options.checksums) {
+      page.checksum = known_checksum != nullptr
+                          ? *known_checksum
+                          : crc32c(page.data, PageSize);
+    }
+  }
+
+  static void compress_version(PageVersion& page) {
+    uint8_t buffer[page_codec::max_compressed_size(PageSize)];
+    const size_t length = page_codec::compress(page.data, PageSize, buffer);
+    if (length >= PageSize) {
+      return;
+    }
+    page.compressed = std::unique_ptr<uint8_t[]>(new uint8_t[length]);
+    memcpy(page.compressed.get(), buffer, length);
+    page.compressed_length = static_cast<uint32_t>(length);
+  }
+
+  std::vector<PageVersion> initial;
+  std::vector<std::atomic<const PageVersion*>> slots;
+  EpochReclaimer reclaimer;
+  PageStoreOptions options;
+  const MemoryBlock<PageSize>* lazy_pages = nullptr;
+};
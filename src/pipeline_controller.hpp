@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Picks how many requests a connection keeps in flight from the round-trip
+// times it observes, instead of a fixed window. Decisions are made once per
+// round, i.e. after as many completions as the depth was when the round
+// started, so the controller reacts within a few RTTs whatever the depth.
+//
+// With a latency SLO it is AIMD: a round in which more than a tenth of the
+// requests took longer than the SLO multiplies the depth by BACKOFF,
+// otherwise it grows by one. The 90th percentile therefore hovers around the
+// SLO. Without an SLO it follows the RTT gradient: the depth is scaled by
+// RTT_TOLERANCE * lowest RTT / RTT of the round, capped at 1, plus sqrt(depth)
+// of headroom to keep probing. The depth grows while more in flight costs
+// little latency and settles where requests start queueing, which is where
+// throughput levels off.
+class PipelineController {
+ public:
+  static constexpr double BACKOFF = 0.7;
+  static constexpr double SMOOTHING = 0.2;
+  // Queueing delay accepted on top of the lowest RTT seen, as a factor.
+  static constexpr double RTT_TOLERANCE = 1.5;
+  // Every this many rounds the depth drops to the minimum for one round to
+  // relearn the unloaded RTT, in case the path got slower.
+  static constexpr size_t MIN_RTT_ROUNDS = 1000;
+  static constexpr uint64_t TRACE_INTERVAL_NS = 1000000;
+
+  PipelineController(const size_t initial, const size_t min_depth,
+                     const size_t max_depth, const uint64_t slo_ns)
+      : min_depth(std::max<size_t>(min_depth, 1)),
+        max_depth(std::max(max_depth, this->min_depth)),
+        slo_ns(slo_ns),
+        limit(static_cast<double>(
+            std::clamp(initial, this->min_depth, this->max_depth))),
+        current(static_cast<size_t>(limit)) {}
+
+  [[nodiscard]] size_t depth() const { return current; }
+
+  // The depth outside probe rounds.
+  [[nodiscard]] size_t settled_depth() const {
+    return static_cast<size_t>(limit);
+  }
+
+  void on_completion(const uint64_t rtt_ns, const uint64_t now) {
+    // Requests sent before a probe started still carry the old queueing.
+    if (probe_drain > 0) {
+      probe_drain--;
+      return;
+    }
+    round_rtt_ns += rtt_ns;
+    round_over_slo += slo_ns > 0 && rtt_ns > slo_ns;
+    if (++round_samples < current) {
+      return;
+    }
+    const double rtt =
+        static_cast<double>(round_rtt_ns) / static_cast<double>(round_samples);
+    if (probing) {
+      min_rtt = rtt;
+      probing = false;
+    } else if (slo_ns > 0) {
+      if (round_over_slo * 10 > round_samples) {
+        limit *= BACKOFF;
+      } else {
+        limit += 1;
+      }
+    } else {
+      if (min_rtt == 0 || rtt < min_rtt) {
+        min_rtt = rtt;
+      }
+      const double gradient =
+          std::clamp(RTT_TOLERANCE * min_rtt / rtt, 0.5, 1.0);
+      const double target = limit * gradient + std::sqrt(limit);
+      limit = (1 - SMOOTHING) * limit + SMOOTHING * target;
+    }
+    limit = std::clamp(limit, static_cast<double>(min_depth),
+                       static_cast<double>(max_depth));
+    current = static_cast<size_t>(limit);
+    rounds++;
+    round_samples = 0;
+    round_rtt_ns = 0;
+    round_over_slo = 0;
+    if (slo_ns == 0 && rounds % MIN_RTT_ROUNDS == 0) {
+      probing = true;
+      probe_drain = current;
+      current = min_depth;
+    }
+
+    if (trace.empty() || now - trace.back().first >= TRACE_INTERVAL_NS) {
+      trace.emplace_back(now, static_cast<size_t>(limit));
+    }
+  }
+
+  // Time from `start_ns` until the depth last left the band of +-20% around
+  // where it ended up. Probe rounds do not count.
+  [[nodiscard]] uint64_t convergence_ns(const uint64_t start_ns) const {
+    const auto final_depth = static_cast<size_t>(limit);
+    uint64_t converged = start_ns;
+    for (const auto& [time, depth] : trace) {
+      if (depth * 5 < final_depth * 4 || depth * 5 > final_depth * 6) {
+        converged = time;
+      }
+    }
+    return converged - start_ns;
+  }
+
+  [[nodiscard]] size_t round_count() const { return rounds; }
+
+ private:
+  size_t min_depth;
+  size_t max_depth;
+  uint64_t slo_ns;
+  double limit;
+  size_t current;
+  double min_rtt = 0;
+  size_t round_samples = 0;
+  uint64_t round_rtt_ns = 0;
+  size_t round_over_slo = 0;
+  size_t rounds = 0;
+  bool probing = false;
+  size_t probe_drain = 0;
+  // Depth sampled at most every TRACE_INTERVAL_NS, to tell when it settled.
+  std::vector<std::pair<uint64_t, size_t>> trace;
+};
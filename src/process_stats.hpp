@@ -0,0 +1,99 @@
+#pragma once
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Resident set size of this process, 0 if /proc is not available.
+inline size_t resident_bytes() {
+  std::ifstream file("/proc/self/statm");
+  size_t total_pages = 0;
+  size_t resident_pages = 0;
+  if (!(file >> total_pages >> resident_pages)) {
+    return 0;
+  }
+  return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Memory the kernel holds for the buffers of all TCP sockets on the machine,
+// from the "mem" field of the TCP line in /proc/net/sockstat. Socket buffers
+// are not part of any process's RSS.
+inline size_t tcp_buffer_bytes() {
+  std::ifstream file("/proc/net/sockstat");
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind("TCP:", 0) != 0) {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string name;
+    size_t value;
+    fields >> name;
+    while (fields >> name >> value) {
+      if (name == "mem") {
+        return value * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      }
+    }
+  }
+  return 0;
+}
+
+// Lifts the soft open-file limit to the hard limit; tens of thousands of
+// sockets do not fit the usual default of 1024.
+inline void raise_fd_limit() {
+  rlimit limit{};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+// Tracks how much memory the server's connections cost: RSS above the
+// baseline taken before the first accept, per open connection, at the moment
+// the most connections were open.
+class ConnectionMemoryReport {
+ public:
+  ConnectionMemoryReport()
+      : baseline_rss(resident_bytes()), baseline_tcp(tcp_buffer_bytes()) {}
+
+  void sample(const size_t open, const size_t closed) {
+    const size_t rss = above(resident_bytes(), baseline_rss);
+    const size_t tcp = above(tcp_buffer_bytes(), baseline_tcp);
+    std::cout << "Connections: open " << open << ", closed " << closed
+              << ", RSS " << rss << " bytes (" << per_connection(rss, open)
+              << " bytes per connection), TCP buffers " << tcp << " bytes"
+              << std::endl;
+    if (open > 0 && open >= peak_open) {
+      peak_open = open;
+      peak_rss = rss;
+      peak_tcp = tcp;
+    }
+  }
+
+  void print_peak() const {
+    std::cout << "Peak connections: " << peak_open << ", RSS per connection: "
+              << per_connection(peak_rss, peak_open)
+              << " bytes, TCP buffers per connection: "
+              << per_connection(peak_tcp, peak_open) << " bytes" << std::endl;
+  }
+
+ private:
+  static size_t above(const size_t value, const size_t baseline) {
+    return value > baseline ? value - baseline : 0;
+  }
+
+  static size_t per_connection(const size_t bytes, const size_t open) {
+    return open == 0 ? 0 : bytes / open;
+  }
+
+  size_t baseline_rss;
+  size_t baseline_tcp;
+  size_t peak_open = 0;
+  size_t peak_rss = 0;
+  size_t peak_tcp = 0;
+};
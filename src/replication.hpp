@@ -0,0 +1,113 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "connection.hpp"
+#include "latency_recorder.hpp"
+#include "models/get_page.hpp"
+#include "models/put_page.hpp"
+#include "spdlog/spdlog.h"
+
+struct ReplicaLink;
+
+struct ReplicaOp : custom_request {
+  ReplicaLink* link;
+};
+
+// One reactor's stream of page updates to one replica, over a connection the
+// replica serves like any client. Updates queue up as the reactor applies
+// them and leave in one send per loop iteration, without waiting for earlier
+// ones to be acknowledged. The replica acknowledges every update in order,
+// which gives the lag: from the primary applying an update to its
+// acknowledgement arriving back.
+struct ReplicaLink {
+  ReplicaLink(std::string name, const int fd) : name(std::move(name)), fd(fd) {}
+
+  ReplicaLink(const ReplicaLink&) = delete;
+  ReplicaLink& operator=(const ReplicaLink&) = delete;
+
+  ~ReplicaLink() { close(fd); }
+
+  void queue_update(const uint32_t page_number, const uint32_t version,
+                    const uint8_t* content, const uint64_t now) {
+    ReplicatePageRequest request;
+    request.header = {REPLICATE_PAGE, 0, 0, static_cast<uint32_t>(updates)};
+    request.page_number = page_number;
+    request.version = version;
+    memcpy(request.content.data(), content, PAGE_SIZE);
+    request.to_network_order();
+    const size_t offset = queued.size();
+    queued.resize(offset + sizeof(request));
+    memcpy(queued.data() + offset, &request, sizeof(request));
+    applied_ns.push_back(now);
+    updates++;
+  }
+
+  // Bytes of every update not yet acknowledged: queued, being sent, or
+  // waiting for the replica to apply it.
+  [[nodiscard]] size_t backlog_bytes() const {
+    return applied_ns.size() * sizeof(ReplicatePageRequest);
+  }
+
+  // Takes the updates queued so far for the next send. Returns false if
+  // there is nothing to send or a send is still in flight.
+  bool prepare_send() {
+    if (broken || send_in_flight || queued.empty()) {
+      return false;
+    }
+    out.swap(queued);
+    queued.clear();
+    out_sent = 0;
+    return true;
+  }
+
+  // Records the lag of every acknowledgement that has arrived in `in`.
+  void consume_acks(const uint64_t now) {
+    size_t offset = 0;
+    while (in_used - offset >= sizeof(GetPageResponseHeader)) {
+      GetPageResponseHeader header{};
+      memcpy(&header, in.data() + offset, sizeof(header));
+      header.to_host_order();
+      const size_t frame_size = sizeof(header) + header.content_length;
+      if (in_used - offset < frame_size) {
+        break;
+      }
+      if (header.status != SUCCESS) {
+        spdlog::error("Replica {} rejected page {} with status {}", name,
+                      header.page_number, header.status);
+      }
+      if (!applied_ns.empty()) {
+        lag.record(now - applied_ns.front());
+        applied_ns.pop_front();
+      }
+      offset += frame_size;
+    }
+    memmove(in.data(), in.data() + offset, in_used - offset);
+    in_used -= offset;
+  }
+
+  std::string name;
+  int fd;
+  ReplicaOp send_req{{REPLICA_SEND, nullptr}, this};
+  ReplicaOp ack_req{{REPLICA_ACK, nullptr}, this};
+  std::vector<uint8_t> queued;
+  std::vector<uint8_t> out;
+  size_t out_sent = 0;
+  bool send_in_flight = false;
+  std::vector<uint8_t> in = std::vector<uint8_t>(CONNECTION_BUFFER_SIZE);
+  size_t in_used = 0;
+  // Set once the connection failed; updates are no longer queued.
+  bool broken = false;
+  // When each unacknowledged update was applied, oldest first.
+  std::deque<uint64_t> applied_ns;
+  size_t updates = 0;
+  // Reset at every report.
+  LatencyRecorder lag;
+};
@@ -22,12 +22,13 @@ void handle_client(const int client_socket,
     }
     request.to_host_order();
 
-    spdlog::debug("[{}] Requested page number: {}", request.request_id,
+    spdlog::debug("[{}] Requested page number: {}", request.header.request_id,
                   request.page_number);
 
     GetPageResponse response{};
-    response.header.request_id = request.request_id;
+    response.header.request_id = request.header.request_id;
     response.header.page_number = request.page_number;
+    response.header.content_length = PAGE_SIZE;
 
     if (request.page_number >= Config::page_count) {
       spdlog::error("Invalid page number: {}", request.page_number);
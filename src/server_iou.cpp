@@ -1,170 +1,1620 @@
+#include <fcntl.h>
 #include <liburing.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "connection.hpp"
 #include "memory_block.hpp"
 #include "models/get_page.hpp"
+#include "models/put_page.hpp"
+#include "page_coalescer.hpp"
+#include "page_index.hpp"
+#include "page_store.hpp"
+#include "replication.hpp"
 #include "spdlog/spdlog.h"
 #include "static_config.hpp"
 #include "utils.hpp"
 #include "io_uring_utils.hpp"
+#include "ktls.hpp"
+#include "tcp_stats.hpp"
+#include "trace.hpp"
+#include "wait_strategy.hpp"
 
-struct custom_request {
-  int event_type;
-  struct iovec iov;
+// Records older than this are written out even if their chunk is not full.
+constexpr uint64_t TRACE_FLUSH_INTERVAL_NS = 1000000000;
+
+// A chunk of trace records, tagged for the completion of its write.
+struct TraceWrite : custom_request {
+  TraceWrite() : custom_request{TRACE_WRITE, nullptr} {}
+  TraceChunk chunk;
+};
+
+// Ring fds of all reactors, published before any of them starts serving.
+struct ReactorDirectory {
+  explicit ReactorDirectory(const size_t count) : ring_fds(count, -1) {}
+
+  std::vector<int> ring_fds;
+  std::atomic<size_t> ready{0};
+};
+
+// Runs the TLS handshakes of accepted connections off the reactors, on one
+// thread driving non-blocking sockets so a slow peer only holds up its own
+// handshake, which fails after TLS_HANDSHAKE_TIMEOUT_MS in total. A finished
+// kTLS socket goes back to the reactor that accepted it with
+// IORING_OP_MSG_RING: the fd arrives as the result of a TLS_READY completion.
+class TlsHandshaker {
+ public:
+  TlsHandshaker(const TlsContext& tls, const ReactorDirectory& directory)
+      : tls(tls),
+        directory(directory),
+        wake_efd(eventfd(0, EFD_CLOEXEC)) {
+    const int r = io_uring_queue_init(64, &ring, 0);
+    if (wake_efd < 0 || r < 0) {
+      throw std::runtime_error("cannot set up the TLS handshake thread");
+    }
+    std::thread([this] { run(); }).detach();
+  }
+
+  // Called by reactor `reactor`; the fd comes back on its ring tagged with
+  // `ready`.
+  void submit(const int fd, const size_t reactor, custom_request* ready) {
+    {
+      std::lock_guard lock(incoming_mutex);
+      incoming.push_back({fd, reactor, ready});
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] ssize_t r = write(wake_efd, &one, sizeof(one));
+  }
+
+ private:
+  struct Pending {
+    int fd;
+    size_t reactor;
+    custom_request* ready;
+    int flags = 0;
+    std::unique_ptr<TlsHandshake> handshake;
+    std::chrono::steady_clock::time_point deadline;
+    TlsStep step = TlsStep::WANT_READ;
+  };
+
+  void run() {
+    std::vector<Pending> active;
+    std::vector<pollfd> pfds;
+    while (true) {
+      take_incoming(active);
+      reap_failed_messages();
+
+      pfds.assign(1, {wake_efd, POLLIN, 0});
+      int timeout_ms = -1;
+      const auto now = std::chrono::steady_clock::now();
+      for (const auto& pending : active) {
+        pfds.push_back({pending.fd,
+                        static_cast<short>(pending.step == TlsStep::WANT_READ
+                                               ? POLLIN
+                                               : POLLOUT),
+                        0});
+        const auto left =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                pending.deadline - now)
+                .count() +
+            1;
+        if (timeout_ms < 0 || left < timeout_ms) {
+          timeout_ms = static_cast<int>(std::max<int64_t>(left, 0));
+        }
+      }
+      poll(pfds.data(), pfds.size(), timeout_ms);
+      if (pfds[0].revents != 0) {
+        uint64_t value;
+        [[maybe_unused]] ssize_t r = read(wake_efd, &value, sizeof(value));
+      }
+
+      const auto after = std::chrono::steady_clock::now();
+      size_t kept = 0;
+      for (size_t i = 0; i < active.size(); ++i) {
+        Pending& pending = active[i];
+        if (pfds[i + 1].revents != 0 && advance(pending)) {
+          continue;
+        }
+        if (after >= pending.deadline) {
+          fail(pending, "handshake timed out");
+          continue;
+        }
+        if (kept != i) {
+          active[kept] = std::move(pending);
+        }
+        kept++;
+      }
+      active.resize(kept);
+    }
+  }
+
+  void take_incoming(std::vector<Pending>& active) {
+    std::vector<Pending> taken;
+    {
+      std::lock_guard lock(incoming_mutex);
+      taken.swap(incoming);
+    }
+    for (auto& pending : taken) {
+      pending.flags = fcntl(pending.fd, F_GETFL);
+      fcntl(pending.fd, F_SETFL, pending.flags | O_NONBLOCK);
+      pending.handshake = tls.start(pending.fd);
+      pending.deadline = std::chrono::steady_clock::now() +
+                         std::chrono::milliseconds(TLS_HANDSHAKE_TIMEOUT_MS);
+      if (!advance(pending)) {
+        active.push_back(std::move(pending));
+      }
+    }
+  }
+
+  // Returns true once the handshake is over, either way.
+  bool advance(Pending& pending) {
+    std::string error;
+    pending.step = pending.handshake->step(error);
+    switch (pending.step) {
+      case TlsStep::WANT_READ:
+      case TlsStep::WANT_WRITE:
+        return false;
+      case TlsStep::FAILED:
+        fail(pending, error);
+        return true;
+      case TlsStep::DONE:
+        break;
+    }
+    fcntl(pending.fd, F_SETFL, pending.flags);
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    io_uring_prep_msg_ring(sqe, directory.ring_fds[pending.reactor],
+                           static_cast<unsigned>(pending.fd),
+                           reinterpret_cast<uint64_t>(pending.ready), 0);
+    // Only a failed message completes here, tagged with the fd to close.
+    io_uring_sqe_set_data64(sqe, static_cast<uint64_t>(pending.fd));
+    sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    io_uring_submit(&ring);
+    return true;
+  }
+
+  void fail(const Pending& pending, const std::string& error) {
+    spdlog::error("[reactor {}] TLS handshake failed: {}", pending.reactor,
+                  error);
+    close(pending.fd);
+  }
+
+  void reap_failed_messages() {
+    struct io_uring_cqe* cqe;
+    while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+      spdlog::error("Handing over a TLS connection failed: {}",
+                    strerror(-cqe->res));
+      close(static_cast<int>(cqe->user_data));
+      io_uring_cqe_seen(&ring, cqe);
+    }
+  }
+
+  const TlsContext& tls;
+  const ReactorDirectory& directory;
+  int wake_efd;
+  struct io_uring ring {};
+  std::mutex incoming_mutex;
+  std::vector<Pending> incoming;
 };
 
-enum EventType { READ, WRITE };
+struct Reactor {
+  size_t index;
+  int listen_fd;
+  PageStore<PAGE_SIZE>& store;
+  EpochReclaimer::Participant& epoch;
+  // Bytes of responses queued or being written, summed over all reactors.
+  std::atomic<size_t>& backlog_bytes;
+  // Null unless TLS is enabled.
+  TlsHandshaker* tls;
+  // Null for dense stores, where ids are page numbers.
+  const PageIndex* page_index;
+  // Null unless requests are traced.
+  TraceFile* trace_file;
+  ReactorDirectory& directory;
+  // With PARTITION_PAGES, reactor i owns pages [i * n, (i + 1) * n) and
+  // answers every request for them; 0 when pages are shared.
+  size_t pages_per_reactor;
+  struct io_uring ring {};
 
-void add_read_request(struct io_uring& ring, int client_socket) {
-  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
-  auto* req = new custom_request{READ};
-  req->iov.iov_base = malloc(sizeof(GetPageRequest));
-  req->iov.iov_len = sizeof(GetPageRequest);
+  custom_request accept_req{ACCEPT, nullptr};
+  custom_request tls_ready_req{TLS_READY, nullptr};
+  custom_request timeout_req{COALESCE_TIMEOUT, nullptr};
+  struct __kernel_timespec coalesce_window {};
+  bool timeout_armed = false;
 
-  io_uring_prep_readv(sqe, client_socket, &req->iov, 1, 0);
-  io_uring_sqe_set_data(sqe, req);
+  PageCoalescer coalescer;
+  std::vector<Connection*> dirty;
+  // Connections with buffered requests, in DRR order.
+  std::deque<Connection*> runnable;
+  uint32_t next_connection_id = 0;
+
+  // The chunk taking records, and chunks whose write has completed. Records
+  // of one loop iteration share the time its completions were reaped.
+  TraceWrite* trace_active = nullptr;
+  std::vector<TraceWrite*> trace_free;
+  std::vector<std::unique_ptr<TraceWrite>> trace_chunks;
+  uint64_t trace_now_ns = 0;
+  uint64_t trace_flushed_ns = 0;
+
+  WaitStrategy wait{parse_wait_mode(Config::wait_strategy),
+                    Config::max_spin_us * 1000};
+  size_t completions = 0;
+  size_t paused_reads = 0;
+  size_t overloaded = 0;
+  size_t forwarded = 0;
+  size_t expired = 0;
+  // Cleared for good once the socket type turns out not to support it.
+  bool stream_zerocopy;
+  // This reactor's update streams, one per replica in REPLICAS.
+  std::vector<std::unique_ptr<ReplicaLink>> replicas;
+
+  Reactor(const size_t index, const int listen_fd, PageStore<PAGE_SIZE>& store,
+          std::atomic<size_t>& backlog_bytes, TlsHandshaker* tls,
+          const PageIndex* page_index, TraceFile* trace_file,
+          ReactorDirectory& directory)
+      : index(index),
+        listen_fd(listen_fd),
+        store(store),
+        epoch(store.participant(index)),
+        backlog_bytes(backlog_bytes),
+        tls(tls),
+        page_index(page_index),
+        trace_file(trace_file),
+        directory(directory),
+        pages_per_reactor(
+            Config::partition_pages
+                ? (store.page_count() + directory.ring_fds.size() - 1) /
+                      directory.ring_fds.size()
+                : 0),
+        stream_zerocopy(Config::stream_zerocopy && tls == nullptr &&
+                        Config::unix_socket.empty()) {}
+};
+
+const std::array<uint8_t, PAGE_SIZE> invalid_page_content = [] {
+  std::array<uint8_t, PAGE_SIZE> content{};
+  content.fill(0xFA);
+  return content;
+}();
+
+uint32_t slot_for_id(const Reactor& reactor, const uint64_t page_id) {
+  if (reactor.page_index != nullptr) {
+    return reactor.page_index->find(page_id);
+  }
+  return page_id < reactor.store.page_count() ? static_cast<uint32_t>(page_id)
+                                              : PageIndex::NOT_FOUND;
 }
 
-void add_write_request(struct io_uring& ring, int client_socket,
-                       const iovec* iovs, int iov_count) {
-  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
-  auto* req = new custom_request{WRITE};
-  req->iov.iov_base = nullptr;
-  req->iov.iov_len = 0;
+const PageVersion* fetch_page(const Reactor& reactor,
+                              const uint32_t page_number) {
+  if (page_number >= reactor.store.page_count()) {
+    return nullptr;
+  }
+  return reactor.store.get(page_number);
+}
+
+void add_accept_request(Reactor& reactor) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  io_uring_prep_accept(sqe, reactor.listen_fd, nullptr, nullptr, 0);
+  io_uring_sqe_set_data(sqe, &reactor.accept_req);
+}
 
-  io_uring_prep_writev(sqe, client_socket, iovs, iov_count, 0);
-  io_uring_sqe_set_data(sqe, req);
-  io_uring_submit(&ring);
+void add_read_request(Reactor& reactor, Connection* conn) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  io_uring_prep_recv(sqe, conn->fd, conn->in.data() + conn->in_used,
+                     conn->in.size() - conn->in_used, 0);
+  io_uring_sqe_set_data(sqe, &conn->read_req);
+  conn->read_in_flight = true;
 }
 
-void event_loop(struct io_uring& ring, int client_socket,
-                const MemoryBlock<PAGE_SIZE>& memory_block) {
-  configure_socket_to_not_fragment(client_socket);
-  for (int i = 0; i < 64; i++) {
-    add_read_request(ring, client_socket);
+// Sends everything queued on the connection with one sendmsg. With MSG_MORE
+// the kernel holds back a partial segment while more responses are known to
+// follow: the rest of the batch beyond IOV_MAX, responses queued behind it,
+// or requests already buffered but not yet answered.
+void add_write_request(Reactor& reactor, Connection* conn) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  conn->msg.msg_iov = conn->iov.data() + conn->iov_offset;
+  conn->msg.msg_iovlen = conn->iov_count();
+  const bool more = conn->more_after_next_send() || !conn->pending.empty() ||
+                    has_complete_request(*conn);
+  const int flags = Config::msg_more && more ? MSG_MORE : 0;
+  io_uring_prep_sendmsg(sqe, conn->fd, &conn->msg, flags);
+  io_uring_sqe_set_data(sqe, &conn->write_req);
+  conn->write_in_flight = true;
+  conn->sends++;
+}
+
+TraceWrite* take_trace_chunk(Reactor& reactor) {
+  if (reactor.trace_free.empty()) {
+    reactor.trace_chunks.push_back(std::make_unique<TraceWrite>());
+    return reactor.trace_chunks.back().get();
   }
-  io_uring_submit(&ring);
+  TraceWrite* write = reactor.trace_free.back();
+  reactor.trace_free.pop_back();
+  return write;
+}
 
-  while (true) {
-    struct io_uring_cqe* cqe;
-    io_uring_wait_cqe(&ring, &cqe);
-    auto* req = (custom_request*)io_uring_cqe_get_data(cqe);
+void add_trace_write(Reactor& reactor, TraceWrite* write) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  io_uring_prep_write(sqe, reactor.trace_file->get_fd(),
+                      write->chunk.pending_data(),
+                      static_cast<unsigned>(write->chunk.pending_bytes()),
+                      write->chunk.pending_offset());
+  io_uring_sqe_set_data(sqe, write);
+}
 
-    switch (req->event_type) {
-      case READ: {
-        if (cqe->res == 0) {
-          spdlog::info("Client closed connection");
-          close(client_socket);
-          return;
+// Queues the write of the records gathered so far and starts a new chunk.
+void flush_trace(Reactor& reactor) {
+  reactor.trace_flushed_ns = reactor.trace_now_ns;
+  TraceWrite* write = reactor.trace_active;
+  if (write->chunk.empty()) {
+    return;
+  }
+  write->chunk.start_write(
+      reactor.trace_file->reserve(write->chunk.pending_bytes()));
+  add_trace_write(reactor, write);
+  reactor.trace_active = take_trace_chunk(reactor);
+}
+
+void add_replica_send(Reactor& reactor, ReplicaLink* link) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  io_uring_prep_send(sqe, link->fd, link->out.data() + link->out_sent,
+                     link->out.size() - link->out_sent, 0);
+  io_uring_sqe_set_data(sqe, &link->send_req);
+  link->send_in_flight = true;
+}
+
+void add_replica_ack_read(Reactor& reactor, ReplicaLink* link) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  io_uring_prep_recv(sqe, link->fd, link->in.data() + link->in_used,
+                     link->in.size() - link->in_used, 0);
+  io_uring_sqe_set_data(sqe, &link->ack_req);
+}
+
+// A replica that cannot be reached any more, or keeps up too slowly, falls
+// behind for good; the primary keeps serving without it.
+void fail_replica(Reactor& reactor, ReplicaLink* link, const int error) {
+  if (!link->broken) {
+    spdlog::error("[reactor {}] Replica {} failed: {}", reactor.index,
+                  link->name, strerror(error));
+    link->broken = true;
+    link->queued.clear();
+    shutdown(link->fd, SHUT_RDWR);
+  }
+}
+
+// Queues an update the reactor just applied on all its replica links.
+void replicate(Reactor& reactor, const uint32_t page_number,
+               const uint32_t version, const uint8_t* content) {
+  if (reactor.replicas.empty()) {
+    return;
+  }
+  const uint64_t now = now_ns();
+  for (auto& link : reactor.replicas) {
+    if (link->broken) {
+      continue;
+    }
+    // Updates are not buffered without limit for a replica that lags.
+    if (link->backlog_bytes() + sizeof(ReplicatePageRequest) >
+        Config::replica_backlog_bytes) {
+      spdlog::error("[reactor {}] Replica {} is {} updates behind",
+                    reactor.index, link->name, link->applied_ns.size());
+      fail_replica(reactor, link.get(), ENOBUFS);
+      continue;
+    }
+    link->queue_update(page_number, version, content, now);
+  }
+}
+
+void trace_request(Reactor& reactor, const Connection* conn,
+                   const RequestType type, const uint64_t page) {
+  if (reactor.trace_file == nullptr) {
+    return;
+  }
+  reactor.trace_active->chunk.append(
+      {reactor.trace_now_ns, page, conn->id,
+       static_cast<uint8_t>(reactor.index), static_cast<uint8_t>(type), 0});
+  if (reactor.trace_active->chunk.full()) {
+    flush_trace(reactor);
+  }
+}
+
+void release_if_done(Connection* conn) {
+  if (conn->can_release()) {
+    spdlog::debug("Releasing connection {}", conn->id);
+    close(conn->fd);
+    delete conn;
+  }
+}
+
+void mark_dirty(Reactor& reactor, Connection* conn) {
+  if (!conn->dirty) {
+    conn->dirty = true;
+    reactor.dirty.push_back(conn);
+  }
+}
+
+size_t outgoing_bytes(const OutgoingPage& page) {
+  return sizeof(page.header) + page.content_length;
+}
+
+// The shared backlog counter is only maintained when there is a budget.
+void push_outgoing(Reactor& reactor, Connection* conn,
+                   const OutgoingPage& page) {
+  if (Config::memory_budget_bytes > 0) {
+    reactor.backlog_bytes.fetch_add(outgoing_bytes(page),
+                                    std::memory_order_relaxed);
+  }
+  conn->pending.push_back(page);
+  mark_dirty(reactor, conn);
+}
+
+bool over_memory_budget(const Reactor& reactor, const size_t bytes) {
+  return Config::memory_budget_bytes > 0 &&
+         reactor.backlog_bytes.load(std::memory_order_relaxed) + bytes >
+             Config::memory_budget_bytes;
+}
+
+void queue_response(Reactor& reactor, Connection* conn,
+                    const uint32_t request_id, const uint32_t page_number,
+                    const PageVersion* content) {
+  if (conn->closed) {
+    return;
+  }
+  OutgoingPage page{};
+  page.header.request_id = request_id;
+  page.header.page_number = page_number;
+  page.header.content_length = PAGE_SIZE;
+  page.content_length = PAGE_SIZE;
+  if (over_memory_budget(reactor, sizeof(page.header) + PAGE_SIZE)) {
+    page.header.status = OVERLOADED;
+    page.header.content_length = 0;
+    page.content_length = 0;
+    reactor.overloaded++;
+  } else if (content == nullptr) {
+    spdlog::error("Invalid page number: {0:#x}", page_number);
+    page.header.status = INVALID_PAGE_NUMBER;
+    page.content = invalid_page_content.data();
+  } else {
+    page.header.status = SUCCESS;
+    page.header.version = content->version;
+    page.content = content->data;
+    if ((conn->features & FEATURE_COMPRESSION) && content->compressed) {
+      page.header.flags = RESPONSE_COMPRESSED;
+      page.header.content_length = content->compressed_length;
+      page.content = content->compressed.get();
+      page.content_length = content->compressed_length;
+    }
+    if (conn->features & FEATURE_CHECKSUM) {
+      page.header.flags |= RESPONSE_CHECKSUMMED;
+      page.header.checksum = content->checksum;
+    }
+    page.epoch = reactor.epoch.current_pin();
+    reactor.epoch.reference(page.epoch);
+    debug_print_array(const_cast<uint8_t*>(content->data), PAGE_SIZE);
+  }
+  page.header.to_network_order();
+  push_outgoing(reactor, conn, page);
+}
+
+// Answers a request whose deadline passed before it was handled, without
+// looking the page up.
+void queue_expired(Reactor& reactor, Connection* conn,
+                   const uint32_t request_id, const uint32_t page_number) {
+  if (conn->closed) {
+    return;
+  }
+  OutgoingPage page{};
+  page.header.request_id = request_id;
+  page.header.status = DEADLINE_EXCEEDED;
+  page.header.page_number = page_number;
+  page.header.to_network_order();
+  push_outgoing(reactor, conn, page);
+  reactor.expired++;
+}
+
+void release_outgoing(Reactor& reactor, std::vector<OutgoingPage>& pages) {
+  for (const auto& page : pages) {
+    if (Config::memory_budget_bytes > 0) {
+      reactor.backlog_bytes.fetch_sub(outgoing_bytes(page),
+                                      std::memory_order_relaxed);
+    }
+    if (page.epoch != 0) {
+      reactor.epoch.unreference(page.epoch);
+    }
+    delete page.forward;
+    delete page.stream;
+  }
+  pages.clear();
+}
+
+// Reactor owning `page_number`, or this one if pages are shared.
+size_t owner_of(const Reactor& reactor, const uint32_t page_number) {
+  if (reactor.pages_per_reactor == 0 ||
+      page_number >= reactor.store.page_count()) {
+    return reactor.index;
+  }
+  return page_number / reactor.pages_per_reactor;
+}
+
+void add_forward(Reactor& reactor, PageForward* forward,
+                 const size_t target) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  io_uring_prep_msg_ring(
+      sqe, reactor.directory.ring_fds[target], 0,
+      reinterpret_cast<uint64_t>(static_cast<custom_request*>(forward)), 0);
+  // Only a failed send completes on this ring.
+  io_uring_sqe_set_data(sqe, static_cast<custom_request*>(forward));
+  sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+}
+
+// Runs on the owner of the page; reading it here keeps it in this core's
+// caches.
+void answer_forward(Reactor& reactor, PageForward* forward) {
+  const PageVersion* content = fetch_page(reactor, forward->page_number);
+  forward->answered = true;
+  forward->found = content != nullptr;
+  if (content != nullptr) {
+    forward->version = content->version;
+    forward->checksum = content->checksum;
+    memcpy(forward->content, content->data, PAGE_SIZE);
+  }
+}
+
+// Runs on the reactor that read the request. Forwarded pages are always sent
+// uncompressed.
+void complete_forward(Reactor& reactor, PageForward* forward) {
+  Connection* conn = forward->conn;
+  conn->waiters--;
+  if (conn->closed) {
+    delete forward;
+    release_if_done(conn);
+    return;
+  }
+  PageVersion copy{forward->version, forward->content};
+  copy.checksum = forward->checksum;
+  queue_response(reactor, conn, forward->request_id, forward->page_number,
+                 forward->found ? &copy : nullptr);
+  conn->pending.back().forward = forward;
+}
+
+void handle_put_request(Reactor& reactor, Connection* conn,
+                        const uint32_t request_id, const uint32_t page_number,
+                        const uint8_t* content) {
+  if (conn->closed) {
+    return;
+  }
+  OutgoingPage page{};
+  page.header.request_id = request_id;
+  page.header.page_number = page_number;
+  if (page_number >= reactor.store.page_count()) {
+    spdlog::error("Invalid page number: {0:#x}", page_number);
+    page.header.status = INVALID_PAGE_NUMBER;
+  } else {
+    page.header.status = SUCCESS;
+    page.header.version = reactor.store.put(
+        page_number, content, reactor.epoch);
+    spdlog::debug("[{}] Updated page {} to version {}", conn->id,
+                  page_number, page.header.version);
+    replicate(reactor, page_number, page.header.version, content);
+  }
+  page.header.to_network_order();
+  push_outgoing(reactor, conn, page);
+}
+
+// Applies an update pushed by the primary, unless the update of the page
+// that arrived on another reactor's link was newer.
+void handle_replicate_request(Reactor& reactor, Connection* conn,
+                              const ReplicatePageRequest& request,
+                              const uint8_t* content) {
+  if (conn->closed) {
+    return;
+  }
+  OutgoingPage page{};
+  page.header.request_id = request.header.request_id;
+  page.header.page_number = request.page_number;
+  if (request.page_number >= reactor.store.page_count()) {
+    spdlog::error("Invalid replicated page number: {0:#x}",
+                  request.page_number);
+    page.header.status = INVALID_PAGE_NUMBER;
+  } else {
+    page.header.status = SUCCESS;
+    page.header.version = reactor.store.put_version(
+        request.page_number, content, request.version, reactor.epoch);
+  }
+  page.header.to_network_order();
+  push_outgoing(reactor, conn, page);
+}
+
+void handle_hello(Reactor& reactor, Connection* conn,
+                  const HelloRequest& request) {
+  uint32_t supported = 0;
+  if (Config::compression) {
+    supported |= FEATURE_COMPRESSION;
+  }
+  if (Config::checksums) {
+    supported |= FEATURE_CHECKSUM;
+  }
+  conn->features = request.features & supported;
+  conn->hello_reply = htonl(conn->features);
+  spdlog::info("[{}] Negotiated features {:#x}", conn->id, conn->features);
+
+  OutgoingPage reply{};
+  reply.header.request_id = request.header.request_id;
+  reply.header.status = SUCCESS;
+  reply.header.content_length = sizeof(conn->hello_reply);
+  reply.header.to_network_order();
+  reply.content = reinterpret_cast<const uint8_t*>(&conn->hello_reply);
+  reply.content_length = sizeof(conn->hello_reply);
+  push_outgoing(reactor, conn, reply);
+}
+
+// Queues the header of a stream; the pages follow once it is written.
+void handle_stream_request(Reactor& reactor, Connection* conn,
+                           const StreamPagesRequest& request) {
+  if (conn->closed) {
+    return;
+  }
+  OutgoingPage page{};
+  page.header.request_id = request.header.request_id;
+  page.header.page_number = request.first_page;
+  const size_t page_count = reactor.store.page_count();
+  if (request.page_count == 0 || request.first_page >= page_count ||
+      request.page_count > page_count - request.first_page) {
+    spdlog::error("[{}] Invalid stream of {} pages from {:#x}", conn->id,
+                  request.page_count, request.first_page);
+    page.header.status = INVALID_PAGE_NUMBER;
+  } else {
+    spdlog::debug("[{}] Streaming {} pages from {}", conn->id,
+                  request.page_count, request.first_page);
+    page.header.status = SUCCESS;
+    page.header.flags = RESPONSE_STREAM;
+    page.header.content_length = request.page_count;
+    page.stream = new StreamPages(conn, request.first_page,
+                                  request.first_page + request.page_count);
+  }
+  page.header.to_network_order();
+  push_outgoing(reactor, conn, page);
+}
+
+// Picks the next chunk of a stream: the longest run of pages that were never
+// updated and lie back to back in page memory, up to STREAM_CHUNK_BYTES. That
+// memory lives as long as the server, so it can be sent zero-copy. An updated
+// page goes out on its own with a copying send, with its epoch pinned until
+// the kernel has taken the bytes.
+void next_stream_chunk(Reactor& reactor, StreamPages* stream) {
+  const size_t max_pages =
+      std::max<size_t>(Config::stream_chunk_bytes / PAGE_SIZE, 1);
+  const PageVersion* first = reactor.store.get(stream->next_page++);
+  stream->chunk = first->data;
+  stream->chunk_length = PAGE_SIZE;
+  stream->chunk_sent = 0;
+  if (first->owned) {
+    stream->chunk_zerocopy = false;
+    stream->chunk_epoch = reactor.epoch.current_pin();
+    reactor.epoch.reference(stream->chunk_epoch);
+    return;
+  }
+  stream->chunk_zerocopy = reactor.stream_zerocopy;
+  while (stream->next_page < stream->end_page &&
+         stream->chunk_length / PAGE_SIZE < max_pages) {
+    const PageVersion* next = reactor.store.get(stream->next_page);
+    if (next->owned || next->data != stream->chunk + stream->chunk_length) {
+      break;
+    }
+    stream->chunk_length += PAGE_SIZE;
+    stream->next_page++;
+  }
+}
+
+// MSG_WAITALL lets the kernel finish a chunk itself where it can; a short
+// send is still resubmitted.
+void add_stream_send(Reactor& reactor, StreamPages* stream) {
+  struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+  const uint8_t* data = stream->chunk + stream->chunk_sent;
+  const size_t length = stream->chunk_length - stream->chunk_sent;
+  if (stream->chunk_zerocopy) {
+    io_uring_prep_send_zc(sqe, stream->conn->fd, data, length, MSG_WAITALL, 0);
+  } else {
+    io_uring_prep_send(sqe, stream->conn->fd, data, length, MSG_WAITALL);
+  }
+  io_uring_sqe_set_data(sqe, stream);
+}
+
+void start_stream(Reactor& reactor, Connection* conn, StreamPages* stream) {
+  conn->stream = stream;
+  conn->write_in_flight = true;
+  stream->start_ns = now_ns();
+  next_stream_chunk(reactor, stream);
+  add_stream_send(reactor, stream);
+}
+
+void release_stream_chunk(Reactor& reactor, StreamPages* stream) {
+  if (stream->chunk_epoch != 0) {
+    reactor.epoch.unreference(stream->chunk_epoch);
+    stream->chunk_epoch = 0;
+  }
+}
+
+void handle_page_request(Reactor& reactor, Connection* conn,
+                         const uint32_t request_id,
+                         const uint32_t page_number) {
+  spdlog::debug("[{}] Requested page number: {}", conn->id, page_number);
+  const size_t owner = owner_of(reactor, page_number);
+  if (owner != reactor.index) {
+    conn->waiters++;
+    reactor.forwarded++;
+    add_forward(reactor,
+                new PageForward(conn, reactor.index, request_id, page_number),
+                owner);
+    return;
+  }
+  if (!Config::coalesce) {
+    queue_response(reactor, conn, request_id, page_number,
+                   fetch_page(reactor, page_number));
+    return;
+  }
+
+  reactor.coalescer.add(page_number, conn, request_id);
+  if (Config::coalesce_window_us > 0 && !reactor.timeout_armed) {
+    struct io_uring_sqe* sqe = get_sqe(reactor.ring);
+    io_uring_prep_timeout(sqe, &reactor.coalesce_window, 0, 0);
+    io_uring_sqe_set_data(sqe, &reactor.timeout_req);
+    reactor.timeout_armed = true;
+  }
+}
+
+void flush_coalescer(Reactor& reactor) {
+  std::vector<Connection*> finished;
+  reactor.coalescer.flush(
+      [&](const uint32_t page_number) {
+        return fetch_page(reactor, page_number);
+      },
+      [&](const PageWaiter& waiter, const uint32_t page_number,
+          const PageVersion* content) {
+        queue_response(reactor, waiter.conn, waiter.request_id, page_number,
+                       content);
+        if (waiter.conn->can_release()) {
+          finished.push_back(waiter.conn);
         }
-        spdlog::debug("Read data from client");
-
-        auto* request = reinterpret_cast<GetPageRequest*>(req->iov.iov_base);
-        request->to_host_order();
-        spdlog::debug("Requested page number: {}", request->page_number);
-
-        GetPageResponse response{};
-        response.header.request_id = request->request_id;
-        response.header.page_number = request->page_number;
-        if (request->page_number >= Config::page_count) {
-          spdlog::error("Invalid page number: {0:#x}", request->page_number);
-          response.header.status = INVALID_PAGE_NUMBER;
-          response.header.to_network_order();
-          memset(response.content.data(), 0xFA, response.content.size());
-          iovec iov[1];
-          iov[0].iov_base = &response;
-          iov[0].iov_len = sizeof(response);
-          add_write_request(ring, client_socket, iov, 1);
-        } else {
-          constexpr GetPageStatus status = SUCCESS;
-          response.header.status = status;
-          response.header.to_network_order();
+      });
+  for (auto* conn : finished) {
+    release_if_done(conn);
+  }
+}
 
-          iovec iov[2];
-          iov[0].iov_base = &response.header;
-          iov[0].iov_len = sizeof(response.header);
-          iov[1].iov_base = const_cast<uint8_t*>(memory_block.data.data()) +
-                            request->page_number * PAGE_SIZE;
-          iov[1].iov_len = PAGE_SIZE;
+// True once the connection has MAX_OUTSTANDING_RESPONSES responses
+// outstanding.
+bool out_of_credits(const Connection* conn) {
+  return Config::max_outstanding_responses > 0 &&
+         conn->outstanding() >= Config::max_outstanding_responses;
+}
+
+// Bytes of work a request causes: the frame plus the responses it produces.
+size_t request_cost(const uint8_t* frame, const size_t frame_size) {
+  RequestHeader header{};
+  memcpy(&header, frame, sizeof(header));
+  header.to_host_order();
+  constexpr size_t response_size = sizeof(GetPageResponseHeader) + PAGE_SIZE;
+  switch (header.get_type()) {
+    case GET_PAGE:
+    case GET_PAGE_BY_ID:
+    case GET_PAGE_WITH_DEADLINE:
+      return frame_size + response_size;
+    case MULTI_GET_PAGE:
+      return frame_size + (frame_size - MultiGetPageRequest::size_for(0)) /
+                              sizeof(uint32_t) * response_size;
+    default:
+      return frame_size + sizeof(GetPageResponseHeader);
+  }
+}
 
-          add_write_request(ring, client_socket, iov, 2);
+// Handles complete frames in the input buffer until the connection runs out
+// of credits or `deficit` bytes of work; the rest stays buffered. Returns
+// false if the stream is malformed.
+bool process_input(Reactor& reactor, Connection* conn, size_t& deficit) {
+  size_t offset = 0;
+  while (!out_of_credits(conn)) {
+    const uint8_t* frame = conn->in.data() + offset;
+    const size_t available = conn->in_used - offset;
+    const size_t frame_size = next_request_size(frame, available);
+    if (frame_size == SIZE_MAX) {
+      spdlog::error("[{}] Malformed request", conn->id);
+      return false;
+    }
+    if (frame_size == 0 || frame_size > available) {
+      break;
+    }
+    const size_t cost = request_cost(frame, frame_size);
+    if (cost > deficit) {
+      break;
+    }
+    deficit -= cost;
 
-          debug_print_array(static_cast<uint8_t*>(iov[1].iov_base),
-                            iov[1].iov_len);
+    RequestHeader header{};
+    memcpy(&header, frame, sizeof(header));
+    header.to_host_order();
+    switch (header.get_type()) {
+      case GET_PAGE: {
+        GetPageRequest request{};
+        memcpy(&request, frame, sizeof(request));
+        request.to_host_order();
+        trace_request(reactor, conn, GET_PAGE, request.page_number);
+        handle_page_request(reactor, conn, request.header.request_id,
+                            request.page_number);
+        break;
+      }
+      case GET_PAGE_WITH_DEADLINE: {
+        DeadlineGetPageRequest request{};
+        memcpy(&request, frame, sizeof(request));
+        request.to_host_order();
+        trace_request(reactor, conn, GET_PAGE_WITH_DEADLINE,
+                      request.page_number);
+        if (realtime_us() > request.deadline_us) {
+          queue_expired(reactor, conn, request.header.request_id,
+                        request.page_number);
+        } else {
+          handle_page_request(reactor, conn, request.header.request_id,
+                              request.page_number);
         }
-        free(req->iov.iov_base);
-        add_read_request(ring, client_socket);
-        io_uring_submit(&ring);
         break;
       }
-      case WRITE:
-        spdlog::debug("Write complete, keeping connection open");
-        free(req->iov.iov_base);
+      case GET_PAGE_BY_ID: {
+        GetPageByIdRequest request{};
+        memcpy(&request, frame, sizeof(request));
+        request.to_host_order();
+        trace_request(reactor, conn, GET_PAGE_BY_ID, request.page_id);
+        const uint32_t slot = slot_for_id(reactor, request.page_id);
+        handle_page_request(reactor, conn, request.header.request_id, slot);
+        break;
+      }
+      case PUT_PAGE: {
+        // Only the fixed fields are copied; the content is read in place.
+        PutPageRequest request;
+        memcpy(&request, frame, offsetof(PutPageRequest, content));
+        request.to_host_order();
+        trace_request(reactor, conn, PUT_PAGE, request.page_number);
+        handle_put_request(reactor, conn, request.header.request_id,
+                           request.page_number,
+                           frame + offsetof(PutPageRequest, content));
+        break;
+      }
+      case REPLICATE_PAGE: {
+        ReplicatePageRequest request;
+        memcpy(&request, frame, offsetof(ReplicatePageRequest, content));
+        request.to_host_order();
+        handle_replicate_request(
+            reactor, conn, request,
+            frame + offsetof(ReplicatePageRequest, content));
         break;
+      }
+      case HELLO: {
+        HelloRequest request{};
+        memcpy(&request, frame, sizeof(request));
+        request.to_host_order();
+        handle_hello(reactor, conn, request);
+        break;
+      }
+      case STREAM_PAGES: {
+        StreamPagesRequest request{};
+        memcpy(&request, frame, sizeof(request));
+        request.to_host_order();
+        handle_stream_request(reactor, conn, request);
+        break;
+      }
+      case MULTI_GET_PAGE: {
+        MultiGetPageRequest request{};
+        memcpy(&request, frame, frame_size);
+        request.to_host_order();
+        for (uint32_t i = 0; i < request.page_count; ++i) {
+          trace_request(reactor, conn, MULTI_GET_PAGE,
+                        request.page_numbers[i]);
+          handle_page_request(reactor, conn, request.header.request_id,
+                              request.page_numbers[i]);
+        }
+        break;
+      }
+      default:
+        return false;
     }
+    offset += frame_size;
+  }
 
-    io_uring_cqe_seen(&ring, cqe);
-    delete req;
+  if (offset > 0) {
+    memmove(conn->in.data(), conn->in.data() + offset,
+            conn->in_used - offset);
+    conn->in_used -= offset;
   }
+  return true;
 }
 
-void handle_client(const int client_socket,
-                   const MemoryBlock<PAGE_SIZE>& memory_block) {
-  spdlog::info("Handling a new client");
-  struct io_uring ring {};
-  setup_io_uring(ring);
-  event_loop(ring, client_socket, memory_block);
-  io_uring_queue_exit(&ring);
+void close_connection(Reactor& reactor, Connection* conn) {
+  if (!conn->closed) {
+    conn->closed = true;
+    if (Config::unix_socket.empty()) {
+      const TcpSegmentCounts segments = tcp_segment_counts(conn->fd);
+      spdlog::info("[{}] {} responses in {} sends and {} segments", conn->id,
+                   conn->responses_sent, conn->sends, segments.segments_out);
+    }
+    release_outgoing(reactor, conn->pending);
+    shutdown(conn->fd, SHUT_RDWR);
+  }
+  release_if_done(conn);
 }
 
-int main() {
-  Config::load_config();
+// Re-arms the read, or pauses reading while the connection is out of credits.
+// Paused connections are resumed from the write completion path. A full
+// buffer is only drained by the scheduler; if it does not even hold one
+// complete frame, the frame can never fit and the connection is closed.
+void continue_reading(Reactor& reactor, Connection* conn) {
+  if (conn->closed || conn->read_in_flight) {
+    return;
+  }
+  if (out_of_credits(conn)) {
+    if (!conn->read_paused) {
+      conn->read_paused = true;
+      reactor.paused_reads++;
+      spdlog::debug("[{}] Out of credits, pausing reads", conn->id);
+    }
+    return;
+  }
+  conn->read_paused = false;
+  if (conn->in_used == conn->in.size()) {
+    if (!has_complete_request(*conn)) {
+      spdlog::error("[{}] Request does not fit the input buffer", conn->id);
+      close_connection(reactor, conn);
+    }
+    return;
+  }
+  add_read_request(reactor, conn);
+}
 
-  MemoryBlock<PAGE_SIZE> memory_block(Config::page_count,
-                                      new PseudoRandomFillingStrategy());
+void make_runnable(Reactor& reactor, Connection* conn) {
+  if (!conn->runnable) {
+    conn->runnable = true;
+    reactor.runnable.push_back(conn);
+  }
+}
 
-  spdlog::info("Port: {}", Config::port);
+// Processes buffered requests right away, or leaves them to the scheduler
+// when DRR_QUANTUM_BYTES is set. Returns false for a malformed request.
+bool handle_input(Reactor& reactor, Connection* conn) {
+  if (Config::drr_quantum_bytes == 0) {
+    size_t unlimited = SIZE_MAX;
+    return process_input(reactor, conn, unlimited);
+  }
+  if (has_complete_request(*conn)) {
+    make_runnable(reactor, conn);
+  }
+  return true;
+}
 
-  int server_fd;
-  sockaddr_in address{};
-  int addr_len = sizeof(address);
+uint8_t head_priority(const Connection* conn) {
+  RequestHeader header{};
+  memcpy(&header, conn->in.data(), sizeof(header));
+  return std::min(header.priority, MAX_PRIORITY);
+}
 
-  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-    spdlog::critical("socket failed");
-    exit(EXIT_FAILURE);
+// One deficit round-robin round over the connections with buffered requests.
+// Each gets a quantum of bytes weighted by the priority of the request at the
+// head of its buffer, so a deeply pipelined client cannot monopolise the
+// reactor; whatever it cannot afford waits for the next loop iteration.
+void run_scheduler(Reactor& reactor) {
+  const size_t count = reactor.runnable.size();
+  for (size_t i = 0; i < count; ++i) {
+    Connection* conn = reactor.runnable.front();
+    reactor.runnable.pop_front();
+    conn->runnable = false;
+    if (conn->closed) {
+      conn->deficit = 0;
+      release_if_done(conn);
+      continue;
+    }
+
+    conn->deficit += Config::drr_quantum_bytes * (1 + head_priority(conn));
+    if (!process_input(reactor, conn, conn->deficit)) {
+      close_connection(reactor, conn);
+      continue;
+    }
+    if (has_complete_request(*conn) && !out_of_credits(conn)) {
+      make_runnable(reactor, conn);
+    } else {
+      conn->deficit = 0;
+    }
+    continue_reading(reactor, conn);
   }
+}
 
-  address.sin_family = AF_INET;
-  address.sin_addr.s_addr = INADDR_ANY;
-  address.sin_port = htons(Config::port);
+// Once everything written so far is out: resumes reads that waited for
+// credits and starts the next write if responses queued up meanwhile.
+void resume_after_write(Reactor& reactor, Connection* conn) {
+  if (conn->read_paused) {
+    if (!handle_input(reactor, conn)) {
+      close_connection(reactor, conn);
+      return;
+    }
+    continue_reading(reactor, conn);
+  }
+  if (!conn->pending.empty() && !conn->dirty) {
+    conn->dirty = true;
+    reactor.dirty.push_back(conn);
+  }
+}
 
-  if (bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) <
-      0) {
-    spdlog::critical("bind failed");
-    exit(EXIT_FAILURE);
+// Hands the write side back to the connection. The stream itself lives on
+// until its last zero-copy notification.
+void finish_stream(Reactor& reactor, StreamPages* stream) {
+  Connection* conn = stream->conn;
+  release_stream_chunk(reactor, stream);
+  conn->stream = nullptr;
+  conn->write_in_flight = false;
+  stream->finished = true;
+  const double seconds =
+      static_cast<double>(now_ns() - stream->start_ns) / 1e9;
+  spdlog::info("[{}] Streamed {} bytes in {:.3f} s ({:.2f} Gb/s)", conn->id,
+               stream->bytes, seconds,
+               seconds > 0 ? static_cast<double>(stream->bytes) * 8 / seconds / 1e9
+                           : 0.0);
+  if (stream->notifications == 0) {
+    delete stream;
   }
+}
 
-  if (listen(server_fd, MAX_QUEUE) < 0) {
-    spdlog::critical("listen");
-    exit(EXIT_FAILURE);
+void continue_stream(Reactor& reactor, StreamPages* stream, const int result) {
+  Connection* conn = stream->conn;
+  if (stream->chunk_zerocopy && (result == -EOPNOTSUPP || result == -EINVAL) &&
+      !conn->closed) {
+    spdlog::warn("[reactor {}] Zero-copy send unsupported ({}), copying",
+                 reactor.index, strerror(-result));
+    reactor.stream_zerocopy = false;
+    stream->chunk_zerocopy = false;
+    add_stream_send(reactor, stream);
+    return;
   }
+  if (result <= 0 || conn->closed) {
+    if (result < 0) {
+      spdlog::error("[{}] Stream send failed: {}", conn->id, strerror(-result));
+    }
+    finish_stream(reactor, stream);
+    close_connection(reactor, conn);
+    return;
+  }
+  stream->chunk_sent += result;
+  stream->bytes += result;
+  if (stream->chunk_sent < stream->chunk_length) {
+    add_stream_send(reactor, stream);
+    return;
+  }
+  release_stream_chunk(reactor, stream);
+  if (stream->next_page < stream->end_page) {
+    next_stream_chunk(reactor, stream);
+    add_stream_send(reactor, stream);
+    return;
+  }
+  finish_stream(reactor, stream);
+  resume_after_write(reactor, conn);
+}
 
-  spdlog::info("Server started. Listening on port {}", Config::port);
+void start_connection(Reactor& reactor, const int fd) {
+  auto* conn = new Connection(fd, reactor.next_connection_id++);
+  spdlog::info("[reactor {}] Handling a new client ({})", reactor.index,
+               conn->id);
+  if (Config::unix_socket.empty()) {
+    configure_socket_to_not_fragment(conn->fd);
+  }
+  if (Config::busy_poll_us > 0) {
+    int busy_poll = static_cast<int>(Config::busy_poll_us);
+    if (setsockopt(conn->fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll,
+                   sizeof(busy_poll)) < 0) {
+      spdlog::warn("[reactor {}] SO_BUSY_POLL failed: {}", reactor.index,
+                   strerror(errno));
+    }
+  }
+  add_read_request(reactor, conn);
+}
+
+void handle_cqe(Reactor& reactor, struct io_uring_cqe* cqe) {
+  auto* req = static_cast<custom_request*>(io_uring_cqe_get_data(cqe));
+  Connection* conn = req->conn;
+
+  switch (req->event_type) {
+    case ACCEPT: {
+      if (cqe->res < 0) {
+        spdlog::error("[reactor {}] accept failed: {}", reactor.index,
+                      strerror(-cqe->res));
+      } else if (reactor.tls != nullptr) {
+        reactor.tls->submit(cqe->res, reactor.index, &reactor.tls_ready_req);
+      } else {
+        start_connection(reactor, cqe->res);
+      }
+      add_accept_request(reactor);
+      break;
+    }
+    case TLS_READY: {
+      start_connection(reactor, cqe->res);
+      break;
+    }
+    case READ: {
+      conn->read_in_flight = false;
+      if (cqe->res <= 0 || conn->closed) {
+        if (cqe->res == 0) {
+          spdlog::info("[{}] Client closed connection", conn->id);
+        } else if (cqe->res < 0) {
+          spdlog::error("[{}] Read failed: {}", conn->id, strerror(-cqe->res));
+        }
+        close_connection(reactor, conn);
+        break;
+      }
+      conn->in_used += cqe->res;
+      if (!handle_input(reactor, conn)) {
+        close_connection(reactor, conn);
+        break;
+      }
+      continue_reading(reactor, conn);
+      break;
+    }
+    case WRITE: {
+      conn->write_in_flight = false;
+      if (cqe->res <= 0 || conn->closed) {
+        if (cqe->res < 0) {
+          spdlog::error("[{}] Write failed: {}", conn->id,
+                        strerror(-cqe->res));
+        }
+        release_outgoing(reactor, conn->writing);
+        close_connection(reactor, conn);
+        break;
+      }
+      if (!conn->advance_write(cqe->res)) {
+        add_write_request(reactor, conn);
+        break;
+      }
+      spdlog::debug("[{}] Write complete, keeping connection open", conn->id);
+      StreamPages* stream = conn->writing.back().stream;
+      conn->writing.back().stream = nullptr;
+      release_outgoing(reactor, conn->writing);
+      if (stream != nullptr) {
+        start_stream(reactor, conn, stream);
+        break;
+      }
+      resume_after_write(reactor, conn);
+      break;
+    }
+    case COALESCE_TIMEOUT:
+      reactor.timeout_armed = false;
+      flush_coalescer(reactor);
+      break;
+    case TRACE_WRITE: {
+      auto* write = static_cast<TraceWrite*>(req);
+      if (cqe->res <= 0) {
+        spdlog::error("[reactor {}] Trace write failed: {}", reactor.index,
+                      strerror(cqe->res == 0 ? EIO : -cqe->res));
+      } else if (!write->chunk.advance(cqe->res)) {
+        add_trace_write(reactor, write);
+        break;
+      }
+      write->chunk.reset();
+      reactor.trace_free.push_back(write);
+      break;
+    }
+    case FORWARD: {
+      auto* forward = static_cast<PageForward*>(req);
+      if (cqe->res < 0) {
+        // Our own message did not arrive: answer a request locally, retry a
+        // reply, which the origin is waiting for.
+        spdlog::warn("[reactor {}] Forwarding failed: {}", reactor.index,
+                     strerror(-cqe->res));
+        if (forward->answered) {
+          add_forward(reactor, forward, forward->origin);
+        } else {
+          answer_forward(reactor, forward);
+          complete_forward(reactor, forward);
+        }
+      } else if (forward->answered) {
+        complete_forward(reactor, forward);
+      } else {
+        answer_forward(reactor, forward);
+        add_forward(reactor, forward, forward->origin);
+      }
+      break;
+    }
+    case REPLICA_SEND: {
+      ReplicaLink* link = static_cast<ReplicaOp*>(req)->link;
+      link->send_in_flight = false;
+      if (cqe->res <= 0) {
+        fail_replica(reactor, link, cqe->res == 0 ? EPIPE : -cqe->res);
+        break;
+      }
+      link->out_sent += cqe->res;
+      if (link->out_sent < link->out.size()) {
+        add_replica_send(reactor, link);
+      } else {
+        link->out.clear();
+      }
+      break;
+    }
+    case REPLICA_ACK: {
+      ReplicaLink* link = static_cast<ReplicaOp*>(req)->link;
+      if (cqe->res <= 0) {
+        fail_replica(reactor, link, cqe->res == 0 ? ECONNRESET : -cqe->res);
+        break;
+      }
+      link->in_used += cqe->res;
+      link->consume_acks(now_ns());
+      add_replica_ack_read(reactor, link);
+      break;
+    }
+    case STREAM: {
+      auto* stream = static_cast<StreamPages*>(req);
+      // The kernel is done with the pages of an earlier zero-copy send.
+      if (cqe->flags & IORING_CQE_F_NOTIF) {
+        stream->notifications--;
+        if (stream->finished && stream->notifications == 0) {
+          delete stream;
+        }
+        break;
+      }
+      if (cqe->flags & IORING_CQE_F_MORE) {
+        stream->notifications++;
+      }
+      continue_stream(reactor, stream, cqe->res);
+      break;
+    }
+  }
+}
+
+// Starts a send on every replica link with updates queued and none in flight.
+void flush_replication(Reactor& reactor) {
+  for (auto& link : reactor.replicas) {
+    if (link->prepare_send()) {
+      add_replica_send(reactor, link.get());
+    }
+  }
+}
+
+void flush_dirty_connections(Reactor& reactor) {
+  for (auto* conn : reactor.dirty) {
+    conn->dirty = false;
+    if (conn->closed) {
+      release_if_done(conn);
+    } else if (conn->prepare_write()) {
+      add_write_request(reactor, conn);
+    }
+  }
+  reactor.dirty.clear();
+}
+
+// Logs the CPU time the reactor thread used since the last report, so wait
+// strategies can be compared on CPU cost as well as latency.
+void report_cpu(Reactor& reactor, double& last_cpu,
+                std::chrono::steady_clock::time_point& last_report) {
+  const auto now = std::chrono::steady_clock::now();
+  const double wall =
+      std::chrono::duration<double>(now - last_report).count();
+  const double cpu = thread_cpu_seconds();
+  spdlog::info(
+      "[reactor {}] {}: CPU {:.2f} s over {:.2f} s ({:.0f}%), {} completions, "
+      "spin hits {}, spin misses {}, blocking waits {}, paused reads {}, "
+      "overloaded {}, forwarded {}, expired {}",
+      reactor.index, wait_mode_name(reactor.wait.get_mode()), cpu - last_cpu,
+      wall, 100 * (cpu - last_cpu) / wall, reactor.completions,
+      reactor.wait.spin_hits, reactor.wait.spin_misses, reactor.wait.blocks,
+      reactor.paused_reads, reactor.overloaded, reactor.forwarded,
+      reactor.expired);
+  for (auto& link : reactor.replicas) {
+    spdlog::info("[reactor {}] replica {}: {} updates, lag p50: {:.1f} us, "
+                 "p99: {:.1f} us, max: {:.1f} us, unacknowledged {}",
+                 reactor.index, link->name, link->updates,
+                 link->lag.percentile_us(50), link->lag.percentile_us(99),
+                 link->lag.percentile_us(100), link->applied_ns.size());
+    link->lag = LatencyRecorder();
+  }
+  last_cpu = cpu;
+  last_report = now;
+  reactor.completions = 0;
+}
+
+void event_loop(Reactor& reactor) {
+  add_accept_request(reactor);
+  io_uring_submit(&reactor.ring);
+
+  constexpr auto REPORT_INTERVAL = std::chrono::seconds(5);
+  struct __kernel_timespec wait_timeout {};
+  wait_timeout.tv_sec = 1;
+  double last_cpu = thread_cpu_seconds();
+  auto last_report = std::chrono::steady_clock::now();
+  // With PAUSE_EVERY_MS the reactor stops serving for PAUSE_MS at that
+  // interval, like a process stuck in a GC pause or on a busy host.
+  const uint64_t pause_interval_ns = Config::pause_every_ms * 1000000;
+  uint64_t next_pause_ns = now_ns() + pause_interval_ns;
 
   while (true) {
-    int new_socket;
-    if ((new_socket = accept(server_fd, reinterpret_cast<sockaddr*>(&address),
-                             reinterpret_cast<socklen_t*>(&addr_len))) < 0) {
-      spdlog::critical("accept");
+    if (pause_interval_ns > 0 && now_ns() >= next_pause_ns) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(Config::pause_ms));
+      next_pause_ns = now_ns() + pause_interval_ns;
+    }
+    if (std::chrono::steady_clock::now() - last_report >= REPORT_INTERVAL &&
+        reactor.completions > 0) {
+      report_cpu(reactor, last_cpu, last_report);
+    }
+    // An idle reactor still writes out what it has recorded.
+    if (reactor.trace_file != nullptr) {
+      reactor.trace_now_ns = reactor.trace_file->since_start(now_ns());
+      if (reactor.trace_now_ns - reactor.trace_flushed_ns >=
+          TRACE_FLUSH_INTERVAL_NS) {
+        flush_trace(reactor);
+        io_uring_submit(&reactor.ring);
+      }
+    }
+
+    // Connections left runnable by the scheduler must not wait for I/O.
+    struct io_uring_cqe* cqe;
+    int r = reactor.runnable.empty()
+                ? reactor.wait.wait(reactor.ring, &cqe, &wait_timeout)
+                : io_uring_peek_cqe(&reactor.ring, &cqe);
+    if (r < 0 && !(r == -EAGAIN && !reactor.runnable.empty())) {
+      if (r == -EINTR || r == -ETIME) {
+        continue;
+      }
+      spdlog::critical("[reactor {}] io_uring_wait_cqe failed: {}",
+                       reactor.index, strerror(-r));
+      return;
+    }
+
+    reactor.epoch.enter();
+    if (reactor.trace_file != nullptr) {
+      reactor.trace_now_ns = reactor.trace_file->since_start(now_ns());
+    }
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&reactor.ring, head, cqe) {
+      handle_cqe(reactor, cqe);
+      count++;
+    }
+    io_uring_cq_advance(&reactor.ring, count);
+    reactor.completions += count;
+
+    run_scheduler(reactor);
+    // Without a window, everything that arrived in this batch of completions
+    // is one coalescing window.
+    if (Config::coalesce && Config::coalesce_window_us == 0) {
+      flush_coalescer(reactor);
+    }
+    flush_dirty_connections(reactor);
+    flush_replication(reactor);
+    io_uring_submit(&reactor.ring);
+    reactor.epoch.leave();
+  }
+}
+
+// Keeps a reactor, and the pages it owns with PARTITION_PAGES, on one core.
+void pin_to_cpu(const size_t index) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+  const int r = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (r != 0) {
+    spdlog::warn("[reactor {}] Cannot pin to a CPU: {}", index, strerror(r));
+  }
+}
+
+void run_reactor(const size_t index, const int listen_fd,
+                 PageStore<PAGE_SIZE>& store,
+                 std::atomic<size_t>& backlog_bytes, TlsHandshaker* tls,
+                 const PageIndex* page_index, TraceFile* trace_file,
+                 ReactorDirectory& directory) {
+  if (Config::pin_reactors) {
+    pin_to_cpu(index);
+  }
+  Reactor reactor(index, listen_fd, store, backlog_bytes, tls, page_index,
+                  trace_file, directory);
+  if (trace_file != nullptr) {
+    reactor.trace_active = take_trace_chunk(reactor);
+  }
+  reactor.coalesce_window.tv_sec =
+      static_cast<long long>(Config::coalesce_window_us / 1000000);
+  reactor.coalesce_window.tv_nsec =
+      static_cast<long long>((Config::coalesce_window_us % 1000000) * 1000);
+  setup_io_uring(reactor.ring);
+  for (const auto& replica : parse_endpoints(Config::replicas)) {
+    const int fd = connect_tcp_socket(replica.host, replica.port);
+    if (fd < 0) {
+      spdlog::critical("[reactor {}] Cannot reach replica {}:{}", index,
+                       replica.host, replica.port);
       exit(EXIT_FAILURE);
     }
+    reactor.replicas.push_back(std::make_unique<ReplicaLink>(
+        replica.host + ":" + std::to_string(replica.port), fd));
+    add_replica_ack_read(reactor, reactor.replicas.back().get());
+  }
+  if (Config::napi) {
+    register_napi(reactor.ring, Config::max_spin_us);
+  }
+  // Nothing may be forwarded to a ring that does not exist yet.
+  directory.ring_fds[index] = reactor.ring.ring_fd;
+  directory.ready.fetch_add(1);
+  while (directory.ready.load() < directory.ring_fds.size()) {
+    std::this_thread::yield();
+  }
+  event_loop(reactor);
+  spdlog::info("[reactor {}] coalesced {} page requests into {} lookups",
+               index, reactor.coalescer.requests, reactor.coalescer.lookups);
+  io_uring_queue_exit(&reactor.ring);
+}
+
+int main() {
+  Config::load_config();
+  const uint64_t start_ns = now_ns();
+  const auto seconds_since_start = [start_ns] {
+    return static_cast<double>(now_ns() - start_ns) / 1e9;
+  };
+
+  // A snapshot replaces filling altogether and brings its own page count.
+  MemoryBlock<PAGE_SIZE> memory_block =
+      Config::snapshot.empty()
+          ? MemoryBlock<PAGE_SIZE>(Config::page_count,
+                                   new PseudoRandomFillingStrategy(),
+                                   Config::huge_pages,
+                                   parse_fill_mode(Config::fill_mode),
+                                   Config::fill_threads)
+          : MemoryBlock<PAGE_SIZE>(Config::snapshot);
+  spdlog::info("Page memory: {} pages, {} bytes on {}",
+               memory_block.page_count(), memory_block.size_bytes(),
+               huge_page_mode_name(memory_block.data.mode()));
+  spdlog::info("Fill mode: {}, page memory ready after {:.3f} s",
+               Config::snapshot.empty() ? Config::fill_mode
+                                        : "snapshot " + Config::snapshot,
+               seconds_since_start());
+  PageStoreOptions store_options;
+  store_options.compress = Config::compression;
+  store_options.checksums = Config::checksums;
+  PageStore<PAGE_SIZE> store(memory_block, Config::reactor_threads,
+                             store_options);
+  if (Config::compression) {
+    spdlog::info("Compressed page store: {} of {} bytes ({:.2f}x)",
+                 store.compressed_bytes, memory_block.size_bytes(),
+                 static_cast<double>(memory_block.size_bytes()) /
+                     static_cast<double>(store.compressed_bytes));
+  }
 
-    std::thread client_thread(handle_client, new_socket,
-                              std::ref(memory_block));
-    client_thread.detach();
+  // Sparse stores take their ids from the snapshot, or from sparse_page_id
+  // with SPARSE=1.
+  std::unique_ptr<PageIndex> page_index;
+  if (memory_block.page_ids != nullptr || Config::sparse) {
+    const uint64_t index_start_ns = now_ns();
+    std::vector<uint64_t> generated_ids;
+    const uint64_t* ids = memory_block.page_ids;
+    if (ids == nullptr) {
+      generated_ids.resize(memory_block.page_count());
+      for (size_t i = 0; i < generated_ids.size(); ++i) {
+        generated_ids[i] = sparse_page_id(i);
+      }
+      ids = generated_ids.data();
+    }
+    page_index = std::make_unique<PageIndex>(ids, memory_block.page_count());
+    // Lookup check: a spread of ids must map back to their slots, and the
+    // id reserved for empty entries must not be found.
+    const size_t step = std::max<size_t>(1, memory_block.page_count() / 1024);
+    for (size_t slot = 0; slot < memory_block.page_count(); slot += step) {
+      if (page_index->find(ids[slot]) != slot) {
+        spdlog::critical("Page index maps id {} to the wrong slot", ids[slot]);
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (page_index->find(PageIndex::EMPTY) != PageIndex::NOT_FOUND) {
+      spdlog::critical("Page index finds the empty id");
+      exit(EXIT_FAILURE);
+    }
+    spdlog::info("Sparse page index: {} ids, {} bytes on {}, built in {:.3f} s",
+                 memory_block.page_count(), page_index->memory_bytes(),
+                 huge_page_mode_name(page_index->memory_mode()),
+                 static_cast<double>(now_ns() - index_start_ns) / 1e9);
+  }
+
+  // TCP reactors each own a SO_REUSEPORT listener; a Unix socket listener is
+  // shared by all of them.
+  std::vector<int> listen_fds;
+  if (Config::unix_socket.empty()) {
+    spdlog::info("Port: {}", Config::port);
+    for (size_t i = 0; i < Config::reactor_threads; ++i) {
+      listen_fds.push_back(create_listen_socket(Config::port));
+    }
+  } else {
+    spdlog::info("Unix socket: {}", Config::unix_socket);
+    listen_fds.assign(Config::reactor_threads,
+                      create_unix_listen_socket(Config::unix_socket));
+  }
+  spdlog::info("Wait strategy: {} (max spin {} us, SO_BUSY_POLL {} us, "
+               "NAPI {}, SQ thread idle {} ms)",
+               Config::wait_strategy, Config::max_spin_us,
+               Config::busy_poll_us, Config::napi, Config::sq_thread_idle_ms);
+  spdlog::info("Reactors: {}, coalescing: {} (window {} us)",
+               Config::reactor_threads, Config::coalesce,
+               Config::coalesce_window_us);
+
+  spdlog::info("Credits: {} responses per connection, memory budget: {} bytes",
+               Config::max_outstanding_responses, Config::memory_budget_bytes);
+
+  // The handshake runs on its own thread, after which the connection goes
+  // back to the reactor that accepted it and is served like a plaintext one.
+  std::unique_ptr<TlsContext> tls;
+  if (Config::tls) {
+    if (!Config::unix_socket.empty()) {
+      spdlog::critical("TLS needs TCP, unset UNIX_SOCKET");
+      exit(EXIT_FAILURE);
+    }
+    tls = std::make_unique<TlsContext>(TlsRole::SERVER, Config::tls_ca,
+                                       Config::tls_cert, Config::tls_key);
+    spdlog::info("kTLS enabled with {}", Config::tls_cert);
+  }
+
+  std::unique_ptr<TraceFile> trace_file;
+  if (!Config::trace.empty()) {
+    trace_file = std::make_unique<TraceFile>(Config::trace);
+    spdlog::info("Recording requests to {}", Config::trace);
+  }
+
+  spdlog::info("Streams: {} byte chunks, zero-copy: {}",
+               Config::stream_chunk_bytes, Config::stream_zerocopy);
+  if (Config::pause_every_ms > 0) {
+    spdlog::info("Injected pauses: {} ms every {} ms", Config::pause_ms,
+                 Config::pause_every_ms);
+  }
+  if (!Config::replicas.empty()) {
+    spdlog::info("Replicating updates to {}, at most {} bytes behind",
+                 Config::replicas, Config::replica_backlog_bytes);
+  }
+  spdlog::info("Page ownership: {}, reactors pinned: {}",
+               Config::partition_pages ? "partitioned" : "shared",
+               Config::pin_reactors);
+
+  std::atomic<size_t> backlog_bytes{0};
+  ReactorDirectory directory(Config::reactor_threads);
+  std::unique_ptr<TlsHandshaker> handshaker;
+  if (tls) {
+    handshaker = std::make_unique<TlsHandshaker>(*tls, directory);
+  }
+  std::vector<std::thread> reactors;
+  for (size_t i = 0; i < Config::reactor_threads; ++i) {
+    reactors.emplace_back(run_reactor, i, listen_fds[i], std::ref(store),
+                          std::ref(backlog_bytes), handshaker.get(),
+                          page_index.get(), trace_file.get(),
+                          std::ref(directory));
+  }
+
+  spdlog::info("Server started.");
+  spdlog::info("Accepting after {:.3f} s", seconds_since_start());
+
+  // Lazy pages are filled by their first reader; warm the rest meanwhile.
+  std::thread warmer;
+  if (memory_block.lazy()) {
+    warmer = std::thread([&memory_block, &seconds_since_start] {
+      memory_block.warm_up(Config::fill_threads);
+      spdlog::info("Page store warm after {:.3f} s", seconds_since_start());
+    });
+  }
+
+  for (auto& reactor : reactors) {
+    reactor.join();
+  }
+  if (warmer.joinable()) {
+    warmer.join();
+  }
+  if (!Config::unix_socket.empty()) {
+    listen_fds.resize(1);
+    unlink(Config::unix_socket.c_str());
+  }
+  for (const int fd : listen_fds) {
+    close(fd);
   }
 }
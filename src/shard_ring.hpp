@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Consistent-hash ring mapping page numbers to servers. Each server is placed
+// at VIRTUAL_NODES points derived from its name, so load evens out and adding
+// or removing a server only moves the pages next to its points; the names,
+// not their order in the list, decide where everything goes.
+class ShardRing {
+ public:
+  static constexpr size_t VIRTUAL_NODES = 160;
+
+  explicit ShardRing(const std::vector<std::string>& names)
+      : server_count(names.size()) {
+    points.reserve(names.size() * VIRTUAL_NODES);
+    for (size_t server = 0; server < names.size(); ++server) {
+      const uint64_t base = fnv1a(names[server]);
+      for (size_t node = 0; node < VIRTUAL_NODES; ++node) {
+        points.emplace_back(mix(base + node), server);
+      }
+    }
+    std::sort(points.begin(), points.end());
+  }
+
+  [[nodiscard]] size_t size() const { return server_count; }
+
+  [[nodiscard]] size_t owner(const uint32_t page_number) const {
+    return points[first_point(page_number)].second;
+  }
+
+  // The next server clockwise after the owner, where a copy of the page
+  // would live; the owner itself if it is alone.
+  [[nodiscard]] size_t successor(const uint32_t page_number) const {
+    size_t index = first_point(page_number);
+    const size_t owner = points[index].second;
+    for (size_t step = 1; step < points.size(); ++step) {
+      const size_t server = points[(index + step) % points.size()].second;
+      if (server != owner) {
+        return server;
+      }
+    }
+    return owner;
+  }
+
+ private:
+  static uint64_t fnv1a(const std::string& name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : name) {
+      hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  // splitmix64 finalizer; spreads neighbouring page numbers over the ring.
+  static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  [[nodiscard]] size_t first_point(const uint32_t page_number) const {
+    const uint64_t hash = mix(page_number);
+    const auto it = std::lower_bound(
+        points.begin(), points.end(), std::pair<uint64_t, size_t>{hash, 0});
+    return it == points.end() ? 0 : static_cast<size_t>(it - points.begin());
+  }
+
+  size_t server_count;
+  std::vector<std::pair<uint64_t, size_t>> points;
+};
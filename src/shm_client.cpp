@@ -0,0 +1,195 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "key_distribution.hpp"
+#include "latency_recorder.hpp"
+#include "memory_block.hpp"
+#include "models/get_page.hpp"
+#include "shm_transport.hpp"
+#include "spdlog/spdlog.h"
+#include "static_config.hpp"
+#include "utils.hpp"
+
+struct ShmClientStats {
+  size_t correct = 0;
+  size_t incorrect = 0;
+  size_t sleeps = 0;
+  LatencyRecorder latency;
+};
+
+// Requests slots [start, end), for the pages in `keys`, over a private
+// channel and checks every page in place in the shared page mapping.
+void client_thread(const size_t start, const size_t end,
+                   const std::vector<uint32_t>& keys,
+                   const MemoryBlockVerifier<PAGE_SIZE>& verifier,
+                   ShmClientStats& stats) {
+  const int control_fd = connect_unix_socket(Config::shm_socket);
+  if (control_fd < 0) return;
+
+  ShmHandshake handshake{};
+  int fds[SHM_FD_COUNT];
+  if (!receive_handshake(control_fd, handshake, fds)) {
+    spdlog::error("Handshake failed");
+    close(control_fd);
+    return;
+  }
+  if (handshake.page_size != PAGE_SIZE) {
+    spdlog::error("Server page size {} does not match {}",
+                  handshake.page_size, PAGE_SIZE);
+    throw std::runtime_error("Page size mismatch");
+  }
+
+  ShmChannel channel;
+  channel.map(fds[CHANNEL_FD], handshake.channel_length,
+              handshake.ring_capacity);
+  close(fds[CHANNEL_FD]);
+  void* pages_address = mmap(nullptr, handshake.pages_length, PROT_READ,
+                             MAP_SHARED, fds[PAGES_FD], 0);
+  close(fds[PAGES_FD]);
+  if (pages_address == MAP_FAILED) {
+    throw std::runtime_error("mmap of pages failed");
+  }
+  const auto* pages = static_cast<const uint8_t*>(pages_address);
+
+  auto& requests = channel.requests;
+  auto& responses = channel.responses;
+  const auto spin = std::chrono::microseconds(Config::shm_spin_us);
+  std::vector<uint64_t> sent_ns(end - start);
+
+  size_t next = start;
+  size_t received = start;
+  auto last_work = std::chrono::steady_clock::now();
+  while (received < end) {
+    size_t pushed = 0;
+    const uint64_t now = now_ns();
+    while (next < end && !requests.full()) {
+      requests.push({static_cast<uint32_t>(next), keys[next - start]});
+      sent_ns[next - start] = now;
+      next++;
+      pushed++;
+    }
+    if (pushed > 0) {
+      requests.notify(fds[REQUEST_EVENT_FD]);
+    }
+
+    size_t popped = 0;
+    ShmResponse response{};
+    while (responses.pop(response)) {
+      popped++;
+      // Only slots that have been sent can come back.
+      if (response.request_id < start || response.request_id >= next) {
+        spdlog::error("Response for unknown request {}", response.request_id);
+        stats.incorrect++;
+        continue;
+      }
+      stats.latency.record(now_ns() - sent_ns[response.request_id - start]);
+      const bool valid = response.status == SUCCESS &&
+                         response.offset + PAGE_SIZE <= handshake.pages_length;
+      if (valid &&
+          verifier.verify(*reinterpret_cast<const std::array<uint8_t, PAGE_SIZE>*>(
+                              pages + response.offset),
+                          response.page_number)) {
+        stats.correct++;
+      } else {
+        spdlog::error("Verification failed for page {}", response.page_number);
+        stats.incorrect++;
+      }
+    }
+    received += popped;
+    if (channel.broken()) {
+      spdlog::error("Server corrupted the channel rings");
+      stats.incorrect += end - received;
+      break;
+    }
+
+    const auto current = std::chrono::steady_clock::now();
+    if (popped > 0 || pushed > 0) {
+      last_work = current;
+    } else if (current - last_work >= spin) {
+      if (responses.prepare_sleep()) {
+        wait_event(fds[RESPONSE_EVENT_FD], 100);
+        stats.sleeps++;
+      }
+      responses.finish_sleep();
+      last_work = std::chrono::steady_clock::now();
+    }
+  }
+
+  munmap(pages_address, handshake.pages_length);
+  close(fds[REQUEST_EVENT_FD]);
+  close(fds[RESPONSE_EVENT_FD]);
+  close(control_fd);
+}
+
+int main() {
+  Config::load_config();
+  const IFillingStrategy* strategy = new PseudoRandomFillingStrategy();
+  MemoryBlockVerifier<PAGE_SIZE> verifier(Config::page_count, strategy);
+
+  size_t num_requests = Config::num_requests;
+
+  const KeyDistributionParams distribution = config_key_distribution();
+  std::vector<ShmClientStats> stats(Config::client_threads);
+  std::vector<std::vector<uint32_t>> keys(Config::client_threads);
+  std::vector<std::thread> threads;
+  size_t requests_per_thread = num_requests / Config::client_threads;
+  for (size_t i = 0; i < Config::client_threads; i++) {
+    size_t start = i * requests_per_thread;
+    size_t end = (i == Config::client_threads - 1)
+                     ? num_requests
+                     : (i + 1) * requests_per_thread;
+    keys[i] = generate_keys(distribution, start, end);
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < Config::client_threads; i++) {
+    size_t start = i * requests_per_thread;
+    size_t end = start + keys[i].size();
+    spdlog::info("Starting thread {} for range {} {}", i, start, end);
+    threads.emplace_back(client_thread, start, end, std::cref(keys[i]),
+                         std::cref(verifier), std::ref(stats[i]));
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  double total_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::high_resolution_clock::now() - start_time)
+          .count() /
+      1000000000.0;
+  const double avg_rate =
+      static_cast<double>(Config::num_requests) / total_time;
+  const double avg_gbps =
+      avg_rate * sizeof(GetPageResponse) * 8 / (1000 * 1000 * 1000);
+
+  ShmClientStats total{};
+  for (const auto& thread_stats : stats) {
+    total.correct += thread_stats.correct;
+    total.incorrect += thread_stats.incorrect;
+    total.sleeps += thread_stats.sleeps;
+    total.latency.merge(thread_stats.latency);
+  }
+
+  spdlog::info("======================================");
+  spdlog::info("Correct responses: {}", total.correct);
+  spdlog::info("Incorrect responses: {}", total.incorrect);
+  spdlog::info("Client sleeps: {}", total.sleeps);
+  spdlog::info("Total time for {} requests: {:.2f} s", Config::num_requests,
+               total_time);
+  spdlog::info("Average rate: {:03.2f} req/s", avg_rate);
+  spdlog::info("Latency p50: {:.1f} us, p99: {:.1f} us, p99.9: {:.1f} us",
+               total.latency.percentile_us(50), total.latency.percentile_us(99),
+               total.latency.percentile_us(99.9));
+  spdlog::info("Average throughput: {:03.2f} Gb/s", avg_gbps);
+  spdlog::info("======================================");
+
+  return 0;
+}
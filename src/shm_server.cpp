@@ -0,0 +1,258 @@
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "memory_block.hpp"
+#include "models/get_page.hpp"
+#include "page_store.hpp"
+#include "shm_transport.hpp"
+#include "spdlog/spdlog.h"
+#include "static_config.hpp"
+#include "utils.hpp"
+
+// Server side of one client channel. `control_fd` is the Unix socket the
+// client connected with; it hangs up when the client exits.
+struct ServerChannel {
+  uint32_t id;
+  int control_fd = -1;
+  int request_efd = -1;
+  int response_efd = -1;
+  ShmChannel channel;
+  size_t served = 0;
+
+  ~ServerChannel() {
+    for (const int fd : {control_fd, request_efd, response_efd}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+};
+
+struct ShmReactor {
+  size_t index;
+  int wake_efd;
+  std::mutex incoming_mutex;
+  std::vector<std::unique_ptr<ServerChannel>> incoming;
+  std::vector<std::unique_ptr<ServerChannel>> channels;
+};
+
+// Takes ownership of `control_fd`: if the channel cannot be set up, it is
+// closed together with everything created so far.
+std::unique_ptr<ServerChannel> create_channel(const int control_fd,
+                                              const uint32_t id,
+                                              const SharedPages<PAGE_SIZE>& pages) {
+  const uint32_t capacity = round_up_to_power_of_two(Config::shm_ring_size);
+  const size_t length = ShmChannel::length_for(capacity);
+
+  auto channel = std::make_unique<ServerChannel>();
+  channel->id = id;
+  channel->control_fd = control_fd;
+
+  const int channel_fd = memfd_create("channel", MFD_CLOEXEC);
+  if (channel_fd < 0) {
+    spdlog::error("memfd for channel failed: {}", strerror(errno));
+    return nullptr;
+  }
+  if (ftruncate(channel_fd, static_cast<off_t>(length)) < 0) {
+    spdlog::error("ftruncate of channel failed: {}", strerror(errno));
+    close(channel_fd);
+    return nullptr;
+  }
+  channel->request_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  channel->response_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (channel->request_efd < 0 || channel->response_efd < 0) {
+    spdlog::error("eventfd for channel failed: {}", strerror(errno));
+    close(channel_fd);
+    return nullptr;
+  }
+  try {
+    channel->channel.map(channel_fd, length, capacity);
+  } catch (const std::runtime_error& e) {
+    spdlog::error("Channel for client {}: {}", id, e.what());
+    close(channel_fd);
+    return nullptr;
+  }
+  channel->channel.requests.init();
+  channel->channel.responses.init();
+
+  ShmHandshake handshake{PAGE_SIZE, static_cast<uint32_t>(pages.page_count),
+                         capacity, length, pages.length};
+  int fds[SHM_FD_COUNT];
+  fds[CHANNEL_FD] = channel_fd;
+  fds[PAGES_FD] = pages.fd;
+  fds[REQUEST_EVENT_FD] = channel->request_efd;
+  fds[RESPONSE_EVENT_FD] = channel->response_efd;
+  const bool sent = send_handshake(control_fd, handshake, fds);
+  close(channel_fd);
+  if (!sent) {
+    spdlog::error("Handshake with client {} failed", id);
+    return nullptr;
+  }
+  return channel;
+}
+
+// Answers every request the response ring has room for. Pages are handed
+// over as offsets into the shared page mapping; it is sealed, so every page
+// stays at its initial version.
+size_t serve_channel(ServerChannel& server_channel,
+                     const SharedPages<PAGE_SIZE>& pages) {
+  auto& requests = server_channel.channel.requests;
+  auto& responses = server_channel.channel.responses;
+  size_t served = 0;
+  ShmRequest request{};
+  while (!responses.full() && requests.pop(request)) {
+    ShmResponse response{request.request_id, SUCCESS, request.page_number,
+                         PageStore<PAGE_SIZE>::INITIAL_VERSION, 0};
+    if (request.page_number >= pages.page_count) {
+      response.status = INVALID_PAGE_NUMBER;
+    } else {
+      response.offset = static_cast<uint64_t>(request.page_number) * PAGE_SIZE;
+    }
+    responses.push(response);
+    served++;
+  }
+  if (served > 0) {
+    responses.notify(server_channel.response_efd);
+    server_channel.served += served;
+  }
+  return served;
+}
+
+// Blocks until a client rings its doorbell, a client hangs up or a new
+// channel is handed over. Returns without sleeping if work raced in.
+void sleep_on_channels(ShmReactor& reactor) {
+  size_t prepared = 0;
+  for (; prepared < reactor.channels.size(); ++prepared) {
+    if (!reactor.channels[prepared]->channel.requests.prepare_sleep()) {
+      break;
+    }
+  }
+  if (prepared == reactor.channels.size()) {
+    std::vector<pollfd> pfds;
+    pfds.push_back({reactor.wake_efd, POLLIN, 0});
+    for (auto& channel : reactor.channels) {
+      pfds.push_back({channel->request_efd, POLLIN, 0});
+      pfds.push_back({channel->control_fd, POLLIN, 0});
+    }
+    poll(pfds.data(), pfds.size(), -1);
+
+    uint64_t value;
+    [[maybe_unused]] ssize_t r = read(reactor.wake_efd, &value, sizeof(value));
+    for (size_t i = 0; i < reactor.channels.size(); ++i) {
+      const pollfd& request_pfd = pfds[1 + 2 * i];
+      const pollfd& control_pfd = pfds[2 + 2 * i];
+      if (request_pfd.revents != 0) {
+        r = read(request_pfd.fd, &value, sizeof(value));
+      }
+      if (control_pfd.revents != 0) {
+        // Clients never write on the control socket; readable means EOF.
+        auto& channel = reactor.channels[i];
+        spdlog::info("[reactor {}] Client {} disconnected after {} requests",
+                     reactor.index, channel->id, channel->served);
+        channel.reset();
+      }
+    }
+  }
+  for (size_t i = 0; i < prepared && i < reactor.channels.size(); ++i) {
+    if (reactor.channels[i]) {
+      reactor.channels[i]->channel.requests.finish_sleep();
+    }
+  }
+  reactor.channels.erase(
+      std::remove(reactor.channels.begin(), reactor.channels.end(), nullptr),
+      reactor.channels.end());
+}
+
+void run_reactor(ShmReactor& reactor, const SharedPages<PAGE_SIZE>& pages) {
+  const auto spin = std::chrono::microseconds(Config::shm_spin_us);
+  auto last_work = std::chrono::steady_clock::now();
+  while (true) {
+    {
+      std::lock_guard lock(reactor.incoming_mutex);
+      for (auto& channel : reactor.incoming) {
+        reactor.channels.push_back(std::move(channel));
+      }
+      reactor.incoming.clear();
+    }
+
+    size_t served = 0;
+    for (auto& channel : reactor.channels) {
+      served += serve_channel(*channel, pages);
+      if (channel->channel.broken()) {
+        spdlog::error("[reactor {}] Client {} corrupted its rings, dropping it",
+                      reactor.index, channel->id);
+        channel.reset();
+      }
+    }
+    reactor.channels.erase(
+        std::remove(reactor.channels.begin(), reactor.channels.end(), nullptr),
+        reactor.channels.end());
+    const auto now = std::chrono::steady_clock::now();
+    if (served > 0) {
+      last_work = now;
+    } else if (now - last_work >= spin) {
+      sleep_on_channels(reactor);
+      last_work = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+int main() {
+  Config::load_config();
+
+  MemoryBlock<PAGE_SIZE> memory_block(
+      HugePageBuffer::shared(PAGE_SIZE * Config::page_count,
+                             Config::huge_pages),
+      Config::page_count, new PseudoRandomFillingStrategy());
+  spdlog::info("Page memory: {} bytes on {}", memory_block.size_bytes(),
+               huge_page_mode_name(memory_block.data.mode()));
+  SharedPages<PAGE_SIZE> pages(memory_block);
+
+  const int listen_fd = create_unix_listen_socket(Config::shm_socket);
+  spdlog::info("Shared-memory server on {}: {} reactors, ring size {}",
+               Config::shm_socket, Config::reactor_threads,
+               round_up_to_power_of_two(Config::shm_ring_size));
+
+  std::vector<std::unique_ptr<ShmReactor>> reactors;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < Config::reactor_threads; ++i) {
+    reactors.push_back(std::make_unique<ShmReactor>());
+    reactors[i]->index = i;
+    reactors[i]->wake_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    threads.emplace_back(run_reactor, std::ref(*reactors[i]), std::cref(pages));
+  }
+
+  // Channels are spread round-robin over the reactors.
+  uint32_t next_id = 0;
+  while (true) {
+    const int control_fd = accept(listen_fd, nullptr, nullptr);
+    if (control_fd < 0) {
+      spdlog::error("accept failed: {}", strerror(errno));
+      continue;
+    }
+    const uint32_t id = next_id++;
+    auto channel = create_channel(control_fd, id, pages);
+    if (!channel) {
+      continue;
+    }
+    ShmReactor& reactor = *reactors[id % reactors.size()];
+    spdlog::info("[reactor {}] Handling a new client ({})", reactor.index, id);
+    {
+      std::lock_guard lock(reactor.incoming_mutex);
+      reactor.incoming.push_back(std::move(channel));
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] ssize_t r = write(reactor.wake_efd, &one, sizeof(one));
+  }
+}
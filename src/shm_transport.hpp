@@ -0,0 +1,293 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "consts.hpp"
+#include "memory_block.hpp"
+
+// Shared-memory transport for clients on the same host. Every client gets a
+// channel: a memfd holding one request ring and one response ring, plus an
+// eventfd per direction used only when the consumer went to sleep. Responses
+// carry the offset of the page in a read-only mapping of the page data that
+// the client maps once, so pages are never copied through the kernel.
+
+struct ShmRequest {
+  uint32_t request_id;
+  uint32_t page_number;
+};
+
+struct ShmResponse {
+  uint32_t request_id;
+  uint32_t status;
+  uint32_t page_number;
+  uint32_t version;
+  uint64_t offset;
+};
+
+// Indices of a ring, the only part of it that lives in shared memory next to
+// the entries. The other process can write anything here, so neither side
+// trusts what it reads back.
+struct SpscRingHeader {
+  alignas(64) std::atomic<uint32_t> head;
+  alignas(64) std::atomic<uint32_t> tail;
+  alignas(64) std::atomic<uint32_t> sleeping;
+};
+
+// One side's view of a single-producer single-consumer ring in shared memory.
+// Capacity, mask and the side's own index are process-local; the other side's
+// index is cached so the shared cache line is only read when the cached value
+// says the ring is full or empty. An index that puts more than `capacity`
+// entries in the ring marks it broken.
+template <typename T>
+class SpscRing {
+ public:
+  static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                "rings are shared between processes");
+
+  static constexpr size_t size_for(const uint32_t capacity) {
+    return sizeof(SpscRingHeader) + capacity * sizeof(T);
+  }
+
+  // `capacity` must be a power of two.
+  void attach(uint8_t* base, const uint32_t capacity) {
+    header = reinterpret_cast<SpscRingHeader*>(base);
+    entries = reinterpret_cast<T*>(base + sizeof(SpscRingHeader));
+    this->capacity = capacity;
+    mask = capacity - 1;
+    local_head = cached_head = header->head.load(std::memory_order_acquire);
+    local_tail = cached_tail = header->tail.load(std::memory_order_acquire);
+  }
+
+  // Resets the shared indices; done by the side that creates the ring.
+  void init() {
+    header->head.store(0);
+    header->tail.store(0);
+    header->sleeping.store(0);
+    local_head = cached_head = 0;
+    local_tail = cached_tail = 0;
+  }
+
+  bool full() {
+    if (local_tail - cached_head < capacity) {
+      return false;
+    }
+    cached_head = header->head.load(std::memory_order_acquire);
+    if (local_tail - cached_head > capacity) {
+      broken_ = true;
+      return true;
+    }
+    return local_tail - cached_head == capacity;
+  }
+
+  bool push(const T& value) {
+    if (full()) {
+      return false;
+    }
+    entries[local_tail & mask] = value;
+    header->tail.store(++local_tail, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& value) {
+    if (local_head == cached_tail) {
+      cached_tail = header->tail.load(std::memory_order_acquire);
+      if (cached_tail - local_head > capacity) {
+        broken_ = true;
+        return false;
+      }
+      if (local_head == cached_tail) {
+        return false;
+      }
+    }
+    value = entries[local_head & mask];
+    header->head.store(++local_head, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return local_head == header->tail.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] bool broken() const { return broken_; }
+
+  // Producer side of the doorbell: rings `efd` only if the consumer sleeps.
+  void notify(const int efd) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->sleeping.load(std::memory_order_relaxed) != 0) {
+      const uint64_t one = 1;
+      [[maybe_unused]] ssize_t r = write(efd, &one, sizeof(one));
+    }
+  }
+
+  // Consumer side: announces that it is about to sleep. Returns false if
+  // entries arrived meanwhile, in which case it must not sleep.
+  bool prepare_sleep() {
+    header->sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!empty()) {
+      header->sleeping.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  void finish_sleep() {
+    header->sleeping.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  SpscRingHeader* header = nullptr;
+  T* entries = nullptr;
+  uint32_t capacity = 0;
+  uint32_t mask = 0;
+  uint32_t local_head = 0;
+  uint32_t cached_tail = 0;
+  uint32_t local_tail = 0;
+  uint32_t cached_head = 0;
+  bool broken_ = false;
+};
+
+// Sent over the Unix socket together with the channel, page and eventfd fds.
+struct ShmHandshake {
+  uint32_t page_size;
+  uint32_t page_count;
+  uint32_t ring_capacity;
+  uint64_t channel_length;
+  uint64_t pages_length;
+};
+
+enum ShmFd { CHANNEL_FD, PAGES_FD, REQUEST_EVENT_FD, RESPONSE_EVENT_FD };
+constexpr size_t SHM_FD_COUNT = 4;
+
+inline uint32_t round_up_to_power_of_two(const size_t value) {
+  uint32_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+// Both rings of a channel, mapped from the channel memfd.
+struct ShmChannel {
+  uint8_t* base = nullptr;
+  size_t length = 0;
+  SpscRing<ShmRequest> requests;
+  SpscRing<ShmResponse> responses;
+
+  ShmChannel() = default;
+  ShmChannel(const ShmChannel&) = delete;
+  ShmChannel& operator=(const ShmChannel&) = delete;
+
+  static size_t length_for(const uint32_t capacity) {
+    const size_t request_bytes = SpscRing<ShmRequest>::size_for(capacity);
+    return (request_bytes + 63) / 64 * 64 +
+           SpscRing<ShmResponse>::size_for(capacity);
+  }
+
+  void map(const int fd, const size_t channel_length, const uint32_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        length_for(capacity) > channel_length) {
+      throw std::runtime_error("invalid channel layout");
+    }
+    length = channel_length;
+    void* address =
+        mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      throw std::runtime_error("mmap of channel failed");
+    }
+    base = static_cast<uint8_t*>(address);
+    requests.attach(base, capacity);
+    const size_t request_bytes = SpscRing<ShmRequest>::size_for(capacity);
+    responses.attach(base + (request_bytes + 63) / 64 * 64, capacity);
+  }
+
+  [[nodiscard]] bool broken() const {
+    return requests.broken() || responses.broken();
+  }
+
+  ~ShmChannel() {
+    if (base != nullptr) {
+      munmap(base, length);
+    }
+  }
+};
+
+// The page data of a MemoryBlock built on a HugePageBuffer::shared() buffer,
+// sealed in place. Clients map the memfd read-only and the seals guarantee
+// that nobody, the server included, can change it afterwards.
+template <size_t PageSize>
+class SharedPages {
+ public:
+  explicit SharedPages(MemoryBlock<PageSize>& memory_block)
+      : fd(memory_block.data.fd()),
+        length(memory_block.data.mapped_size()),
+        page_count(memory_block.page_count()),
+        data(memory_block.page(0)) {
+    if (fd < 0) {
+      throw std::runtime_error("page memory is not in a memfd");
+    }
+    memory_block.data.seal();
+  }
+
+  int fd;
+  size_t length;
+  size_t page_count;
+  const uint8_t* data;
+};
+
+inline bool send_handshake(const int sock, const ShmHandshake& handshake,
+                           const int (&fds)[SHM_FD_COUNT]) {
+  iovec iov{const_cast<ShmHandshake*>(&handshake), sizeof(handshake)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  return sendmsg(sock, &message, MSG_NOSIGNAL) == sizeof(handshake);
+}
+
+inline bool receive_handshake(const int sock, ShmHandshake& handshake,
+                              int (&fds)[SHM_FD_COUNT]) {
+  iovec iov{&handshake, sizeof(handshake)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  if (recvmsg(sock, &message, MSG_WAITALL) != sizeof(handshake)) {
+    return false;
+  }
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+  if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    return false;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  return true;
+}
+
+// Waits until `efd` is signalled or `timeout_ms` passes, then drains it.
+inline void wait_event(const int efd, const int timeout_ms) {
+  pollfd pfd{efd, POLLIN, 0};
+  if (poll(&pfd, 1, timeout_ms) > 0) {
+    uint64_t value;
+    [[maybe_unused]] ssize_t r = read(efd, &value, sizeof(value));
+  }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "key_distribution.hpp"
+
 #ifndef PAGE_SIZE
 #define PAGE_SIZE 8
 #endif
@@ -36,6 +38,105 @@
 #define ALLOCATE_MALLOC 0
 #endif
 
+// Carve the initial BufferPool buffers from a huge-page arena.
+#ifndef HUGE_PAGES
+#define HUGE_PAGES 0
+#endif
+
+// Pages the clients ask for: sequential, uniform, zipf, hotspot or scan over
+// the NUM_REQUESTS page numbers. See key_distribution.hpp.
+#ifndef KEY_DISTRIBUTION
+#define KEY_DISTRIBUTION "sequential"
+#endif
+
+#ifndef ZIPF_THETA
+#define ZIPF_THETA 0.99
+#endif
+
+#ifndef HOTSPOT_FRACTION
+#define HOTSPOT_FRACTION 0.2
+#endif
+
+#ifndef HOTSPOT_PROBABILITY
+#define HOTSPOT_PROBABILITY 0.8
+#endif
+
+#ifndef SCAN_LENGTH
+#define SCAN_LENGTH 64
+#endif
+
+// Gather all pages produced in one completion batch into a single sendmsg
+// instead of one send per page.
+#ifndef SEND_COALESCE
+#define SEND_COALESCE 0
+#endif
+
+// With SEND_COALESCE, mark sendmsg calls with MSG_MORE when more responses
+// are known to follow: the queue does not fit one call, or the client has
+// already sent further requests.
+#ifndef USE_MSG_MORE
+#define USE_MSG_MORE 0
+#endif
+
+// With SEND_COALESCE, page numbers read from the socket at once.
+#ifndef MAX_BATCH_PAGES
+#define MAX_BATCH_PAGES 64
+#endif
+
+// Responses a connection may have in flight before the server stops reading
+// from it; 0 disables the limit.
+#ifndef MAX_OUTSTANDING_SENDS
+#define MAX_OUTSTANDING_SENDS 0
+#endif
+
+// Bytes of response buffers all connections may hold together before reads
+// are paused; 0 disables the budget. A connection with nothing in flight may
+// always take one more request, so every client keeps making progress.
+#ifndef MEMORY_BUDGET
+#define MEMORY_BUDGET 0
+#endif
+
+// Serve all connections from this many threads with one ring each (see
+// connection_loop.hpp) instead of a thread and a ring per connection; 0 keeps
+// the thread per connection.
+#ifndef EVENT_LOOPS
+#define EVENT_LOOPS 0
+#endif
+
+// Connections simple_iou_client opens and keeps open without sending
+// anything, next to the CLIENT_THREADS active ones.
+#ifndef IDLE_CONNECTIONS
+#define IDLE_CONNECTIONS 0
+#endif
+
+// Loopback addresses 127.0.0.1, 127.0.0.2, ... the idle connections are
+// spread over, each good for one range of ephemeral ports.
+#ifndef SOURCE_ADDRESSES
+#define SOURCE_ADDRESSES 1
+#endif
+
+// Let simple_iou_client size each connection's window of requests in flight
+// from the RTTs it sees (see pipeline_controller.hpp) instead of the fixed
+// RING_SIZE / 4. RING_SIZE then only bounds the depth.
+#ifndef ADAPTIVE_PIPELINE
+#define ADAPTIVE_PIPELINE 0
+#endif
+
+// With ADAPTIVE_PIPELINE, the 90th percentile latency to hold, in
+// microseconds; 0 aims at throughput instead.
+#ifndef LATENCY_SLO_US
+#define LATENCY_SLO_US 0
+#endif
+
+#ifndef MIN_PIPELINE_DEPTH
+#define MIN_PIPELINE_DEPTH 1
+#endif
+
+// Every request in flight needs a send and a receive in the ring.
+#ifndef MAX_PIPELINE_DEPTH
+#define MAX_PIPELINE_DEPTH (RING_SIZE / 2)
+#endif
+
 #define BUFFER_POOL_INITIAL_POOL_SIZE 128
 
 struct RequestData {
@@ -47,3 +148,14 @@ struct RequestData {
 };
 
 enum EventType { READ_EVENT, WRITE_EVENT, SEND_EVENT, RECV_EVENT };
+
+inline KeyDistributionParams simple_key_distribution() {
+  KeyDistributionParams params;
+  params.kind = parse_key_distribution(KEY_DISTRIBUTION);
+  params.key_count = NUM_REQUESTS;
+  params.zipf_theta = ZIPF_THETA;
+  params.hotspot_fraction = HOTSPOT_FRACTION;
+  params.hotspot_probability = HOTSPOT_PROBABILITY;
+  params.scan_length = SCAN_LENGTH;
+  return params;
+}
@@ -13,6 +13,9 @@
 #include <vector>
 
 #include "buffer_pool.hpp"
+#include "latency_recorder.hpp"
+#include "pipeline_controller.hpp"
+#include "process_stats.hpp"
 #include "simple_consts.hpp"
 
 void debug_print_array(uint8_t* arr, uint32_t size) {
@@ -69,8 +72,44 @@ int make_client_sock(size_t thread_index) {
   return sock;
 }
 
+// Opens `count` connections that never send anything, bound to
+// SOURCE_ADDRESSES loopback addresses in turn so that the four-tuples do not
+// run out of ephemeral ports.
+std::vector<int> open_idle_connections(const size_t count) {
+  struct sockaddr_in serv_addr {};
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(PORT);
+  inet_pton(AF_INET, SERVER_ADDR, &serv_addr.sin_addr);
+
+  std::vector<int> sockets;
+  sockets.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+      std::cout << "Idle socket " << i << " failed: " << strerror(errno)
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    // Let connect() pick the port, which it can reuse across addresses.
+    int one = 1;
+    setsockopt(sock, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+    struct sockaddr_in source {};
+    source.sin_family = AF_INET;
+    source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + i % SOURCE_ADDRESSES);
+    if (bind(sock, (struct sockaddr*)&source, sizeof(source)) == -1 ||
+        connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) == -1) {
+      std::cout << "Idle connection " << i << " failed: " << strerror(errno)
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    sockets.push_back(sock);
+  }
+  return sockets;
+}
+
 void send_receive_data(size_t start_index, size_t end_index,
-                       size_t thread_index, uint64_t* _total_received) {
+                       size_t thread_index, const uint32_t* pages,
+                       uint64_t* _total_received, LatencyRecorder* latencies) {
   std::cout << "[" << thread_index << "] start_index: " << start_index
             << ", end_index: " << end_index << std::endl;
 
@@ -103,6 +142,16 @@ void send_receive_data(size_t start_index, size_t end_index,
 #endif
   size_t recv_req_num = 0;
   size_t send_req_num = 0;
+  // Responses come back in request order, so the n-th receive answers the
+  // n-th send.
+  std::vector<uint64_t> sent_ns(num_requests);
+#if ADAPTIVE_PIPELINE
+  static_assert(MAX_PIPELINE_DEPTH <= RING_SIZE / 2,
+                "a deeper pipeline does not fit the ring");
+  PipelineController pipeline(RING_SIZE / 4, MIN_PIPELINE_DEPTH,
+                              MAX_PIPELINE_DEPTH, LATENCY_SLO_US * 1000ull);
+  const uint64_t pipeline_start_ns = now_ns();
+#endif
 
   while (send_index < num_requests || recv_index < num_requests
          //         || iterations_received < num_requests || total_received <
@@ -111,7 +160,11 @@ void send_receive_data(size_t start_index, size_t end_index,
     // Submit send requests
     auto send_index_pre = send_index;
     while (send_index < num_requests &&
+#if ADAPTIVE_PIPELINE
+           send_index - iterations_received < pipeline.depth()) {
+#else
            send_index - recv_index < RING_SIZE / 4) {
+#endif
 #if VERBOSE
       std::cout << "[" << thread_index << "] send_index: " << send_index
                 << std::endl;
@@ -119,7 +172,7 @@ void send_receive_data(size_t start_index, size_t end_index,
 
       auto* request_data_send = (RequestData*)buffer_pool.allocate(
           sizeof(RequestData) + sizeof(int32_t));
-      request_data_send->buffer[0] = start_index + send_index;
+      request_data_send->buffer[0] = pages[start_index + send_index];
       request_data_send->seq[0] = thread_index;
       request_data_send->seq[1] = send_req_num++;
       request_data_send->event_type = SEND_EVENT;
@@ -129,6 +182,7 @@ void send_receive_data(size_t start_index, size_t end_index,
       io_uring_prep_send(sqe_send, sock, request_data_send->buffer,
                          sizeof(int32_t), 0);
       io_uring_sqe_set_data(sqe_send, request_data_send);
+      sent_ns[send_index] = now_ns();
 
       send_index++;
     }
@@ -237,6 +291,11 @@ void send_receive_data(size_t start_index, size_t end_index,
                   << " bytes. Total received: " << total_received
                   << ". Total expected: " << total_expected_received
                   << std::endl;
+#endif
+        const uint64_t now = now_ns();
+        latencies->record(now - sent_ns[iterations_received]);
+#if ADAPTIVE_PIPELINE
+        pipeline.on_completion(now - sent_ns[iterations_received], now);
 #endif
         iterations_received++;
         if (iterations_received % 10000 == 0) {
@@ -306,6 +365,13 @@ void send_receive_data(size_t start_index, size_t end_index,
             << std::endl;
   std::cout << "[" << thread_index << "] Total time: " << elapsed.count()
             << " s" << std::endl;
+#if ADAPTIVE_PIPELINE
+  std::cout << "[" << thread_index << "] Pipeline depth "
+            << pipeline.settled_depth() << " after " << pipeline.round_count()
+            << " rounds, settled after "
+            << pipeline.convergence_ns(pipeline_start_ns) / 1e6 << " ms"
+            << std::endl;
+#endif
   std::cout << "[" << thread_index << "] Average speed: "
             << it_per_second * PAGE_SIZE * sizeof(int32_t) * 8 / 1e9 << " Gbps"
             << std::endl;
@@ -323,9 +389,19 @@ void send_receive_data(size_t start_index, size_t end_index,
 int main() {
   size_t client_threads = CLIENT_THREADS;
   std::cout << "Starting " << client_threads << " client threads" << std::endl;
+  const std::vector<uint32_t> pages =
+      generate_keys(simple_key_distribution(), 0, NUM_REQUESTS);
+  std::cout << "Key distribution: " << KEY_DISTRIBUTION << std::endl;
+  raise_fd_limit();
+  const std::vector<int> idle_sockets = open_idle_connections(IDLE_CONNECTIONS);
+  if (!idle_sockets.empty()) {
+    std::cout << "Opened " << idle_sockets.size() << " idle connections"
+              << std::endl;
+  }
   auto start_time = std::chrono::high_resolution_clock::now();
 
   std::vector<uint64_t> total_received(client_threads, 0);
+  std::vector<LatencyRecorder> latencies(client_threads);
   std::vector<std::thread> threads;
   size_t requests_per_thread = NUM_REQUESTS / client_threads;
   for (size_t i = 0; i < client_threads; i++) {
@@ -336,7 +412,7 @@ int main() {
     std::cout << "Starting thread " << i << " for range " << start_index << " "
               << end_index << std::endl;
     threads.emplace_back(send_receive_data, start_index, end_index, i,
-                         &total_received[i]);
+                         pages.data(), &total_received[i], &latencies[i]);
   }
 
   for (auto& thread : threads) {
@@ -355,6 +431,14 @@ int main() {
   std::cout << "Average rate: " << std::fixed << std::setprecision(2)
             << avg_rate << " it/s" << std::endl;
   //  std::cout << "Average Gbps: " << avg_gbps << std::endl;
+  LatencyRecorder latency;
+  for (const auto& recorder : latencies) {
+    latency.merge(recorder);
+  }
+  std::cout << "Latency p50: " << latency.percentile_us(50)
+            << " us, p99: " << latency.percentile_us(99)
+            << " us, p99.9: " << latency.percentile_us(99.9) << " us"
+            << std::endl;
 
   uint64_t total_received_bytes = 0;
   for (size_t i = 0; i < client_threads; i++) {
@@ -370,5 +454,8 @@ int main() {
   //  std::cout << "Total received Gbps: " << total_received_gbps << std::endl;
   std::cout << "Average Gbps: " << total_received_gbps << std::endl;
 
+  for (const int sock : idle_sockets) {
+    close(sock);
+  }
   return 0;
 }
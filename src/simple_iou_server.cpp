@@ -7,17 +7,78 @@
 
 #include <liburing.h>
 #include <netinet/in.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 
 #include "buffer_pool.hpp"
+#include "connection_loop.hpp"
+#include "process_stats.hpp"
 #include "simple_consts.hpp"
+#include "tcp_stats.hpp"
+
+constexpr size_t RESPONSE_BUFFER_SIZE =
+    sizeof(RequestData) + PAGE_SIZE * sizeof(int32_t);
+
+// Response buffer bytes held by all connections, checked against
+// MEMORY_BUDGET.
+std::atomic<size_t> response_bytes_in_use{0};
+
+// Credits of one connection. Reads stop while the connection has
+// MAX_OUTSTANDING_SENDS responses in flight or the server is over its memory
+// budget, and resume as sends complete.
+struct FlowControl {
+  size_t outstanding = 0;
+  size_t peak_outstanding = 0;
+  size_t pauses = 0;
+
+  void acquire() {
+    outstanding++;
+    peak_outstanding = std::max(peak_outstanding, outstanding);
+#if MEMORY_BUDGET
+    response_bytes_in_use.fetch_add(RESPONSE_BUFFER_SIZE,
+                                    std::memory_order_relaxed);
+#endif
+  }
+
+  void release() {
+    outstanding--;
+#if MEMORY_BUDGET
+    response_bytes_in_use.fetch_sub(RESPONSE_BUFFER_SIZE,
+                                    std::memory_order_relaxed);
+#endif
+  }
+
+  [[nodiscard]] bool may_read() const {
+#if MAX_OUTSTANDING_SENDS
+    if (outstanding >= MAX_OUTSTANDING_SENDS) {
+      return false;
+    }
+#endif
+#if MEMORY_BUDGET
+    if (outstanding > 0 && response_bytes_in_use.load(
+                               std::memory_order_relaxed) >= MEMORY_BUDGET) {
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  void print(size_t client_num) const {
+    std::cout << "Client " << client_num << ": paused reads " << pauses
+              << " times, peak " << peak_outstanding << " responses in flight"
+              << std::endl;
+  }
+};
 
 void add_read_request(struct io_uring& ring, int client_socket, size_t seq1,
                       size_t seq2, RequestData* req) {
@@ -50,8 +111,14 @@ bool event_loop(struct io_uring& ring, int client_socket, size_t client_num) {
   std::vector buffer_sizes = {sizeof(RequestData) + PAGE_SIZE * sizeof(int32_t),
                               sizeof(RequestData) + sizeof(int32_t)};
   BufferPool buffer_pool(buffer_sizes, BUFFER_POOL_INITIAL_POOL_SIZE);
+#if HUGE_PAGES
+  std::cout << "Buffer arena on " << huge_page_mode_name(buffer_pool.arena_mode())
+            << std::endl;
+#endif
   size_t read_req_num = 0;
   size_t write_req_num = 0;
+  FlowControl flow;
+  std::vector<RequestData*> paused_reads;
   for (int i = 0; i < RING_SIZE / 4; i++) {
     auto* response = (RequestData*)buffer_pool.allocate(
         sizeof(RequestData) + PAGE_SIZE * sizeof(int32_t));
@@ -71,7 +138,15 @@ bool event_loop(struct io_uring& ring, int client_socket, size_t client_num) {
     switch (req->event_type) {
       case READ_EVENT: {
         if (cqe->res == 0) {
+          const TcpSegmentCounts segments = tcp_segment_counts(client_socket);
+          std::cout << "Client " << client_num << ": " << write_req_num
+                    << " pages in " << write_req_num << " sends and "
+                    << segments.segments_out << " segments" << std::endl;
+          flow.print(client_num);
           std::cout << "Client closed connection" << std::endl;
+          for (auto* paused : paused_reads) {
+            buffer_pool.deallocate((char*)paused, RESPONSE_BUFFER_SIZE);
+          }
           close(client_socket);
           return true;
         }
@@ -97,7 +172,14 @@ bool event_loop(struct io_uring& ring, int client_socket, size_t client_num) {
         }
         add_write_request(ring, client_socket, client_num, write_req_num++,
                           response);
-        add_read_request(ring, client_socket, client_num, read_req_num++, req);
+        flow.acquire();
+        if (flow.may_read()) {
+          add_read_request(ring, client_socket, client_num, read_req_num++,
+                           req);
+        } else {
+          paused_reads.push_back(req);
+          flow.pauses++;
+        }
         io_uring_submit(&ring);
         break;
       }
@@ -108,6 +190,14 @@ bool event_loop(struct io_uring& ring, int client_socket, size_t client_num) {
         // free(req->buffer);
         buffer_pool.deallocate(
             (char*)req, sizeof(RequestData) + PAGE_SIZE * sizeof(int32_t));
+        flow.release();
+        // Every completed send frees one credit, so resume one paused read.
+        if (!paused_reads.empty() && flow.may_read()) {
+          add_read_request(ring, client_socket, client_num, read_req_num++,
+                           paused_reads.back());
+          paused_reads.pop_back();
+          io_uring_submit(&ring);
+        }
         break;
       default:
         std::cout << "Unknown event type: " << req->event_type << std::endl;
@@ -118,6 +208,195 @@ bool event_loop(struct io_uring& ring, int client_socket, size_t client_num) {
   }
 }
 
+#if SEND_COALESCE
+// Pages produced while a sendmsg is in flight wait in `queued` and all go out
+// together in the next one.
+struct OutputQueue {
+  RequestData* marker;
+  std::vector<RequestData*> queued;
+  std::vector<RequestData*> sending;
+  std::vector<iovec> iov;
+  size_t iov_offset = 0;
+  msghdr msg{};
+  bool in_flight = false;
+  // Set when the client has already sent requests that this batch does not
+  // answer, so more responses follow it.
+  bool more_follows = false;
+  size_t pages = 0;
+  size_t sends = 0;
+};
+
+void add_batch_read_request(struct io_uring& ring, int client_socket,
+                            RequestData* req) {
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+  auto* buffer = reinterpret_cast<char*>(req->buffer);
+  io_uring_prep_recv(sqe, client_socket, buffer + req->buffer_offset,
+                     req->buffer_size - req->buffer_offset, 0);
+  io_uring_sqe_set_data(sqe, req);
+}
+
+void add_sendmsg_request(struct io_uring& ring, int client_socket,
+                         OutputQueue& out) {
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+  const size_t remaining = out.iov.size() - out.iov_offset;
+  out.msg.msg_iov = out.iov.data() + out.iov_offset;
+  out.msg.msg_iovlen = remaining < IOV_MAX ? remaining : IOV_MAX;
+  const int flags =
+      USE_MSG_MORE && (remaining > IOV_MAX || out.more_follows) ? MSG_MORE : 0;
+  io_uring_prep_sendmsg(sqe, client_socket, &out.msg, flags);
+  io_uring_sqe_set_data(sqe, out.marker);
+  out.in_flight = true;
+  out.sends++;
+}
+
+void start_send(struct io_uring& ring, int client_socket, OutputQueue& out) {
+  out.sending.swap(out.queued);
+  out.queued.clear();
+  out.iov.clear();
+  for (auto* response : out.sending) {
+    out.iov.push_back({response->buffer, PAGE_SIZE * sizeof(int32_t)});
+  }
+  out.iov_offset = 0;
+  out.pages += out.sending.size();
+  add_sendmsg_request(ring, client_socket, out);
+}
+
+// Returns true if at least one more page number waits in the socket.
+bool input_pending(int client_socket) {
+  int pending = 0;
+  return ioctl(client_socket, FIONREAD, &pending) == 0 &&
+         pending >= static_cast<int>(sizeof(int32_t));
+}
+
+// Returns true once the whole batch has been sent.
+bool advance_send(OutputQueue& out, size_t sent) {
+  while (sent > 0 && out.iov_offset < out.iov.size()) {
+    iovec& current = out.iov[out.iov_offset];
+    if (sent >= current.iov_len) {
+      sent -= current.iov_len;
+      out.iov_offset++;
+    } else {
+      current.iov_base = static_cast<char*>(current.iov_base) + sent;
+      current.iov_len -= sent;
+      sent = 0;
+    }
+  }
+  return out.iov_offset == out.iov.size();
+}
+
+// Like event_loop, but reads up to MAX_BATCH_PAGES page numbers at once and
+// answers everything from one completion batch with a single sendmsg.
+bool coalescing_event_loop(struct io_uring& ring, int client_socket,
+                           size_t client_num) {
+  std::vector buffer_sizes = {RESPONSE_BUFFER_SIZE};
+  BufferPool buffer_pool(buffer_sizes, BUFFER_POOL_INITIAL_POOL_SIZE);
+#if HUGE_PAGES
+  std::cout << "Buffer arena on " << huge_page_mode_name(buffer_pool.arena_mode())
+            << std::endl;
+#endif
+
+  const size_t read_size = MAX_BATCH_PAGES * sizeof(int32_t);
+  auto* read_req =
+      static_cast<RequestData*>(std::malloc(sizeof(RequestData) + read_size));
+  read_req->seq[0] = client_num;
+  read_req->event_type = READ_EVENT;
+  read_req->buffer_offset = 0;
+  read_req->buffer_size = read_size;
+  RequestData send_marker{};
+  send_marker.event_type = SEND_EVENT;
+
+  OutputQueue out;
+  out.marker = &send_marker;
+  FlowControl flow;
+  bool read_paused = false;
+  add_batch_read_request(ring, client_socket, read_req);
+  io_uring_submit(&ring);
+
+  bool closed = false;
+  while (!closed || out.in_flight) {
+    struct io_uring_cqe* cqe;
+    io_uring_wait_cqe(&ring, &cqe);
+
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&ring, head, cqe) {
+      count++;
+      auto* req = (RequestData*)io_uring_cqe_get_data(cqe);
+      if (req->event_type == READ_EVENT) {
+        if (cqe->res <= 0) {
+          if (cqe->res < 0) {
+            std::cout << "Read error: " << strerror(-cqe->res) << std::endl;
+          }
+          closed = true;
+          continue;
+        }
+        const size_t available = req->buffer_offset + cqe->res;
+        const size_t page_count = available / sizeof(int32_t);
+        for (size_t i = 0; i < page_count; ++i) {
+          int32_t page_number = req->buffer[i];
+#if VERBOSE
+          std::cout << "Requested page number: " << page_number << std::endl;
+#endif
+          auto* response =
+              (RequestData*)buffer_pool.allocate(RESPONSE_BUFFER_SIZE);
+          for (int j = 0; j < PAGE_SIZE; j++) {
+            response->buffer[j] = page_number;
+          }
+          out.queued.push_back(response);
+          flow.acquire();
+        }
+        // Keep a partially received page number for the next read.
+        req->buffer_offset = available % sizeof(int32_t);
+        memmove(req->buffer, req->buffer + page_count, req->buffer_offset);
+        if (flow.may_read()) {
+          add_batch_read_request(ring, client_socket, req);
+        } else {
+          read_paused = true;
+          flow.pauses++;
+        }
+      } else {
+        if (cqe->res < 0) {
+          std::cout << "Send error: " << strerror(-cqe->res) << std::endl;
+          return false;
+        }
+        if (!advance_send(out, cqe->res)) {
+          add_sendmsg_request(ring, client_socket, out);
+          continue;
+        }
+        for (auto* response : out.sending) {
+          buffer_pool.deallocate((char*)response, RESPONSE_BUFFER_SIZE);
+          flow.release();
+        }
+        out.sending.clear();
+        out.in_flight = false;
+        if (read_paused && !closed && flow.may_read()) {
+          read_paused = false;
+          add_batch_read_request(ring, client_socket, read_req);
+        }
+      }
+    }
+    io_uring_cq_advance(&ring, count);
+
+    if (!out.in_flight && !out.queued.empty()) {
+      out.more_follows = USE_MSG_MORE && !closed && !read_paused &&
+                         input_pending(client_socket);
+      start_send(ring, client_socket, out);
+    }
+    io_uring_submit(&ring);
+  }
+
+  const TcpSegmentCounts segments = tcp_segment_counts(client_socket);
+  std::cout << "Client " << client_num << ": " << out.pages << " pages in "
+            << out.sends << " sends and " << segments.segments_out
+            << " segments" << std::endl;
+  flow.print(client_num);
+  std::cout << "Client closed connection" << std::endl;
+  close(client_socket);
+  std::free(read_req);
+  return true;
+}
+#endif
+
 void handle_client(const int client_socket, size_t client_num,
                    std::atomic<int>& finished_threads) {
   std::cout << "Handling a new client" << std::endl;
@@ -127,13 +406,89 @@ void handle_client(const int client_socket, size_t client_num,
     std::cout << "io_uring_queue_init failed: " << strerror(-r) << std::endl;
     exit(EXIT_FAILURE);
   }
+#if SEND_COALESCE
+  if (!coalescing_event_loop(ring, client_socket, client_num)) {
+#else
   if (!event_loop(ring, client_socket, client_num)) {
+#endif
     exit(EXIT_FAILURE);
   }
   io_uring_queue_exit(&ring);
   finished_threads++;
 }
 
+#if EVENT_LOOPS
+template <typename Loop>
+void send_page(Loop& loop, const uint32_t slot, const uint8_t* request) {
+  int32_t page_number;
+  memcpy(&page_number, request, sizeof(int32_t));
+#if VERBOSE
+  std::cout << "Requested page number: " << page_number << std::endl;
+#endif
+  RequestData* response = loop.allocate_send();
+  for (int i = 0; i < PAGE_SIZE; i++) {
+    response->buffer[i] = page_number;
+  }
+  loop.send(slot, response, PAGE_SIZE * sizeof(int32_t));
+}
+
+// Answers every complete page number in `data`; a page number cut off by the
+// end of a receive waits in the connection for the rest.
+auto respond_to_pages = [](auto& loop, const uint32_t slot,
+                           const uint8_t* data, const size_t length) {
+  LoopConnection& connection = loop.connection(slot);
+  size_t offset = 0;
+  if (connection.partial_length > 0) {
+    offset = std::min(sizeof(int32_t) - connection.partial_length, length);
+    memcpy(connection.partial + connection.partial_length, data, offset);
+    connection.partial_length += offset;
+    if (connection.partial_length < sizeof(int32_t)) {
+      return;
+    }
+    send_page(loop, slot, connection.partial);
+    connection.partial_length = 0;
+  }
+  for (; offset + sizeof(int32_t) <= length; offset += sizeof(int32_t)) {
+    send_page(loop, slot, data + offset);
+  }
+  connection.partial_length = length - offset;
+  memcpy(connection.partial, data + offset, connection.partial_length);
+};
+
+using PageLoop = ConnectionLoop<decltype(respond_to_pages)>;
+
+// Serves every connection, active or idle, from EVENT_LOOPS threads and stops
+// once all CLIENT_THREADS + IDLE_CONNECTIONS of them have closed.
+void serve_with_event_loops(const int server_fd) {
+  raise_fd_limit();
+  LoopCounters counters;
+  std::vector<std::unique_ptr<PageLoop>> loops;
+  for (int i = 0; i < EVENT_LOOPS; i++) {
+    loops.push_back(std::make_unique<PageLoop>(
+        server_fd, PAGE_SIZE * sizeof(int32_t), counters, respond_to_pages));
+  }
+  ConnectionMemoryReport report;
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> threads;
+  for (auto& loop : loops) {
+    threads.emplace_back([&loop, &stop] { loop->run(stop); });
+  }
+
+  const size_t expected = CLIENT_THREADS + IDLE_CONNECTIONS;
+  while (counters.closed.load() < expected) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const size_t accepted = counters.accepted.load();
+    const size_t closed = counters.closed.load();
+    report.sample(accepted - closed, closed);
+  }
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  report.print_peak();
+}
+#endif
+
 int main() {
   int server_fd;
   sockaddr_in address{};
@@ -161,10 +516,15 @@ int main() {
 
   std::cout << "Server started. Listening on port " << PORT << std::endl;
 
+#if EVENT_LOOPS
+  serve_with_event_loops(server_fd);
+#else
+  raise_fd_limit();
+  ConnectionMemoryReport report;
   size_t client_num = 0;
   std::atomic<int> finished_threads = 0;
   while (true) {
-    if (client_num >= CLIENT_THREADS) {
+    if (client_num >= CLIENT_THREADS + IDLE_CONNECTIONS) {
       std::cout << "Max number of clients reached: " << client_num << std::endl;
       break;
     }
@@ -185,6 +545,9 @@ int main() {
   while (finished_threads < client_num) {
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     printf("Finished threads: %d\n", finished_threads.load());
+    report.sample(client_num - finished_threads, finished_threads);
   }
+  report.print_peak();
+#endif
   std::cout << "Server shutting down" << std::endl;
 }
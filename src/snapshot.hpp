@@ -0,0 +1,255 @@
+#pragma once
+
+#include <fcntl.h>
+#include <liburing.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "crc32c.hpp"
+
+// On-disk page store, laid out so that a single read-only mmap can serve it
+// in place. All fields are in host byte order; snapshots are not meant to
+// move between machines of different endianness.
+//
+//   0                 SnapshotHeader, padded to SNAPSHOT_ALIGNMENT
+//   index_offset      uint64_t page id per page, ascending (SNAPSHOT_SPARSE)
+//   checksum_offset   uint32_t CRC32C per page (SNAPSHOT_CHECKSUMS)
+//   data_offset       page_count pages of page_size bytes, aligned
+//
+// Dense snapshots have no index: page i is page number i.
+
+constexpr char SNAPSHOT_MAGIC[8] = {'F', 'N', 'S', 'N', 'A', 'P', 0, 1};
+constexpr uint32_t SNAPSHOT_FORMAT_VERSION = 1;
+constexpr size_t SNAPSHOT_ALIGNMENT = 4096;
+
+enum SnapshotFlags : uint32_t {
+  SNAPSHOT_CHECKSUMS = 1u << 0,
+  SNAPSHOT_SPARSE = 1u << 1,
+};
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t page_size;
+  uint64_t page_count;
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t index_offset;
+  uint64_t checksum_offset;
+  uint64_t data_offset;
+  uint64_t file_length;
+};
+
+// Validating view over a mapped snapshot file; nothing is copied.
+struct SnapshotView {
+  const SnapshotHeader* header;
+  const uint64_t* page_ids = nullptr;
+  const uint32_t* checksums = nullptr;
+  const uint8_t* pages;
+
+  SnapshotView(const uint8_t* file, const size_t length) {
+    if (length < sizeof(SnapshotHeader)) {
+      throw std::runtime_error("snapshot too short");
+    }
+    header = reinterpret_cast<const SnapshotHeader*>(file);
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header->format_version != SNAPSHOT_FORMAT_VERSION) {
+      throw std::runtime_error("not a snapshot of a supported version");
+    }
+    if (header->file_length != length || header->page_size == 0 ||
+        !fits(header->data_offset, header->page_count, header->page_size,
+              length)) {
+      throw std::runtime_error("snapshot truncated");
+    }
+    if (header->flags & SNAPSHOT_SPARSE) {
+      if (header->index_offset % alignof(uint64_t) != 0 ||
+          !fits(header->index_offset, header->page_count, sizeof(uint64_t),
+                length)) {
+        throw std::runtime_error("snapshot index out of bounds");
+      }
+      page_ids = reinterpret_cast<const uint64_t*>(file + header->index_offset);
+    }
+    if (header->flags & SNAPSHOT_CHECKSUMS) {
+      if (header->checksum_offset % alignof(uint32_t) != 0 ||
+          !fits(header->checksum_offset, header->page_count, sizeof(uint32_t),
+                length)) {
+        throw std::runtime_error("snapshot checksums out of bounds");
+      }
+      checksums =
+          reinterpret_cast<const uint32_t*>(file + header->checksum_offset);
+    }
+    pages = file + header->data_offset;
+  }
+
+  // Whether `count` elements of `size` bytes at `offset` lie within `length`
+  // bytes, without overflowing on hostile header values.
+  static bool fits(const uint64_t offset, const uint64_t count,
+                   const uint64_t size, const size_t length) {
+    return offset <= length && count <= (length - offset) / size;
+  }
+};
+
+// Writes `chunks` with up to SNAPSHOT_QUEUE_DEPTH writes in flight and
+// resubmits the rest of short writes.
+class SnapshotWriter {
+ public:
+  static constexpr unsigned SNAPSHOT_QUEUE_DEPTH = 64;
+  static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+  explicit SnapshotWriter(const int fd) : fd(fd) {
+    const int r = io_uring_queue_init(SNAPSHOT_QUEUE_DEPTH, &ring, 0);
+    if (r < 0) {
+      throw std::runtime_error(std::string("io_uring_queue_init: ") +
+                               strerror(-r));
+    }
+  }
+
+  SnapshotWriter(const SnapshotWriter&) = delete;
+  SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+  ~SnapshotWriter() { io_uring_queue_exit(&ring); }
+
+  // Queues `length` bytes for `offset`; nothing is written before flush().
+  void add(const void* data, size_t length, uint64_t offset) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+      const size_t piece = std::min(length, CHUNK_SIZE);
+      chunks.push_back({bytes, piece, offset});
+      bytes += piece;
+      offset += piece;
+      length -= piece;
+    }
+  }
+
+  void flush() {
+    size_t next = 0;
+    size_t in_flight = 0;
+    while (next < chunks.size() || in_flight > 0) {
+      while (next < chunks.size() && in_flight < SNAPSHOT_QUEUE_DEPTH) {
+        prep_chunk(chunks[next++]);
+        in_flight++;
+      }
+      io_uring_submit(&ring);
+      struct io_uring_cqe* cqe;
+      const int r = io_uring_wait_cqe(&ring, &cqe);
+      if (r < 0) {
+        throw std::runtime_error(std::string("io_uring_wait_cqe: ") +
+                                 strerror(-r));
+      }
+      auto* chunk = static_cast<Chunk*>(io_uring_cqe_get_data(cqe));
+      const int written = cqe->res;
+      io_uring_cqe_seen(&ring, cqe);
+      in_flight--;
+      if (written <= 0) {
+        throw std::runtime_error(std::string("snapshot write failed: ") +
+                                 strerror(written == 0 ? EIO : -written));
+      }
+      if (static_cast<size_t>(written) < chunk->length) {
+        chunk->data += written;
+        chunk->length -= written;
+        chunk->offset += written;
+        prep_chunk(*chunk);
+        in_flight++;
+      }
+    }
+    chunks.clear();
+  }
+
+  void sync() {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_fsync(sqe, fd, 0);
+    io_uring_sqe_set_data(sqe, nullptr);
+    io_uring_submit(&ring);
+    struct io_uring_cqe* cqe;
+    if (io_uring_wait_cqe(&ring, &cqe) < 0 || cqe->res < 0) {
+      throw std::runtime_error("snapshot fsync failed");
+    }
+    io_uring_cqe_seen(&ring, cqe);
+  }
+
+ private:
+  struct Chunk {
+    const uint8_t* data;
+    size_t length;
+    uint64_t offset;
+  };
+
+  void prep_chunk(Chunk& chunk) {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_write(sqe, fd, chunk.data,
+                        static_cast<unsigned>(chunk.length), chunk.offset);
+    io_uring_sqe_set_data(sqe, &chunk);
+  }
+
+  int fd;
+  struct io_uring ring {};
+  std::vector<Chunk> chunks;
+};
+
+// Writes `page_count` pages of `page_size` bytes to `path`. `page_ids` is
+// null for dense stores, otherwise it holds the ascending id of every page.
+// The header goes out last and only after the rest is on disk, so an
+// interrupted write never leaves a file that loads.
+inline void write_snapshot(const std::string& path, const uint32_t page_size,
+                           const uint64_t page_count, const uint8_t* pages,
+                           const uint64_t* page_ids, const bool checksums) {
+  SnapshotHeader header{};
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.format_version = SNAPSHOT_FORMAT_VERSION;
+  header.page_size = page_size;
+  header.page_count = page_count;
+  uint64_t offset = SNAPSHOT_ALIGNMENT;
+  if (page_ids != nullptr) {
+    header.flags |= SNAPSHOT_SPARSE;
+    header.index_offset = offset;
+    offset += page_count * sizeof(uint64_t);
+  }
+  std::vector<uint32_t> crcs;
+  if (checksums) {
+    header.flags |= SNAPSHOT_CHECKSUMS;
+    header.checksum_offset = offset;
+    offset += page_count * sizeof(uint32_t);
+    crcs.resize(page_count);
+    for (uint64_t i = 0; i < page_count; ++i) {
+      crcs[i] = crc32c(pages + i * page_size, page_size);
+    }
+  }
+  header.data_offset =
+      (offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+  header.file_length = header.data_offset + page_count * page_size;
+
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("cannot create " + path + ": " + strerror(errno));
+  }
+  if (ftruncate(fd, static_cast<off_t>(header.file_length)) < 0) {
+    close(fd);
+    throw std::runtime_error("cannot size " + path + ": " + strerror(errno));
+  }
+  try {
+    SnapshotWriter writer(fd);
+    if (page_ids != nullptr) {
+      writer.add(page_ids, page_count * sizeof(uint64_t), header.index_offset);
+    }
+    if (checksums) {
+      writer.add(crcs.data(), crcs.size() * sizeof(uint32_t),
+                 header.checksum_offset);
+    }
+    writer.add(pages, page_count * page_size, header.data_offset);
+    writer.flush();
+    writer.sync();
+    writer.add(&header, sizeof(header), 0);
+    writer.flush();
+    writer.sync();
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+}
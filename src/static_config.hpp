@@ -16,6 +16,74 @@ class Config {
   static std::string logging_level;
   static size_t page_count;
   static size_t client_threads;
+  static size_t reactor_threads;
+  static bool coalesce;
+  static size_t coalesce_window_us;
+  static size_t multi_get_size;
+  static size_t write_percent;
+  static bool compression;
+  static bool checksums;
+  static size_t udp_window;
+  static size_t udp_retry_timeout_us;
+  static bool udp_gso;
+  static std::string unix_socket;
+  static std::string shm_socket;
+  static size_t shm_ring_size;
+  static size_t shm_spin_us;
+  static std::string wait_strategy;
+  static size_t max_spin_us;
+  static size_t busy_poll_us;
+  static bool napi;
+  static size_t sq_thread_idle_ms;
+  static bool msg_more;
+  static size_t max_outstanding_responses;
+  static size_t memory_budget_bytes;
+  static size_t drr_quantum_bytes;
+  static size_t priority;
+  static size_t pipeline_depth;
+  static bool tls;
+  static std::string tls_ca;
+  static std::string tls_cert;
+  static std::string tls_key;
+  static std::string tls_server_name;
+  static bool huge_pages;
+  static std::string fill_mode;
+  static size_t fill_threads;
+  static std::string snapshot;
+  static std::string fill_strategy;
+  static bool sparse;
+  static std::string key_distribution;
+  static double zipf_theta;
+  static double hotspot_fraction;
+  static double hotspot_probability;
+  static size_t scan_length;
+  static std::string trace;
+  static std::string replay_trace;
+  static double replay_speed;
+  static bool partition_pages;
+  static bool pin_reactors;
+  static size_t stream_chunk_bytes;
+  static bool stream_zerocopy;
+  static size_t stream_pages;
+  static size_t pause_every_ms;
+  static size_t pause_ms;
+  static size_t deadline_us;
+  static std::string endpoints;
+  static double hedge_percentile;
+  static size_t hedge_delay_us;
+  static bool sharding;
+  static std::string replicas;
+  static bool read_balancing;
+  static size_t proxy_port;
+  static size_t proxy_threads;
+  static size_t proxy_delay_us;
+  static size_t proxy_jitter_us;
+  static double proxy_bandwidth_mbps;
+  static double proxy_loss_percent;
+  static double proxy_reset_percent;
+  static size_t proxy_rto_us;
+  static size_t proxy_buffer_bytes;
+  static size_t replica_backlog_bytes;
 
   static void load_config(const std::string& env_file_path) {
     std::ifstream env_file(env_file_path.data());
@@ -34,6 +102,74 @@ class Config {
     logging_level = get_env_var("LOGGING_LEVEL", logging_level);
     page_count = std::stoul(get_env_var("PAGE_COUNT", std::to_string(page_count)));
     client_threads = std::stoul(get_env_var("CLIENT_THREADS", std::to_string(client_threads)));
+    reactor_threads = std::stoul(get_env_var("REACTOR_THREADS", std::to_string(reactor_threads)));
+    coalesce = std::stoul(get_env_var("COALESCE", std::to_string(coalesce))) != 0;
+    coalesce_window_us = std::stoul(get_env_var("COALESCE_WINDOW_US", std::to_string(coalesce_window_us)));
+    multi_get_size = std::stoul(get_env_var("MULTI_GET_SIZE", std::to_string(multi_get_size)));
+    write_percent = std::stoul(get_env_var("WRITE_PERCENT", std::to_string(write_percent)));
+    compression = std::stoul(get_env_var("COMPRESSION", std::to_string(compression))) != 0;
+    checksums = std::stoul(get_env_var("CHECKSUMS", std::to_string(checksums))) != 0;
+    udp_window = std::stoul(get_env_var("UDP_WINDOW", std::to_string(udp_window)));
+    udp_retry_timeout_us = std::stoul(get_env_var("UDP_RETRY_TIMEOUT_US", std::to_string(udp_retry_timeout_us)));
+    udp_gso = std::stoul(get_env_var("UDP_GSO", std::to_string(udp_gso))) != 0;
+    unix_socket = get_env_var("UNIX_SOCKET", unix_socket);
+    shm_socket = get_env_var("SHM_SOCKET", shm_socket);
+    shm_ring_size = std::stoul(get_env_var("SHM_RING_SIZE", std::to_string(shm_ring_size)));
+    shm_spin_us = std::stoul(get_env_var("SHM_SPIN_US", std::to_string(shm_spin_us)));
+    wait_strategy = get_env_var("WAIT_STRATEGY", wait_strategy);
+    max_spin_us = std::stoul(get_env_var("MAX_SPIN_US", std::to_string(max_spin_us)));
+    busy_poll_us = std::stoul(get_env_var("BUSY_POLL_US", std::to_string(busy_poll_us)));
+    napi = std::stoul(get_env_var("NAPI", std::to_string(napi))) != 0;
+    sq_thread_idle_ms = std::stoul(get_env_var("SQ_THREAD_IDLE_MS", std::to_string(sq_thread_idle_ms)));
+    msg_more = std::stoul(get_env_var("MSG_MORE", std::to_string(msg_more))) != 0;
+    max_outstanding_responses = std::stoul(get_env_var("MAX_OUTSTANDING_RESPONSES", std::to_string(max_outstanding_responses)));
+    memory_budget_bytes = std::stoul(get_env_var("MEMORY_BUDGET_BYTES", std::to_string(memory_budget_bytes)));
+    drr_quantum_bytes = std::stoul(get_env_var("DRR_QUANTUM_BYTES", std::to_string(drr_quantum_bytes)));
+    priority = std::stoul(get_env_var("PRIORITY", std::to_string(priority)));
+    pipeline_depth = std::stoul(get_env_var("PIPELINE_DEPTH", std::to_string(pipeline_depth)));
+    tls = std::stoul(get_env_var("TLS", std::to_string(tls))) != 0;
+    tls_ca = get_env_var("TLS_CA", tls_ca);
+    tls_cert = get_env_var("TLS_CERT", tls_cert);
+    tls_key = get_env_var("TLS_KEY", tls_key);
+    tls_server_name = get_env_var("TLS_SERVER_NAME", tls_server_name);
+    huge_pages = std::stoul(get_env_var("HUGE_PAGES", std::to_string(huge_pages))) != 0;
+    fill_mode = get_env_var("FILL_MODE", fill_mode);
+    fill_threads = std::stoul(get_env_var("FILL_THREADS", std::to_string(fill_threads)));
+    snapshot = get_env_var("SNAPSHOT", snapshot);
+    fill_strategy = get_env_var("FILL_STRATEGY", fill_strategy);
+    sparse = std::stoul(get_env_var("SPARSE", std::to_string(sparse))) != 0;
+    key_distribution = get_env_var("KEY_DISTRIBUTION", key_distribution);
+    zipf_theta = std::stod(get_env_var("ZIPF_THETA", std::to_string(zipf_theta)));
+    hotspot_fraction = std::stod(get_env_var("HOTSPOT_FRACTION", std::to_string(hotspot_fraction)));
+    hotspot_probability = std::stod(get_env_var("HOTSPOT_PROBABILITY", std::to_string(hotspot_probability)));
+    scan_length = std::stoul(get_env_var("SCAN_LENGTH", std::to_string(scan_length)));
+    trace = get_env_var("TRACE", trace);
+    replay_trace = get_env_var("REPLAY_TRACE", replay_trace);
+    replay_speed = std::stod(get_env_var("REPLAY_SPEED", std::to_string(replay_speed)));
+    partition_pages = std::stoul(get_env_var("PARTITION_PAGES", std::to_string(partition_pages))) != 0;
+    pin_reactors = std::stoul(get_env_var("PIN_REACTORS", std::to_string(pin_reactors))) != 0;
+    stream_chunk_bytes = std::stoul(get_env_var("STREAM_CHUNK_BYTES", std::to_string(stream_chunk_bytes)));
+    stream_zerocopy = std::stoul(get_env_var("STREAM_ZEROCOPY", std::to_string(stream_zerocopy))) != 0;
+    stream_pages = std::stoul(get_env_var("STREAM_PAGES", std::to_string(stream_pages)));
+    pause_every_ms = std::stoul(get_env_var("PAUSE_EVERY_MS", std::to_string(pause_every_ms)));
+    pause_ms = std::stoul(get_env_var("PAUSE_MS", std::to_string(pause_ms)));
+    deadline_us = std::stoul(get_env_var("DEADLINE_US", std::to_string(deadline_us)));
+    endpoints = get_env_var("ENDPOINTS", endpoints);
+    hedge_percentile = std::stod(get_env_var("HEDGE_PERCENTILE", std::to_string(hedge_percentile)));
+    hedge_delay_us = std::stoul(get_env_var("HEDGE_DELAY_US", std::to_string(hedge_delay_us)));
+    sharding = std::stoul(get_env_var("SHARDING", std::to_string(sharding))) != 0;
+    replicas = get_env_var("REPLICAS", replicas);
+    read_balancing = std::stoul(get_env_var("READ_BALANCING", std::to_string(read_balancing))) != 0;
+    proxy_port = std::stoul(get_env_var("PROXY_PORT", std::to_string(proxy_port)));
+    proxy_threads = std::stoul(get_env_var("PROXY_THREADS", std::to_string(proxy_threads)));
+    proxy_delay_us = std::stoul(get_env_var("PROXY_DELAY_US", std::to_string(proxy_delay_us)));
+    proxy_jitter_us = std::stoul(get_env_var("PROXY_JITTER_US", std::to_string(proxy_jitter_us)));
+    proxy_bandwidth_mbps = std::stod(get_env_var("PROXY_BANDWIDTH_MBPS", std::to_string(proxy_bandwidth_mbps)));
+    proxy_loss_percent = std::stod(get_env_var("PROXY_LOSS_PERCENT", std::to_string(proxy_loss_percent)));
+    proxy_reset_percent = std::stod(get_env_var("PROXY_RESET_PERCENT", std::to_string(proxy_reset_percent)));
+    proxy_rto_us = std::stoul(get_env_var("PROXY_RTO_US", std::to_string(proxy_rto_us)));
+    proxy_buffer_bytes = std::stoul(get_env_var("PROXY_BUFFER_BYTES", std::to_string(proxy_buffer_bytes)));
+    replica_backlog_bytes = std::stoul(get_env_var("REPLICA_BACKLOG_BYTES", std::to_string(replica_backlog_bytes)));
 
     set_logging_level();
 
@@ -73,6 +209,142 @@ class Config {
         page_count = std::stoul(value);
       } else if (key == "CLIENT_THREADS") {
         client_threads = std::stoul(value);
+      } else if (key == "REACTOR_THREADS") {
+        reactor_threads = std::stoul(value);
+      } else if (key == "COALESCE") {
+        coalesce = std::stoul(value) != 0;
+      } else if (key == "COALESCE_WINDOW_US") {
+        coalesce_window_us = std::stoul(value);
+      } else if (key == "MULTI_GET_SIZE") {
+        multi_get_size = std::stoul(value);
+      } else if (key == "WRITE_PERCENT") {
+        write_percent = std::stoul(value);
+      } else if (key == "COMPRESSION") {
+        compression = std::stoul(value) != 0;
+      } else if (key == "CHECKSUMS") {
+        checksums = std::stoul(value) != 0;
+      } else if (key == "UDP_WINDOW") {
+        udp_window = std::stoul(value);
+      } else if (key == "UDP_RETRY_TIMEOUT_US") {
+        udp_retry_timeout_us = std::stoul(value);
+      } else if (key == "UDP_GSO") {
+        udp_gso = std::stoul(value) != 0;
+      } else if (key == "UNIX_SOCKET") {
+        unix_socket = value;
+      } else if (key == "SHM_SOCKET") {
+        shm_socket = value;
+      } else if (key == "SHM_RING_SIZE") {
+        shm_ring_size = std::stoul(value);
+      } else if (key == "SHM_SPIN_US") {
+        shm_spin_us = std::stoul(value);
+      } else if (key == "WAIT_STRATEGY") {
+        wait_strategy = value;
+      } else if (key == "MAX_SPIN_US") {
+        max_spin_us = std::stoul(value);
+      } else if (key == "BUSY_POLL_US") {
+        busy_poll_us = std::stoul(value);
+      } else if (key == "NAPI") {
+        napi = std::stoul(value) != 0;
+      } else if (key == "SQ_THREAD_IDLE_MS") {
+        sq_thread_idle_ms = std::stoul(value);
+      } else if (key == "MSG_MORE") {
+        msg_more = std::stoul(value) != 0;
+      } else if (key == "MAX_OUTSTANDING_RESPONSES") {
+        max_outstanding_responses = std::stoul(value);
+      } else if (key == "MEMORY_BUDGET_BYTES") {
+        memory_budget_bytes = std::stoul(value);
+      } else if (key == "DRR_QUANTUM_BYTES") {
+        drr_quantum_bytes = std::stoul(value);
+      } else if (key == "PRIORITY") {
+        priority = std::stoul(value);
+      } else if (key == "PIPELINE_DEPTH") {
+        pipeline_depth = std::stoul(value);
+      } else if (key == "TLS") {
+        tls = std::stoul(value) != 0;
+      } else if (key == "TLS_CA") {
+        tls_ca = value;
+      } else if (key == "TLS_CERT") {
+        tls_cert = value;
+      } else if (key == "TLS_KEY") {
+        tls_key = value;
+      } else if (key == "TLS_SERVER_NAME") {
+        tls_server_name = value;
+      } else if (key == "HUGE_PAGES") {
+        huge_pages = std::stoul(value) != 0;
+      } else if (key == "FILL_MODE") {
+        fill_mode = value;
+      } else if (key == "FILL_THREADS") {
+        fill_threads = std::stoul(value);
+      } else if (key == "SNAPSHOT") {
+        snapshot = value;
+      } else if (key == "FILL_STRATEGY") {
+        fill_strategy = value;
+      } else if (key == "SPARSE") {
+        sparse = std::stoul(value) != 0;
+      } else if (key == "KEY_DISTRIBUTION") {
+        key_distribution = value;
+      } else if (key == "ZIPF_THETA") {
+        zipf_theta = std::stod(value);
+      } else if (key == "HOTSPOT_FRACTION") {
+        hotspot_fraction = std::stod(value);
+      } else if (key == "HOTSPOT_PROBABILITY") {
+        hotspot_probability = std::stod(value);
+      } else if (key == "SCAN_LENGTH") {
+        scan_length = std::stoul(value);
+      } else if (key == "TRACE") {
+        trace = value;
+      } else if (key == "REPLAY_TRACE") {
+        replay_trace = value;
+      } else if (key == "REPLAY_SPEED") {
+        replay_speed = std::stod(value);
+      } else if (key == "PARTITION_PAGES") {
+        partition_pages = std::stoul(value) != 0;
+      } else if (key == "PIN_REACTORS") {
+        pin_reactors = std::stoul(value) != 0;
+      } else if (key == "STREAM_CHUNK_BYTES") {
+        stream_chunk_bytes = std::stoul(value);
+      } else if (key == "STREAM_ZEROCOPY") {
+        stream_zerocopy = std::stoul(value) != 0;
+      } else if (key == "STREAM_PAGES") {
+        stream_pages = std::stoul(value);
+      } else if (key == "PAUSE_EVERY_MS") {
+        pause_every_ms = std::stoul(value);
+      } else if (key == "PAUSE_MS") {
+        pause_ms = std::stoul(value);
+      } else if (key == "DEADLINE_US") {
+        deadline_us = std::stoul(value);
+      } else if (key == "ENDPOINTS") {
+        endpoints = value;
+      } else if (key == "HEDGE_PERCENTILE") {
+        hedge_percentile = std::stod(value);
+      } else if (key == "HEDGE_DELAY_US") {
+        hedge_delay_us = std::stoul(value);
+      } else if (key == "SHARDING") {
+        sharding = std::stoul(value) != 0;
+      } else if (key == "REPLICAS") {
+        replicas = value;
+      } else if (key == "READ_BALANCING") {
+        read_balancing = std::stoul(value) != 0;
+      } else if (key == "PROXY_PORT") {
+        proxy_port = std::stoul(value);
+      } else if (key == "PROXY_THREADS") {
+        proxy_threads = std::stoul(value);
+      } else if (key == "PROXY_DELAY_US") {
+        proxy_delay_us = std::stoul(value);
+      } else if (key == "PROXY_JITTER_US") {
+        proxy_jitter_us = std::stoul(value);
+      } else if (key == "PROXY_BANDWIDTH_MBPS") {
+        proxy_bandwidth_mbps = std::stod(value);
+      } else if (key == "PROXY_LOSS_PERCENT") {
+        proxy_loss_percent = std::stod(value);
+      } else if (key == "PROXY_RESET_PERCENT") {
+        proxy_reset_percent = std::stod(value);
+      } else if (key == "PROXY_RTO_US") {
+        proxy_rto_us = std::stoul(value);
+      } else if (key == "PROXY_BUFFER_BYTES") {
+        proxy_buffer_bytes = std::stoul(value);
+      } else if (key == "REPLICA_BACKLOG_BYTES") {
+        replica_backlog_bytes = std::stoul(value);
       } else {
         spdlog::warn("Unknown key '{}'.", key);
       }
@@ -110,4 +382,72 @@ in_port_t Config::port = 8888;
 size_t Config::num_requests = 10;
 std::string Config::logging_level = "DEBUG";
 size_t Config::page_count = 1024;
-size_t Config::client_threads = 4;
\ No newline at end of file
+size_t Config::client_threads = 4;
+size_t Config::reactor_threads = 1;
+bool Config::coalesce = false;
+size_t Config::coalesce_window_us = 0;
+size_t Config::multi_get_size = 1;
+size_t Config::write_percent = 0;
+bool Config::compression = false;
+bool Config::checksums = false;
+size_t Config::udp_window = 64;
+size_t Config::udp_retry_timeout_us = 2000;
+bool Config::udp_gso = true;
+std::string Config::unix_socket = "";
+std::string Config::shm_socket = "/tmp/page_server.shm";
+size_t Config::shm_ring_size = 1024;
+size_t Config::shm_spin_us = 50;
+std::string Config::wait_strategy = "block";
+size_t Config::max_spin_us = 50;
+size_t Config::busy_poll_us = 0;
+bool Config::napi = false;
+size_t Config::sq_thread_idle_ms = 10000;
+bool Config::msg_more = false;
+size_t Config::max_outstanding_responses = 4096;
+size_t Config::memory_budget_bytes = 0;
+size_t Config::drr_quantum_bytes = 0;
+size_t Config::priority = 0;
+size_t Config::pipeline_depth = 64;
+bool Config::tls = false;
+std::string Config::tls_ca = "certs/ca.crt";
+std::string Config::tls_cert = "certs/server.crt";
+std::string Config::tls_key = "certs/server.key";
+std::string Config::tls_server_name = "localhost";
+bool Config::huge_pages = true;
+std::string Config::fill_mode = "parallel";
+size_t Config::fill_threads = 0;
+std::string Config::snapshot = "";
+std::string Config::fill_strategy = "pseudo_random";
+bool Config::sparse = false;
+std::string Config::key_distribution = "sequential";
+double Config::zipf_theta = 0.99;
+double Config::hotspot_fraction = 0.2;
+double Config::hotspot_probability = 0.8;
+size_t Config::scan_length = 64;
+std::string Config::trace = "";
+std::string Config::replay_trace = "";
+double Config::replay_speed = 1.0;
+bool Config::partition_pages = false;
+bool Config::pin_reactors = false;
+size_t Config::stream_chunk_bytes = 1048576;
+bool Config::stream_zerocopy = true;
+size_t Config::stream_pages = 0;
+size_t Config::pause_every_ms = 0;
+size_t Config::pause_ms = 0;
+size_t Config::deadline_us = 0;
+std::string Config::endpoints = "";
+double Config::hedge_percentile = 0;
+size_t Config::hedge_delay_us = 1000;
+bool Config::sharding = false;
+std::string Config::replicas = "";
+bool Config::read_balancing = false;
+size_t Config::proxy_port = 12350;
+size_t Config::proxy_threads = 1;
+size_t Config::proxy_delay_us = 0;
+size_t Config::proxy_jitter_us = 0;
+double Config::proxy_bandwidth_mbps = 0;
+double Config::proxy_loss_percent = 0;
+double Config::proxy_reset_percent = 0;
+size_t Config::proxy_rto_us = 200000;
+size_t Config::proxy_buffer_bytes = 4194304;
+size_t Config::replica_backlog_bytes = 67108864;
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+
+// Segments sent and received on a TCP socket, 0 if the kernel does not report
+// them. glibc's tcp_info ends before these counters, but the kernel's layout
+// is fixed: they follow the four 64-bit fields after tcpi_total_retrans.
+struct TcpSegmentCounts {
+  uint32_t segments_out = 0;
+  uint32_t segments_in = 0;
+};
+
+inline TcpSegmentCounts tcp_segment_counts(const int fd) {
+  constexpr size_t SEGMENTS_OFFSET = sizeof(struct tcp_info) + 4 * 8;
+  uint8_t info[SEGMENTS_OFFSET + 2 * sizeof(uint32_t)]{};
+  socklen_t length = sizeof(info);
+  TcpSegmentCounts counts;
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, info, &length) == 0 &&
+      length >= sizeof(info)) {
+    memcpy(&counts.segments_out, info + SEGMENTS_OFFSET, sizeof(uint32_t));
+    memcpy(&counts.segments_in, info + SEGMENTS_OFFSET + sizeof(uint32_t),
+           sizeof(uint32_t));
+  }
+  return counts;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "latency_recorder.hpp"
+
+// Request traces recorded by server_iou and replayed by client_iou. A trace
+// is a TraceHeader followed by fixed-size records in host byte order. Each
+// reactor appends whole chunks of records at offsets it reserves, so records
+// are ordered within a chunk but chunks of different reactors interleave;
+// readers sort by time. A chunk that was reserved but never written reads
+// as zeros, which no record can be (request types start at 1).
+
+constexpr char TRACE_MAGIC[8] = {'F', 'N', 'T', 'R', 'A', 'C', 'E', 1};
+constexpr uint32_t TRACE_FORMAT_VERSION = 3;
+
+struct TraceHeader {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t record_size;
+  // Wall clock when recording started; record times are relative to it.
+  uint64_t start_unix_ns;
+  uint64_t reserved;
+};
+
+// One page requested by a client. Multi-gets produce a record per page, and
+// lookups by id record the 64-bit id as sent, so a replay asks for the same
+// ids whatever they resolve to.
+struct TraceRecord {
+  uint64_t time_ns;
+  // Page number, or page id for GET_PAGE_BY_ID.
+  uint64_t page;
+  // Connection id within its reactor; with `reactor`, names one client stream.
+  uint32_t connection;
+  uint8_t reactor;
+  uint8_t type;  // RequestType
+  uint16_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 24);
+
+// The trace being written, shared by all reactors.
+class TraceFile {
+ public:
+  explicit TraceFile(const std::string& path) : start_ns(now_ns()) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("cannot create " + path + ": " +
+                               strerror(errno));
+    }
+    TraceHeader header{};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.format_version = TRACE_FORMAT_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.start_unix_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    if (pwrite(fd, &header, sizeof(header), 0) !=
+        static_cast<ssize_t>(sizeof(header))) {
+      close(fd);
+      throw std::runtime_error("cannot write " + path);
+    }
+  }
+
+  TraceFile(const TraceFile&) = delete;
+  TraceFile& operator=(const TraceFile&) = delete;
+
+  ~TraceFile() { close(fd); }
+
+  // File offset for `bytes` more bytes of records.
+  uint64_t reserve(const size_t bytes) {
+    return next_offset.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Trace time of `ns`, a now_ns() reading.
+  [[nodiscard]] uint64_t since_start(const uint64_t ns) const {
+    return ns - start_ns;
+  }
+
+  [[nodiscard]] int get_fd() const { return fd; }
+
+  [[nodiscard]] uint64_t bytes() const {
+    return next_offset.load(std::memory_order_relaxed);
+  }
+
+ private:
+  int fd;
+  uint64_t start_ns;
+  std::atomic<uint64_t> next_offset{sizeof(TraceHeader)};
+};
+
+// A reactor's batch of records on its way to the file.
+class TraceChunk {
+ public:
+  static constexpr size_t CAPACITY = 64 * 1024;
+
+  TraceChunk() : records(new TraceRecord[CAPACITY]) {}
+
+  void append(const TraceRecord& record) { records[count++] = record; }
+
+  [[nodiscard]] bool full() const { return count == CAPACITY; }
+  [[nodiscard]] bool empty() const { return count == 0; }
+
+  // The not yet written part of the chunk and its file offset.
+  [[nodiscard]] const uint8_t* pending_data() const {
+    return reinterpret_cast<const uint8_t*>(records.get()) + written;
+  }
+  [[nodiscard]] size_t pending_bytes() const {
+    return count * sizeof(TraceRecord) - written;
+  }
+  [[nodiscard]] uint64_t pending_offset() const { return offset + written; }
+
+  void start_write(const uint64_t file_offset) {
+    offset = file_offset;
+    written = 0;
+  }
+
+  // Returns true once the whole chunk is on its way to the page cache.
+  bool advance(const size_t bytes) {
+    written += bytes;
+    return pending_bytes() == 0;
+  }
+
+  void reset() {
+    count = 0;
+    written = 0;
+  }
+
+ private:
+  std::unique_ptr<TraceRecord[]> records;
+  size_t count = 0;
+  uint64_t offset = 0;
+  size_t written = 0;
+};
+
+// Reads a whole trace, sorted by time.
+inline std::vector<TraceRecord> load_trace(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  TraceHeader header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+      header.format_version != TRACE_FORMAT_VERSION ||
+      header.record_size != sizeof(TraceRecord)) {
+    throw std::runtime_error(path + " is not a trace of a supported version");
+  }
+  std::vector<TraceRecord> records;
+  TraceRecord record{};
+  while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+    if (record.type != 0) {
+      records.push_back(record);
+    }
+  }
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord& a, const TraceRecord& b) {
+                     return a.time_ns < b.time_ns;
+                   });
+  return records;
+}
@@ -0,0 +1,314 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "key_distribution.hpp"
+#include "latency_recorder.hpp"
+#include "memory_block.hpp"
+#include "models/get_page.hpp"
+#include "models/udp.hpp"
+#include "spdlog/spdlog.h"
+#include "static_config.hpp"
+#include "utils.hpp"
+
+constexpr size_t UDP_BATCH = 64;
+
+struct PendingRequest {
+  uint64_t first_sent_ns;
+  uint64_t sent_ns;
+  uint64_t fragments_received;
+  size_t fragment_count;
+};
+
+struct UdpClientStats {
+  size_t completed = 0;
+  size_t retries = 0;
+  size_t duplicates = 0;
+  size_t datagrams = 0;
+  size_t wire_bytes = 0;
+  LatencyRecorder latency;
+};
+
+int setup_udp_socket(const char* addr, const int port) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock == -1) {
+    spdlog::error("Socket creation failed");
+    return -1;
+  }
+  int buffer_size = 8 * 1024 * 1024;
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+  sockaddr_in serv_addr{};
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(port);
+  inet_pton(AF_INET, addr, &serv_addr.sin_addr);
+  if (connect(sock, reinterpret_cast<sockaddr*>(&serv_addr),
+              sizeof(serv_addr)) == -1) {
+    spdlog::error("Connect failed");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// Sends the GET_PAGE requests for `ids` with as few syscalls as possible.
+// `keys` holds the page of every slot from `start` on.
+void send_requests(const int sock, const std::vector<uint32_t>& ids,
+                   const std::vector<uint32_t>& keys, const size_t start) {
+  std::array<GetPageRequest, UDP_BATCH> requests{};
+  std::array<iovec, UDP_BATCH> iov{};
+  std::array<mmsghdr, UDP_BATCH> messages{};
+
+  for (size_t offset = 0; offset < ids.size(); offset += UDP_BATCH) {
+    const size_t count = std::min(UDP_BATCH, ids.size() - offset);
+    for (size_t i = 0; i < count; ++i) {
+      const uint32_t id = ids[offset + i];
+      requests[i].header.type = GET_PAGE;
+      requests[i].header.request_id = id;
+      requests[i].page_number = keys[id - start];
+      requests[i].to_network_order();
+      iov[i] = {&requests[i], sizeof(GetPageRequest)};
+      memset(&messages[i], 0, sizeof(messages[i]));
+      messages[i].msg_hdr.msg_iov = &iov[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    size_t sent = 0;
+    while (sent < count) {
+      const int r = sendmmsg(sock, messages.data() + sent, count - sent, 0);
+      if (r < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == ENOBUFS) {
+          continue;
+        }
+        // ECONNREFUSED and friends: the retry timer resends later.
+        spdlog::debug("sendmmsg failed: {}", strerror(errno));
+        break;
+      }
+      sent += r;
+    }
+  }
+}
+
+// Copies one response fragment into its response slot. Returns true once the
+// request has all of its fragments.
+bool receive_fragment(const uint8_t* datagram, const size_t length,
+                      std::unordered_map<uint32_t, PendingRequest>& pending,
+                      std::vector<GetPageResponse*>& responses,
+                      UdpClientStats& stats) {
+  if (length < sizeof(UdpResponseHeader)) {
+    return false;
+  }
+  UdpResponseHeader header{};
+  memcpy(&header, datagram, sizeof(header));
+  header.to_host_order();
+
+  auto it = pending.find(header.page.request_id);
+  const size_t offset = header.fragment_index * UDP_FRAGMENT_SIZE;
+  if (it == pending.end() || header.fragment_index >= UDP_FRAGMENTS_PER_PAGE ||
+      offset + header.page.content_length > PAGE_SIZE ||
+      length < sizeof(header) + header.page.content_length) {
+    stats.duplicates++;
+    return false;
+  }
+  PendingRequest& request = it->second;
+  const uint64_t bit = uint64_t{1} << header.fragment_index;
+  if (request.fragments_received & bit) {
+    stats.duplicates++;
+    return false;
+  }
+  request.fragments_received |= bit;
+  request.fragment_count++;
+
+  GetPageResponse* response = responses[header.page.request_id];
+  memcpy(response->content.data() + offset, datagram + sizeof(header),
+         header.page.content_length);
+  if (request.fragment_count < header.fragment_count) {
+    return false;
+  }
+
+  GetPageResponseHeader page = header.page;
+  page.content_length = PAGE_SIZE;
+  page.to_network_order();
+  response->header = page;
+  stats.latency.record(now_ns() - request.first_sent_ns);
+  pending.erase(it);
+  return true;
+}
+
+void client_thread(const char* addr, const int port, const size_t start,
+                   const size_t end, const std::vector<uint32_t>& keys,
+                   std::vector<GetPageResponse*>& responses,
+                   UdpClientStats& stats) {
+  int sock = setup_udp_socket(addr, port);
+  if (sock < 0) return;
+
+  const uint64_t retry_timeout_ns = Config::udp_retry_timeout_us * 1000;
+  const size_t window = std::max<size_t>(Config::udp_window, 1);
+  std::unordered_map<uint32_t, PendingRequest> pending;
+  pending.reserve(window);
+  std::vector<uint32_t> to_send;
+
+  std::vector<std::array<uint8_t, UDP_MAX_PAYLOAD>> buffers(UDP_BATCH);
+  std::array<iovec, UDP_BATCH> iov{};
+  std::array<mmsghdr, UDP_BATCH> messages{};
+
+  size_t next = start;
+  while (stats.completed < end - start) {
+    const uint64_t now = now_ns();
+    to_send.clear();
+    for (auto& [id, request] : pending) {
+      if (now - request.sent_ns >= retry_timeout_ns) {
+        request.sent_ns = now;
+        to_send.push_back(id);
+        stats.retries++;
+      }
+    }
+    while (next < end && pending.size() < window) {
+      pending[next] = {now, now, 0, 0};
+      to_send.push_back(next);
+      next++;
+    }
+    send_requests(sock, to_send, keys, start);
+
+    pollfd pfd{sock, POLLIN, 0};
+    const int timeout_ms =
+        std::max<int>(1, static_cast<int>(Config::udp_retry_timeout_us / 1000));
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+      continue;
+    }
+
+    while (true) {
+      for (size_t i = 0; i < UDP_BATCH; ++i) {
+        iov[i] = {buffers[i].data(), buffers[i].size()};
+        memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+      }
+      const int n =
+          recvmmsg(sock, messages.data(), UDP_BATCH, MSG_DONTWAIT, nullptr);
+      if (n <= 0) {
+        break;
+      }
+      for (int i = 0; i < n; ++i) {
+        stats.datagrams++;
+        stats.wire_bytes += messages[i].msg_len;
+        if (receive_fragment(buffers[i].data(), messages[i].msg_len, pending,
+                             responses, stats)) {
+          stats.completed++;
+        }
+      }
+      if (static_cast<size_t>(n) < UDP_BATCH) {
+        break;
+      }
+    }
+  }
+
+  close(sock);
+}
+
+void verify_responses(std::vector<GetPageResponse*>& responses,
+                      MemoryBlockVerifier<PAGE_SIZE>& verifier,
+                      uint32_t& correct_responses,
+                      uint32_t& incorrect_responses) {
+  for (auto* response : responses) {
+    response->to_host_order();
+    if (!verifier.verify(response->content, response->header.page_number)) {
+      spdlog::error("Verification failed for page {}",
+                    response->header.page_number);
+      incorrect_responses++;
+    } else {
+      correct_responses++;
+    }
+  }
+}
+
+int main() {
+  Config::load_config();
+  const IFillingStrategy* strategy = new PseudoRandomFillingStrategy();
+  MemoryBlockVerifier<PAGE_SIZE> verifier(Config::page_count, strategy);
+
+  size_t num_requests = Config::num_requests;
+  uint32_t correct_responses = 0;
+  uint32_t incorrect_responses = 0;
+
+  std::vector<GetPageResponse*> responses(num_requests);
+  for (size_t i = 0; i < num_requests; i++) {
+    responses[i] = new GetPageResponse();
+  }
+
+  const KeyDistributionParams distribution = config_key_distribution();
+  std::vector<UdpClientStats> stats(Config::client_threads);
+  std::vector<std::vector<uint32_t>> keys(Config::client_threads);
+  std::vector<std::thread> threads;
+  size_t requests_per_thread = num_requests / Config::client_threads;
+  for (size_t i = 0; i < Config::client_threads; i++) {
+    size_t start = i * requests_per_thread;
+    size_t end = (i == Config::client_threads - 1)
+                     ? num_requests
+                     : (i + 1) * requests_per_thread;
+    keys[i] = generate_keys(distribution, start, end);
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < Config::client_threads; i++) {
+    size_t start = i * requests_per_thread;
+    size_t end = start + keys[i].size();
+    spdlog::info("Starting thread {} for range {} {}", i, start, end);
+    threads.emplace_back(client_thread, Config::host.c_str(), Config::port,
+                         start, end, std::cref(keys[i]), std::ref(responses),
+                         std::ref(stats[i]));
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  double total_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::high_resolution_clock::now() - start_time)
+          .count() /
+      1000000000.0;
+  const double avg_rate =
+      static_cast<double>(Config::num_requests) / total_time;
+
+  verify_responses(responses, verifier, correct_responses, incorrect_responses);
+
+  UdpClientStats total{};
+  for (const auto& thread_stats : stats) {
+    total.retries += thread_stats.retries;
+    total.duplicates += thread_stats.duplicates;
+    total.datagrams += thread_stats.datagrams;
+    total.wire_bytes += thread_stats.wire_bytes;
+    total.latency.merge(thread_stats.latency);
+  }
+  const double payload_gbps =
+      avg_rate * sizeof(GetPageResponse) * 8 / (1000 * 1000 * 1000);
+  const double wire_gbps = total.wire_bytes * 8 / total_time / 1e9;
+
+  spdlog::info("======================================");
+  spdlog::info("Correct responses: {}", correct_responses);
+  spdlog::info("Incorrect responses: {}", incorrect_responses);
+  spdlog::info("Datagrams: {} ({} per page), retries: {}, duplicates: {}",
+               total.datagrams, UDP_FRAGMENTS_PER_PAGE, total.retries,
+               total.duplicates);
+  spdlog::info("Total time for {} requests: {:.2f} s", Config::num_requests,
+               total_time);
+  spdlog::info("Average rate: {:03.2f} req/s", avg_rate);
+  spdlog::info("Latency p50: {:.1f} us, p99: {:.1f} us, p99.9: {:.1f} us",
+               total.latency.percentile_us(50), total.latency.percentile_us(99),
+               total.latency.percentile_us(99.9));
+  spdlog::info("Payload throughput: {:03.2f} Gb/s", payload_gbps);
+  spdlog::info("Wire throughput: {:03.2f} Gb/s", wire_gbps);
+  spdlog::info("======================================");
+
+  return 0;
+}
@@ -0,0 +1,266 @@
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "memory_block.hpp"
+#include "models/get_page.hpp"
+#include "models/udp.hpp"
+#include "page_store.hpp"
+#include "spdlog/spdlog.h"
+#include "static_config.hpp"
+#include "utils.hpp"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+constexpr size_t UDP_BATCH = 64;
+constexpr size_t UDP_MAX_MESSAGES = UDP_BATCH * UDP_FRAGMENTS_PER_PAGE;
+
+// Cleared for good once the egress path rejects a GSO message.
+std::atomic<bool> gso_enabled{true};
+
+const std::array<uint8_t, PAGE_SIZE> invalid_page_content = [] {
+  std::array<uint8_t, PAGE_SIZE> content{};
+  content.fill(0xFA);
+  return content;
+}();
+
+// Replies for one recvmmsg batch, sent with a single sendmmsg. With GSO all
+// fragments of a page share one message and the kernel cuts them apart.
+struct ReplyBatch {
+  std::array<UdpResponseHeader, UDP_MAX_MESSAGES> headers{};
+  std::array<iovec, UDP_MAX_MESSAGES * 2> iov{};
+  std::array<mmsghdr, UDP_MAX_MESSAGES> messages{};
+  struct alignas(cmsghdr) ControlBuffer {
+    char data[CMSG_SPACE(sizeof(uint16_t))];
+  };
+  std::array<ControlBuffer, UDP_BATCH> control{};
+  size_t header_count = 0;
+  size_t iov_count = 0;
+  size_t message_count = 0;
+  size_t control_count = 0;
+
+  void clear() {
+    header_count = 0;
+    iov_count = 0;
+    message_count = 0;
+    control_count = 0;
+  }
+
+  mmsghdr& new_message(sockaddr_in* peer) {
+    mmsghdr& message = messages[message_count++];
+    memset(&message, 0, sizeof(message));
+    message.msg_hdr.msg_name = peer;
+    message.msg_hdr.msg_namelen = sizeof(*peer);
+    message.msg_hdr.msg_iov = &iov[iov_count];
+    return message;
+  }
+
+  void set_segment_size(mmsghdr& message, const uint16_t segment_size) {
+    auto& buffer = control[control_count++];
+    message.msg_hdr.msg_control = buffer.data;
+    message.msg_hdr.msg_controllen = sizeof(buffer.data);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&message.msg_hdr);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segment_size));
+    memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+  }
+};
+
+void add_reply(ReplyBatch& batch, sockaddr_in* peer,
+               const GetPageRequest& request,
+               const PageStore<PAGE_SIZE>& store) {
+  GetPageResponseHeader page{};
+  page.request_id = request.header.request_id;
+  page.page_number = request.page_number;
+  const uint8_t* content = invalid_page_content.data();
+  if (request.page_number >= store.page_count()) {
+    page.status = INVALID_PAGE_NUMBER;
+  } else {
+    const PageVersion* version = store.get(request.page_number);
+    page.status = SUCCESS;
+    page.version = version->version;
+    content = version->data;
+  }
+
+  const bool gso = Config::udp_gso && UDP_FRAGMENTS_PER_PAGE > 1 &&
+                   gso_enabled.load(std::memory_order_relaxed);
+  mmsghdr* message = nullptr;
+  for (size_t f = 0; f < UDP_FRAGMENTS_PER_PAGE; ++f) {
+    const size_t offset = f * UDP_FRAGMENT_SIZE;
+    const size_t length = std::min(UDP_FRAGMENT_SIZE, PAGE_SIZE - offset);
+
+    UdpResponseHeader& header = batch.headers[batch.header_count++];
+    header.page = page;
+    header.page.content_length = length;
+    header.fragment_index = f;
+    header.fragment_count = UDP_FRAGMENTS_PER_PAGE;
+    header.to_network_order();
+
+    if (message == nullptr || !gso) {
+      message = &batch.new_message(peer);
+    }
+    batch.iov[batch.iov_count++] = {&header, sizeof(header)};
+    batch.iov[batch.iov_count++] = {const_cast<uint8_t*>(content) + offset,
+                                    length};
+    message->msg_hdr.msg_iovlen += 2;
+  }
+  if (gso) {
+    batch.set_segment_size(
+        *message, sizeof(UdpResponseHeader) + UDP_FRAGMENT_SIZE);
+  }
+}
+
+// Sends a GSO message as one datagram per fragment, each a header and its
+// piece of the page.
+void send_fragments(const int fd, const msghdr& message) {
+  for (size_t i = 0; i + 1 < message.msg_iovlen; i += 2) {
+    msghdr fragment{};
+    fragment.msg_name = message.msg_name;
+    fragment.msg_namelen = message.msg_namelen;
+    fragment.msg_iov = message.msg_iov + i;
+    fragment.msg_iovlen = 2;
+    if (sendmsg(fd, &fragment, 0) < 0) {
+      spdlog::debug("sendmsg failed: {}", strerror(errno));
+    }
+  }
+}
+
+// A message that cannot be sent is skipped; its client retries. Only the
+// rest of the batch goes on, so one bad peer does not cost everyone else
+// their replies.
+void send_batch(const int fd, ReplyBatch& batch) {
+  size_t sent = 0;
+  while (sent < batch.message_count) {
+    const int r = sendmmsg(fd, batch.messages.data() + sent,
+                           batch.message_count - sent, 0);
+    if (r >= 0) {
+      sent += r;
+      continue;
+    }
+    if (errno == EINTR || errno == EAGAIN) {
+      continue;
+    }
+    const msghdr& failed = batch.messages[sent].msg_hdr;
+    if (failed.msg_control != nullptr && (errno == EIO || errno == EINVAL)) {
+      if (gso_enabled.exchange(false)) {
+        spdlog::warn("GSO send failed ({}), sending fragments separately",
+                     strerror(errno));
+      }
+      send_fragments(fd, failed);
+    } else {
+      spdlog::debug("sendmmsg failed: {}", strerror(errno));
+    }
+    sent++;
+  }
+}
+
+int create_udp_socket(const in_port_t port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    spdlog::critical("socket failed");
+    exit(EXIT_FAILURE);
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  int buffer_size = 8 * 1024 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+  configure_socket_to_not_fragment(fd);
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+    spdlog::critical("bind failed");
+    exit(EXIT_FAILURE);
+  }
+  return fd;
+}
+
+void serve(const size_t index, PageStore<PAGE_SIZE>& store) {
+  const int fd = create_udp_socket(Config::port);
+  EpochReclaimer::Participant& epoch = store.participant(index);
+
+  std::array<std::array<uint8_t, UDP_MAX_PAYLOAD>, UDP_BATCH> buffers{};
+  std::array<sockaddr_in, UDP_BATCH> peers{};
+  std::array<iovec, UDP_BATCH> recv_iov{};
+  std::array<mmsghdr, UDP_BATCH> recv_messages{};
+  auto batch = std::make_unique<ReplyBatch>();
+  size_t served = 0;
+
+  while (true) {
+    for (size_t i = 0; i < UDP_BATCH; ++i) {
+      recv_iov[i] = {buffers[i].data(), buffers[i].size()};
+      memset(&recv_messages[i], 0, sizeof(recv_messages[i]));
+      recv_messages[i].msg_hdr.msg_iov = &recv_iov[i];
+      recv_messages[i].msg_hdr.msg_iovlen = 1;
+      recv_messages[i].msg_hdr.msg_name = &peers[i];
+      recv_messages[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+    }
+
+    const int n = recvmmsg(fd, recv_messages.data(), UDP_BATCH,
+                           MSG_WAITFORONE, nullptr);
+    if (n < 0) {
+      if (errno != EINTR) {
+        spdlog::error("recvmmsg failed: {}", strerror(errno));
+      }
+      continue;
+    }
+
+    epoch.enter();
+    batch->clear();
+    for (int i = 0; i < n; ++i) {
+      if (recv_messages[i].msg_len < sizeof(GetPageRequest)) {
+        continue;
+      }
+      GetPageRequest request{};
+      memcpy(&request, buffers[i].data(), sizeof(request));
+      request.to_host_order();
+      if (request.header.get_type() != GET_PAGE) {
+        continue;
+      }
+      add_reply(*batch, &peers[i], request, store);
+      served++;
+    }
+    send_batch(fd, *batch);
+    epoch.leave();
+
+    spdlog::debug("[{}] Served {} requests ({} messages in last batch)", index,
+                  served, batch->message_count);
+  }
+}
+
+int main() {
+  Config::load_config();
+
+  MemoryBlock<PAGE_SIZE> memory_block(Config::page_count,
+                                      new PseudoRandomFillingStrategy(),
+                                      Config::huge_pages);
+  spdlog::info("Page memory: {} bytes on {}", memory_block.size_bytes(),
+               huge_page_mode_name(memory_block.data.mode()));
+  PageStore<PAGE_SIZE> store(memory_block, Config::reactor_threads);
+
+  spdlog::info("UDP server on port {}: {} threads, {} fragment(s) per page, "
+               "GSO {}",
+               Config::port, Config::reactor_threads, UDP_FRAGMENTS_PER_PAGE,
+               Config::udp_gso);
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < Config::reactor_threads; ++i) {
+    threads.emplace_back(serve, i, std::ref(store));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
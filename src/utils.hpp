@@ -3,10 +3,17 @@
 #include <netinet/tcp.h>
 #include <spdlog/spdlog.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
 #include <unistd.h>
 
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "key_distribution.hpp"
 #include "static_config.hpp"
 
 void debug_print_array(uint8_t* arr, uint32_t size) {
@@ -34,3 +41,139 @@ void configure_socket_to_not_fragment(int socket) {
   int one = 1;
   setsockopt(socket, SOL_TCP, TCP_NODELAY, &one, sizeof(one));
 }
+
+// Every reactor binds its own listening socket to the same port; the kernel
+// then spreads incoming connections across them.
+int create_listen_socket(in_port_t port) {
+  int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    spdlog::critical("socket failed");
+    exit(EXIT_FAILURE);
+  }
+
+  int one = 1;
+  setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+
+  if (bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) <
+      0) {
+    spdlog::critical("bind failed");
+    exit(EXIT_FAILURE);
+  }
+
+  if (listen(server_fd, MAX_QUEUE) < 0) {
+    spdlog::critical("listen");
+    exit(EXIT_FAILURE);
+  }
+  return server_fd;
+}
+
+// Listening socket for same-host clients. Unlike TCP listeners it is shared by
+// all reactors, which each keep an accept pending on it.
+int create_unix_listen_socket(const std::string& path) {
+  int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    spdlog::critical("socket failed");
+    exit(EXIT_FAILURE);
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    spdlog::critical("Unix socket path too long: {}", path);
+    exit(EXIT_FAILURE);
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+
+  if (bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) <
+      0) {
+    spdlog::critical("bind failed");
+    exit(EXIT_FAILURE);
+  }
+
+  if (listen(server_fd, MAX_QUEUE) < 0) {
+    spdlog::critical("listen");
+    exit(EXIT_FAILURE);
+  }
+  return server_fd;
+}
+
+int connect_unix_socket(const std::string& path) {
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == -1) {
+    spdlog::error("Socket creation failed");
+    return -1;
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  if (connect(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+      -1) {
+    spdlog::error("Connection to {} failed", path);
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// Blocking connect to a numeric IPv4 address, with Nagle disabled.
+int connect_tcp_socket(const std::string& host, const int port) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock == -1) {
+    spdlog::error("Socket creation failed");
+    return -1;
+  }
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+      connect(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+          -1) {
+    spdlog::error("Connection to {}:{} failed", host, port);
+    close(sock);
+    return -1;
+  }
+  configure_socket_to_not_fragment(sock);
+  return sock;
+}
+
+struct Endpoint {
+  std::string host;
+  int port;
+};
+
+// A comma-separated list of host:port, as in ENDPOINTS and REPLICAS.
+std::vector<Endpoint> parse_endpoints(const std::string& list) {
+  std::vector<Endpoint> endpoints;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    const size_t colon = item.rfind(':');
+    if (colon == std::string::npos) {
+      throw std::invalid_argument("Endpoint without a port: " + item);
+    }
+    endpoints.push_back(
+        {item.substr(0, colon), std::stoi(item.substr(colon + 1))});
+  }
+  return endpoints;
+}
+
+// KEY_DISTRIBUTION and its parameters, over the PAGE_COUNT pages.
+inline KeyDistributionParams config_key_distribution() {
+  KeyDistributionParams params;
+  params.kind = parse_key_distribution(Config::key_distribution);
+  params.key_count = Config::page_count;
+  params.zipf_theta = Config::zipf_theta;
+  params.hotspot_fraction = Config::hotspot_fraction;
+  params.hotspot_probability = Config::hotspot_probability;
+  params.scan_length = Config::scan_length;
+  return params;
+}
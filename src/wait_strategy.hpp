@@ -0,0 +1,116 @@
+#pragma once
+
+#include <liburing.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "latency_recorder.hpp"
+
+enum class WaitMode { BLOCK, SPIN, ADAPTIVE };
+
+inline WaitMode parse_wait_mode(const std::string& name) {
+  if (name == "spin") {
+    return WaitMode::SPIN;
+  }
+  if (name == "adaptive") {
+    return WaitMode::ADAPTIVE;
+  }
+  return WaitMode::BLOCK;
+}
+
+inline const char* wait_mode_name(const WaitMode mode) {
+  switch (mode) {
+    case WaitMode::SPIN:
+      return "spin";
+    case WaitMode::ADAPTIVE:
+      return "adaptive";
+    default:
+      return "block";
+  }
+}
+
+// Decides how long a reactor polls its completion queue before it blocks in
+// io_uring_wait_cqe. BLOCK never polls, SPIN always polls for the full budget
+// and ADAPTIVE polls only while completions arrive often enough that one is
+// likely to show up within the budget: it keeps an EWMA of the gap between
+// completion batches and spins for twice that gap, or not at all once the gap
+// exceeds the budget.
+class WaitStrategy {
+ public:
+  WaitStrategy(const WaitMode mode, const uint64_t max_spin_ns)
+      : mode(mode), max_spin_ns(max_spin_ns) {}
+
+  // Same contract as io_uring_wait_cqe, but gives up after `timeout` if it
+  // blocks, returning -ETIME.
+  int wait(struct io_uring& ring, struct io_uring_cqe** cqe,
+           struct __kernel_timespec* timeout) {
+    const uint64_t budget = spin_budget_ns();
+    if (budget > 0) {
+      const uint64_t deadline = now_ns() + budget;
+      do {
+        if (io_uring_peek_cqe(&ring, cqe) == 0) {
+          spin_hits++;
+          record_arrival();
+          return 0;
+        }
+      } while (now_ns() < deadline);
+      spin_misses++;
+    }
+    const int r = io_uring_wait_cqe_timeout(&ring, cqe, timeout);
+    if (r == 0) {
+      blocks++;
+      record_arrival();
+    }
+    return r;
+  }
+
+  [[nodiscard]] WaitMode get_mode() const { return mode; }
+
+  size_t spin_hits = 0;
+  size_t spin_misses = 0;
+  size_t blocks = 0;
+
+ private:
+  static constexpr double EWMA_WEIGHT = 0.125;
+
+  [[nodiscard]] uint64_t spin_budget_ns() const {
+    switch (mode) {
+      case WaitMode::SPIN:
+        return max_spin_ns;
+      case WaitMode::ADAPTIVE:
+        if (mean_gap_ns > static_cast<double>(max_spin_ns)) {
+          return 0;
+        }
+        return std::min<uint64_t>(max_spin_ns,
+                                  static_cast<uint64_t>(2 * mean_gap_ns));
+      default:
+        return 0;
+    }
+  }
+
+  void record_arrival() {
+    const uint64_t now = now_ns();
+    if (last_arrival_ns != 0) {
+      const auto gap = static_cast<double>(now - last_arrival_ns);
+      mean_gap_ns += EWMA_WEIGHT * (gap - mean_gap_ns);
+    }
+    last_arrival_ns = now;
+  }
+
+  WaitMode mode;
+  uint64_t max_spin_ns;
+  uint64_t last_arrival_ns = 0;
+  double mean_gap_ns = 0;
+};
+
+// CPU time (user + system) consumed by the calling thread.
+inline double thread_cpu_seconds() {
+  rusage usage{};
+  getrusage(RUSAGE_THREAD, &usage);
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) /
+             1e6;
+}